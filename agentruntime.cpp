@@ -0,0 +1,225 @@
+/*
+Copyright (C) 2015 Jonathon Ogden  < jeog.dev@gmail.com >
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program. If not, see http://www.gnu.org/licenses.
+*/
+
+#include "agentruntime.hpp"
+
+#include <algorithm>
+
+namespace NativeLayer{
+
+namespace{
+thread_local bool on_worker = false;
+};
+
+
+bool
+AgentInbox::post(callback_msg msg, id_type id, price_type price, size_type size)
+{
+    AgentRuntime *rt;
+    {
+        std::lock_guard<std::mutex> lock(_mtx);
+        if(!_runtime)
+            return false;
+        _events.push_back( event_type(msg, id, price, size) );
+        if(_scheduled)
+            return true;
+        _scheduled = true;
+        rt = _runtime;
+    }
+    rt->_schedule( shared_from_this() );
+    return true;
+}
+
+
+size_t
+AgentInbox::pending()
+{
+    std::lock_guard<std::mutex> lock(_mtx);
+    return _events.size();
+}
+
+
+bool
+AgentInbox::_run(size_t max)
+{
+    event_type e;
+    for(size_t n = 0; n < max; ++n){
+        {
+            std::lock_guard<std::mutex> lock(_mtx);
+            if(_events.empty()){
+                _scheduled = false;
+                return false;
+            }
+            e = _events.front();
+            _events.pop_front();
+        }
+        try{
+            _deliver(std::get<0>(e), std::get<1>(e), std::get<2>(e),
+                     std::get<3>(e));
+        }catch(std::exception& ex){
+            /* no one to report to; don't take the worker down */
+            std::cerr<< "exception in agent callback: " << ex.what() << std::endl;
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(_mtx);
+    if(_events.empty()){
+        _scheduled = false;
+        return false;
+    }
+    return true;
+}
+
+
+AgentRuntime::AgentRuntime(unsigned int nthreads)
+    :
+        _nbusy(0),
+        _run_flag(true)
+    {
+        if(!nthreads)
+            nthreads = std::max(std::thread::hardware_concurrency(), 1u);
+
+        while(nthreads--)
+            _workers.push_back( std::thread(&AgentRuntime::_threaded_worker, this) );
+    }
+
+
+AgentRuntime::~AgentRuntime()
+    {
+        std::vector<agent_type> agents;
+        {
+            std::lock_guard<std::mutex> lock(_mtx);
+            agents.swap(_agents);
+        }
+        for(auto& a : agents){
+            std::lock_guard<std::mutex> lock(a->_mtx);
+            a->_runtime = nullptr;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(_mtx);
+            _run_flag = false;
+        }
+        _ready_cond.notify_all();
+
+        for(auto& w : _workers){
+            try{
+                if(w.joinable())
+                    w.join();
+            }catch(...){
+            }
+        }
+    }
+
+
+void
+AgentRuntime::attach(agent_type agent)
+{
+    {
+        std::lock_guard<std::mutex> lock(_mtx);
+        if( std::find(_agents.begin(), _agents.end(), agent) == _agents.end() )
+            _agents.push_back(agent);
+    }
+    std::lock_guard<std::mutex> lock(agent->_mtx);
+    agent->_runtime = this;
+}
+
+
+void
+AgentRuntime::detach(agent_type agent)
+{
+    {
+        std::lock_guard<std::mutex> lock(_mtx);
+        _agents.erase( std::remove(_agents.begin(), _agents.end(), agent),
+                       _agents.end() );
+    }
+    std::lock_guard<std::mutex> lock(agent->_mtx);
+    if(agent->_runtime == this)
+        agent->_runtime = nullptr;
+}
+
+
+void
+AgentRuntime::wait_idle()
+{
+    if(on_worker)
+        throw std::logic_error("wait_idle called from an agent worker");
+
+    std::unique_lock<std::mutex> lock(_mtx);
+    while( !_ready.empty() || _nbusy )
+        _idle_cond.wait(lock);
+}
+
+
+bool
+AgentRuntime::on_worker_thread()
+{
+    return on_worker;
+}
+
+
+void
+AgentRuntime::_schedule(agent_type agent)
+{
+    {
+        std::lock_guard<std::mutex> lock(_mtx);
+        _ready.push_back(agent);
+    }
+    _ready_cond.notify_one();
+}
+
+
+void
+AgentRuntime::_threaded_worker()
+{
+    agent_type agent;
+    bool again;
+
+    on_worker = true;
+    for( ; ; ){
+        {
+            std::unique_lock<std::mutex> lock(_mtx);
+            /* keep going until the ready queue is empty, even if stopped */
+            while( _ready.empty() && _run_flag )
+                _ready_cond.wait(lock);
+
+            if( _ready.empty() )
+                break;
+
+            agent = _ready.front();
+            _ready.pop_front();
+            ++_nbusy;
+        }
+
+        again = agent->_run(batch_max);
+
+        {
+            std::lock_guard<std::mutex> lock(_mtx);
+            --_nbusy;
+            if(again)
+                _ready.push_back(agent); /* to the back of the line */
+            else if( _ready.empty() && !_nbusy )
+                _idle_cond.notify_all();
+        }
+        if(again)
+            _ready_cond.notify_one();
+
+        agent.reset();
+    }
+}
+
+};
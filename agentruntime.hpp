@@ -0,0 +1,158 @@
+/*
+Copyright (C) 2015 Jonathon Ogden     < jeog.dev@gmail.com >
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see http://www.gnu.org/licenses.
+*/
+
+#ifndef JO_0815_AGENT_RUNTIME
+#define JO_0815_AGENT_RUNTIME
+
+#include <deque>
+#include <vector>
+#include <tuple>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+
+#include "types.hpp"
+
+namespace NativeLayer{
+
+class AgentRuntime;
+
+/*
+ *   AgentInbox is the event inbox of an agent(see MarketMaker's
+ *   dynamic_functor). While it's attached to an AgentRuntime the callbacks
+ *   it receives(fills, cancels, wakes...) are queued by post(...) instead of
+ *   being handled on the thread that delivered them, and the first one
+ *   schedules the agent on the runtime's worker pool. A worker hands them
+ *   to _deliver(...) in the order they were posted, never on more than one
+ *   thread at a time; different agents run in parallel.
+ */
+class AgentInbox
+        : public std::enable_shared_from_this<AgentInbox>{
+    friend AgentRuntime;
+
+    typedef std::tuple<callback_msg,id_type,price_type,size_type> event_type;
+
+    std::mutex _mtx;
+    std::deque<event_type> _events;
+    AgentRuntime *_runtime;
+    bool _scheduled;
+
+    /* on a worker: deliver up to 'max' events; true if we need to go again */
+    bool
+    _run(size_t max);
+
+protected:
+    AgentInbox()
+        :
+            _runtime(nullptr),
+            _scheduled(false)
+        {
+        }
+
+    /* handle one event, on a worker thread */
+    virtual void
+    _deliver(callback_msg msg, id_type id, price_type price, size_type size) = 0;
+
+public:
+    virtual
+    ~AgentInbox()
+        {
+        }
+
+    /* queue an event for a worker; false(nothing queued) if not attached */
+    bool
+    post(callback_msg msg, id_type id, price_type price, size_type size);
+
+    size_t
+    pending();
+};
+
+
+/*
+ *   AgentRuntime is a fixed pool of worker threads that run attached
+ *   AgentInbox(es) off a FIFO ready queue. A worker delivers at most
+ *   ::batch_max events from an agent before putting it back at the end of
+ *   the queue, so a busy agent can't starve the rest.
+ *
+ *   Nothing is delivered on the thread that posted it, so there's no
+ *   recursion to bound: an agent that keeps responding to its own fills
+ *   keeps a worker busy instead of overflowing the stack.
+ *
+ *   on_worker_thread() tells the orderbook an order is being submitted by
+ *   an agent: the caller only waits for its own order to be routed, not for
+ *   the order queue to drain(see SimpleOrderbook::set_agent_threads).
+ *
+ *   detach(...) doesn't wait for an agent's queued events; they're still
+ *   delivered by the workers. The destructor detaches every agent and stops
+ *   the workers once the ready queue is empty.
+ */
+class AgentRuntime{
+    friend AgentInbox;
+
+    typedef std::shared_ptr<AgentInbox> agent_type;
+
+    std::vector<std::thread> _workers;
+    std::vector<agent_type> _agents;
+    std::deque<agent_type> _ready;
+    std::mutex _mtx;
+    std::condition_variable _ready_cond;
+    std::condition_variable _idle_cond;
+    size_t _nbusy;
+    bool _run_flag;
+
+    void
+    _threaded_worker();
+
+    void
+    _schedule(agent_type agent);
+
+    /* restrict copy / move / assign */
+    AgentRuntime(const AgentRuntime& ar);
+    AgentRuntime& operator=(const AgentRuntime& ar);
+
+public:
+    static const size_t batch_max = 64;
+
+    /* nthreads == 0: one per hardware thread */
+    explicit AgentRuntime(unsigned int nthreads = 0);
+
+    ~AgentRuntime();
+
+    void
+    attach(agent_type agent);
+
+    void
+    detach(agent_type agent);
+
+    /* block until no agent is ready or running */
+    void
+    wait_idle();
+
+    inline unsigned int
+    nthreads() const
+    {
+        return (unsigned int)_workers.size();
+    }
+
+    static bool
+    on_worker_thread();
+};
+
+};
+
+#endif /* JO_0815_AGENT_RUNTIME */
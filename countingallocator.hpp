@@ -0,0 +1,160 @@
+/*
+Copyright (C) 2015 Jonathon Ogden     < jeog.dev@gmail.com >
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see http://www.gnu.org/licenses.
+*/
+
+#ifndef JO_0815_COUNTING_ALLOCATOR
+#define JO_0815_COUNTING_ALLOCATOR
+
+#include <atomic>
+#include <memory>
+#include <cstddef>
+#include <type_traits>
+
+namespace NativeLayer{
+
+/*
+ *   allocation_counter holds the live bytes and allocations of everything
+ *   allocated through the counting_allocators that point at it. Updates
+ *   are relaxed atomics so it can be read from any thread without locking.
+ *
+ *   counting_allocator<T> is a std::allocator that adds to / subtracts from
+ *   an allocation_counter; containers pass it along to their node(rebound)
+ *   allocations and to copies of themselves. A default constructed
+ *   counting_allocator counts nothing. For the node-based containers(map)
+ *   allocations == elements; for deques they are blocks.
+ */
+
+struct allocation_counter {
+    std::atomic<std::size_t> bytes;
+    std::atomic<std::size_t> allocations;
+
+    allocation_counter()
+        :
+            bytes(0),
+            allocations(0)
+        {
+        }
+
+private:
+    /* restrict copy / assign */
+    allocation_counter(const allocation_counter& ac);
+    allocation_counter& operator=(const allocation_counter& ac);
+};
+
+
+template<typename T>
+class counting_allocator{
+    template<typename U> friend class counting_allocator;
+
+    allocation_counter* _counter;
+
+public:
+    typedef T value_type;
+    typedef T* pointer;
+    typedef const T* const_pointer;
+    typedef T& reference;
+    typedef const T& const_reference;
+    typedef std::size_t size_type;
+    typedef std::ptrdiff_t difference_type;
+
+    /* the allocator follows the container(the book never mixes counters) */
+    typedef std::true_type propagate_on_container_copy_assignment;
+    typedef std::true_type propagate_on_container_move_assignment;
+    typedef std::true_type propagate_on_container_swap;
+
+    template<typename U>
+    struct rebind{
+        typedef counting_allocator<U> other;
+    };
+
+    counting_allocator()
+        :
+            _counter(nullptr)
+        {
+        }
+
+    explicit counting_allocator(allocation_counter* counter)
+        :
+            _counter(counter)
+        {
+        }
+
+    template<typename U>
+    counting_allocator(const counting_allocator<U>& a)
+        :
+            _counter(a._counter)
+        {
+        }
+
+    inline T*
+    allocate(std::size_t n)
+    {
+        T* p = std::allocator<T>().allocate(n);
+        if(_counter){
+            _counter->bytes.fetch_add(n * sizeof(T), std::memory_order_relaxed);
+            _counter->allocations.fetch_add(1, std::memory_order_relaxed);
+        }
+        return p;
+    }
+
+    inline void
+    deallocate(T* p, std::size_t n)
+    {
+        if(_counter){
+            _counter->bytes.fetch_sub(n * sizeof(T), std::memory_order_relaxed);
+            _counter->allocations.fetch_sub(1, std::memory_order_relaxed);
+        }
+        std::allocator<T>().deallocate(p, n);
+    }
+
+    template<typename U, typename... Args>
+    inline void
+    construct(U* p, Args&&... args)
+    {
+        ::new((void*)p) U(std::forward<Args>(args)...);
+    }
+
+    template<typename U>
+    inline void
+    destroy(U* p)
+    {
+        p->~U();
+    }
+
+    inline std::size_t
+    max_size() const
+    {
+        return std::allocator<T>().max_size();
+    }
+
+    template<typename U>
+    inline bool
+    operator==(const counting_allocator<U>& a) const
+    {
+        return _counter == a._counter;
+    }
+
+    template<typename U>
+    inline bool
+    operator!=(const counting_allocator<U>& a) const
+    {
+        return _counter != a._counter;
+    }
+};
+
+};
+
+#endif /* JO_0815_COUNTING_ALLOCATOR */
@@ -0,0 +1,218 @@
+/*
+Copyright (C) 2015 Jonathon Ogden     < jeog.dev@gmail.com >
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see http://www.gnu.org/licenses.
+*/
+
+#ifndef JO_0815_ENGINE_COUNTERS
+#define JO_0815_ENGINE_COUNTERS
+
+#include <atomic>
+#include <mutex>
+#include <chrono>
+#include <iostream>
+#include <iomanip>
+
+#include "types.hpp"
+
+namespace NativeLayer{
+
+/*
+ *   engine_counters are updated(relaxed atomics) by the orderbook as it runs
+ *   and can be read from any thread without locking(see
+ *   SimpleOrderbook::counters()). sample() copies them into a plain
+ *   engine_counters_sample; values read while the book is running are
+ *   individually, not mutually, consistent.
+ *
+ *       accepted / rejected  : orders routed without / with an exception, by
+ *                              order_type(null = pulls and modifies; one of an
+ *                              unknown id is 'rejected')
+ *       fills                : trades
+ *       levels_swept         : price levels hit by aggressive orders
+ *       stops_triggered      : stop orders triggered
+ *       self_trades_prevented: matches w/ an order of the same owner that were
+ *                              cancelled/decremented instead(see stp_policy)
+ *       stop_cascades        : chains of consecutive triggers(a cascade ends
+ *                              when a new order is routed or the order queue
+ *                              drains)
+ *       stop_cascade_max     : longest cascade
+ *       order_queue_peak     : peak depth of the order queue
+ *       callback_queue_peak  : peak depth of the deferred callback queue
+ *       callback_skips       : callback deliveries skipped because another
+ *                              thread(or a callback) was already delivering
+ *       master_lock_contended: times the master lock was already held when
+ *                              we went to take it
+ *       master_lock_wait_ns  : total time spent waiting for it
+ */
+
+struct engine_counters_sample {
+    large_size_type accepted[norder_types];
+    large_size_type rejected[norder_types];
+    large_size_type fills;
+    large_size_type levels_swept;
+    large_size_type stops_triggered;
+    large_size_type self_trades_prevented;
+    large_size_type stop_cascades;
+    large_size_type stop_cascade_max;
+    large_size_type order_queue_peak;
+    large_size_type callback_queue_peak;
+    large_size_type callback_skips;
+    large_size_type master_lock_contended;
+    large_size_type master_lock_wait_ns;
+};
+
+
+struct engine_counters {
+    typedef std::atomic<large_size_type> counter_type;
+
+    counter_type accepted[norder_types];
+    counter_type rejected[norder_types];
+    counter_type fills;
+    counter_type levels_swept;
+    counter_type stops_triggered;
+    counter_type self_trades_prevented;
+    counter_type stop_cascades;
+    counter_type stop_cascade_max;
+    counter_type order_queue_peak;
+    counter_type callback_queue_peak;
+    counter_type callback_skips;
+    counter_type master_lock_contended;
+    counter_type master_lock_wait_ns;
+
+    engine_counters()
+        {
+            reset();
+        }
+
+    static inline void
+    incr(counter_type& c, large_size_type n = 1)
+    {
+        c.fetch_add(n, std::memory_order_relaxed);
+    }
+
+    /* only for counters with a single writer(or writers serialized by a lock) */
+    static inline void
+    set_max(counter_type& c, large_size_type n)
+    {
+        if(n > c.load(std::memory_order_relaxed))
+            c.store(n, std::memory_order_relaxed);
+    }
+
+    void
+    reset()
+    {
+        for(int i = 0; i < norder_types; ++i){
+            accepted[i].store(0, std::memory_order_relaxed);
+            rejected[i].store(0, std::memory_order_relaxed);
+        }
+        for(counter_type* c : {&fills, &levels_swept, &stops_triggered,
+                               &self_trades_prevented, &stop_cascades, &stop_cascade_max,
+                               &order_queue_peak, &callback_queue_peak,
+                               &callback_skips, &master_lock_contended,
+                               &master_lock_wait_ns})
+        {
+            c->store(0, std::memory_order_relaxed);
+        }
+    }
+
+    engine_counters_sample
+    sample() const
+    {
+        engine_counters_sample s;
+        for(int i = 0; i < norder_types; ++i){
+            s.accepted[i] = accepted[i].load(std::memory_order_relaxed);
+            s.rejected[i] = rejected[i].load(std::memory_order_relaxed);
+        }
+        s.fills = fills.load(std::memory_order_relaxed);
+        s.levels_swept = levels_swept.load(std::memory_order_relaxed);
+        s.stops_triggered = stops_triggered.load(std::memory_order_relaxed);
+        s.self_trades_prevented = self_trades_prevented.load(std::memory_order_relaxed);
+        s.stop_cascades = stop_cascades.load(std::memory_order_relaxed);
+        s.stop_cascade_max = stop_cascade_max.load(std::memory_order_relaxed);
+        s.order_queue_peak = order_queue_peak.load(std::memory_order_relaxed);
+        s.callback_queue_peak = callback_queue_peak.load(std::memory_order_relaxed);
+        s.callback_skips = callback_skips.load(std::memory_order_relaxed);
+        s.master_lock_contended = master_lock_contended.load(std::memory_order_relaxed);
+        s.master_lock_wait_ns = master_lock_wait_ns.load(std::memory_order_relaxed);
+        return s;
+    }
+
+private:
+    /* restrict copy / assign */
+    engine_counters(const engine_counters& ec);
+    engine_counters& operator=(const engine_counters& ec);
+};
+
+
+/* lock_guard that only reads the clock when it has to wait */
+class counted_lock_guard{
+    std::mutex& _mtx;
+
+    /* restrict copy / assign */
+    counted_lock_guard(const counted_lock_guard& clg);
+    counted_lock_guard& operator=(const counted_lock_guard& clg);
+
+public:
+    counted_lock_guard(std::mutex& mtx, engine_counters& ec)
+        :
+            _mtx(mtx)
+        {
+            if(_mtx.try_lock())
+                return;
+
+            clock_type::time_point t0 = clock_type::now();
+            _mtx.lock();
+            engine_counters::incr(ec.master_lock_contended);
+            engine_counters::incr(
+                ec.master_lock_wait_ns,
+                std::chrono::duration_cast<std::chrono::nanoseconds>(
+                    clock_type::now() - t0
+                ).count()
+            );
+        }
+
+    ~counted_lock_guard()
+        {
+            _mtx.unlock();
+        }
+};
+
+
+inline std::ostream&
+operator<<(std::ostream& out, const engine_counters_sample& s)
+{
+    out<< std::left;
+    for(int i = 0; i < norder_types; ++i){
+        out<< std::setw(24)
+           << ((i ? order_type_str((order_type)i) : std::string("pull/modify")) + ":")
+           << s.accepted[i] << " accepted, " << s.rejected[i] << " rejected"
+           << std::endl;
+    }
+    out<< std::setw(24) << "fills:" << s.fills << std::endl
+       << std::setw(24) << "levels swept:" << s.levels_swept << std::endl
+       << std::setw(24) << "stops triggered:" << s.stops_triggered << std::endl
+       << std::setw(24) << "self trades prevented:" << s.self_trades_prevented << std::endl
+       << std::setw(24) << "stop cascades:" << s.stop_cascades
+       << " (max " << s.stop_cascade_max << ")" << std::endl
+       << std::setw(24) << "order queue peak:" << s.order_queue_peak << std::endl
+       << std::setw(24) << "callback queue peak:" << s.callback_queue_peak << std::endl
+       << std::setw(24) << "callback skips:" << s.callback_skips << std::endl
+       << std::setw(24) << "master lock contended:" << s.master_lock_contended
+       << " (" << s.master_lock_wait_ns << " ns waiting)" << std::endl;
+    return out << std::right;
+}
+
+};
+
+#endif /* JO_0815_ENGINE_COUNTERS */
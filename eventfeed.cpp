@@ -0,0 +1,164 @@
+/*
+Copyright (C) 2015 Jonathon Ogden  < jeog.dev@gmail.com >
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program. If not, see http://www.gnu.org/licenses.
+*/
+
+#include "eventfeed.hpp"
+
+namespace NativeLayer{
+
+void
+MBOBookImage::_remove_size(const order& o, std::uint64_t size)
+{
+    if(o.is_stop)
+        return;
+
+    levels_type& levels = o.buy ? _bids : _asks;
+    auto iter = levels.find(o.tick);
+    if(iter == levels.end())
+        return;
+
+    if(iter->second <= size)
+        levels.erase(iter);
+    else
+        iter->second -= size;
+}
+
+
+void
+MBOBookImage::apply(const mbo_event& e)
+{
+    order o;
+    std::unordered_map<std::uint64_t, order>::iterator iter;
+
+    switch((mbo_msg)e.msg){
+    case mbo_msg::clear:
+        clear();
+        break;
+
+    case mbo_msg::add:
+        o.size = e.size;
+        o.tick = e.tick;
+        o.stop = e.stop;
+        o.buy = e.buy;
+        o.is_stop = (e.flags & MBO_FLAG_STOP);
+        _orders[e.id] = o;
+        if(!o.is_stop)
+            (o.buy ? _bids : _asks)[o.tick] += o.size;
+        break;
+
+    case mbo_msg::modify:
+        iter = _orders.find(e.ref ? e.ref : e.id);
+        if(iter == _orders.end())
+            break;
+        _remove_size(iter->second, iter->second.size);
+        o = iter->second;
+        o.size = e.size;
+        o.tick = e.tick;
+        o.stop = e.stop;
+        if(e.ref)
+            _orders.erase(iter);
+        if(!o.size)
+            break;
+        _orders[e.id] = o;
+        if(!o.is_stop)
+            (o.buy ? _bids : _asks)[o.tick] += o.size;
+        break;
+
+    case mbo_msg::cancel:
+    case mbo_msg::trigger:
+        iter = _orders.find(e.id);
+        if(iter == _orders.end())
+            break;
+        _remove_size(iter->second, iter->second.size);
+        _orders.erase(iter);
+        break;
+
+    case mbo_msg::execute:
+        iter = _orders.find(e.id);
+        if(iter == _orders.end())
+            break;
+        _remove_size(iter->second, e.size);
+        if(iter->second.size <= e.size)
+            _orders.erase(iter);
+        else
+            iter->second.size -= e.size;
+        break;
+    }
+}
+
+
+void
+MBOBookImage::clear()
+{
+    _orders.clear();
+    _bids.clear();
+    _asks.clear();
+}
+
+
+void
+L2BookImage::apply(const l2_event& e)
+{
+    levels_type* levels;
+
+    switch((l2_msg)e.msg){
+    case l2_msg::update:
+        if(!_synced)
+            break;
+        levels = e.buy ? &_bids : &_asks;
+        if(e.size)
+            (*levels)[e.tick] = e.size;
+        else
+            levels->erase(e.tick);
+        break;
+
+    case l2_msg::refresh_begin:
+        _refresh_bids.clear();
+        _refresh_asks.clear();
+        _refreshing = true;
+        break;
+
+    case l2_msg::refresh_level:
+        if(_refreshing)
+            (e.buy ? _refresh_bids : _refresh_asks)[e.tick] = e.size;
+        break;
+
+    case l2_msg::refresh_end:
+        if(!_refreshing)
+            break;
+        _bids.swap(_refresh_bids);
+        _asks.swap(_refresh_asks);
+        _refresh_bids.clear();
+        _refresh_asks.clear();
+        _refreshing = false;
+        _synced = true;
+        break;
+    }
+}
+
+
+void
+L2BookImage::reset()
+{
+    _bids.clear();
+    _asks.clear();
+    _refresh_bids.clear();
+    _refresh_asks.clear();
+    _synced = false;
+    _refreshing = false;
+}
+
+};
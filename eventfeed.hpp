@@ -0,0 +1,424 @@
+/*
+Copyright (C) 2015 Jonathon Ogden     < jeog.dev@gmail.com >
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see http://www.gnu.org/licenses.
+*/
+
+#ifndef JO_0815_EVENT_FEED
+#define JO_0815_EVENT_FEED
+
+#include <cstdint>
+#include <atomic>
+#include <memory>
+#include <map>
+#include <unordered_map>
+#include <type_traits>
+
+#include "types.hpp"
+
+namespace NativeLayer{
+
+/*
+ *   BroadcastRing<T> is a fixed-size, single-producer / multi-consumer ring:
+ *   the producer(the orderbook, from inside the matching path) never blocks
+ *   or waits on consumers, each consumer keeps its own cursor and reads every
+ *   element at memory speed. A consumer that falls more than capacity()
+ *   elements behind has been lapped; poll(...) reports feed_status::overrun
+ *   and the consumer must rebuild its state from the source.
+ *
+ *   Each element is stamped with a sequence number(from 1, no gaps) in its
+ *   'seq' field. Slots are published seqlock-style, so T must be trivially
+ *   copyable.
+ *
+ *   MBOFeed is the level-3(market-by-order) feed the orderbook publishes to
+ *   (see SimpleOrderbook::set_mbo_feed): one mbo_event per order added,
+ *   modified, cancelled, executed(the resting side) or stop triggered.
+ *   MBOBookImage reconstructs the book incrementally from those events.
+ *
+ *   L2Feed is the level-2(aggregate price level) feed(see 
+ *   SimpleOrderbook::set_l2_feed): one l2_event with the new aggregate size
+ *   whenever a limit level changes, plus a periodic full refresh. 
+ *   L2BookImage maintains the levels from those events.
+ */
+
+enum class feed_status {
+    ok = 0,
+    empty,
+    overrun
+};
+
+
+template<typename T>
+class BroadcastRing{
+    static_assert(std::is_trivially_copyable<T>::value,
+                  "BroadcastRing element must be trivially copyable");
+
+    struct slot {
+        std::atomic<std::uint64_t> seq; /* 0 while being written */
+        T elem;
+    };
+
+    std::unique_ptr<slot[]> _slots;
+    std::uint64_t _mask;
+    std::atomic<std::uint64_t> _head; /* last published seq */
+
+    static inline std::uint64_t
+    _round_up_pow2(std::uint64_t n)
+    {
+        std::uint64_t p = 2;
+        while(p < n)
+            p <<= 1;
+        return p;
+    }
+
+    /* restrict copy / move / assign */
+    BroadcastRing(const BroadcastRing& br);
+    BroadcastRing& operator=(const BroadcastRing& br);
+
+public:
+    class Consumer{
+        const BroadcastRing* _ring;
+        std::uint64_t _next;
+
+    public:
+        Consumer(const BroadcastRing* ring, std::uint64_t next)
+            :
+                _ring(ring),
+                _next(next)
+            {
+            }
+
+        /* copy the next element to *out */
+        feed_status
+        poll(T* out)
+        {
+            std::uint64_t head = _ring->_head.load(std::memory_order_acquire);
+            if(_next > head)
+                return feed_status::empty;
+
+            if(head - _next >= _ring->capacity()){
+                _next = head + 1;
+                return feed_status::overrun;
+            }
+
+            const slot& s = _ring->_slots[_next & _ring->_mask];
+            if(s.seq.load(std::memory_order_acquire) != _next){
+                _next = head + 1;
+                return feed_status::overrun;
+            }
+
+            *out = s.elem;
+            std::atomic_thread_fence(std::memory_order_acquire);
+
+            if(s.seq.load(std::memory_order_relaxed) != _next){
+                _next = _ring->_head.load(std::memory_order_acquire) + 1;
+                return feed_status::overrun;
+            }
+
+            ++_next;
+            return feed_status::ok;
+        }
+
+        /* number of published elements not yet consumed */
+        inline std::uint64_t
+        lag() const
+        {
+            std::uint64_t head = _ring->_head.load(std::memory_order_acquire);
+            return (_next > head) ? 0 : head - _next + 1;
+        }
+
+        inline std::uint64_t
+        next_seq() const
+        {
+            return _next;
+        }
+    };
+
+    explicit BroadcastRing(size_type capacity = 65536)
+        :
+            _slots(),
+            _mask(_round_up_pow2(capacity) - 1),
+            _head(0)
+        {
+            _slots.reset(new slot[_mask + 1]);
+            for(std::uint64_t i = 0; i <= _mask; ++i)
+                _slots[i].seq.store(0, std::memory_order_relaxed);
+        }
+
+    /* SINGLE PRODUCER: stamp elem with the next seq and publish it */
+    inline std::uint64_t
+    publish(const T& elem)
+    {
+        std::uint64_t seq = _head.load(std::memory_order_relaxed) + 1;
+        slot& s = _slots[seq & _mask];
+
+        s.seq.store(0, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+
+        s.elem = elem;
+        s.elem.seq = seq;
+
+        s.seq.store(seq, std::memory_order_release);
+        _head.store(seq, std::memory_order_release);
+        return seq;
+    }
+
+    /* start consuming at the next element to be published */
+    inline Consumer
+    subscribe() const
+    {
+        return Consumer(this, _head.load(std::memory_order_acquire) + 1);
+    }
+
+    /* start consuming at the oldest element still in the ring */
+    inline Consumer
+    subscribe_oldest() const
+    {
+        std::uint64_t head = _head.load(std::memory_order_acquire);
+        return Consumer(this, (head > _mask) ? head - _mask : 1);
+    }
+
+    inline std::uint64_t
+    capacity() const
+    {
+        return _mask + 1;
+    }
+
+    inline std::uint64_t
+    last_seq() const
+    {
+        return _head.load(std::memory_order_acquire);
+    }
+};
+
+
+enum class mbo_msg : std::uint8_t {
+    clear = 0, /* drop all orders; an image of the book(adds) follows */
+    add,
+    modify,
+    cancel,
+    execute,
+    trigger
+};
+
+/*
+ *   fixed 64-byte layout, host byte order; prices are tick indices from the
+ *   min price of the book, -1 if none
+ *
+ *       add     : id rests, size is its size
+ *       modify  : id now has size/tick; if ref is set the order moved to 
+ *                 the back of the line under the new id(it was ref) and 
+ *                 size is what rested after it traded(0 = none)
+ *       cancel  : id removed, size is what was outstanding
+ *       execute : size of (resting) id filled at tick by aggressor ref
+ *       trigger : stop id removed from the stop chain; its limit(tick != -1)
+ *                 or market order is routed next, with the same id
+ *
+ *   stop orders are flagged MBO_FLAG_STOP(add, modify, cancel, trigger) and 
+ *   carry their stop price in 'stop'; a trailing stop's ratchet is a modify
+ *   w/ its new stop(and limit) and no ref
+ */
+struct mbo_event {
+    std::uint64_t seq;
+    std::uint64_t id;
+    std::uint64_t ref;
+    std::uint64_t size;
+    std::int64_t time; /* nanoseconds, book clock(see set_virtual_time) */
+    std::int32_t tick;
+    std::int32_t stop;
+    std::uint8_t msg; /* mbo_msg */
+    std::uint8_t buy;
+    std::uint8_t flags;
+    std::uint8_t pad[13];
+};
+
+static_assert(sizeof(mbo_event) == 64, "mbo_event must be 64 bytes");
+
+#define MBO_FLAG_STOP 0x01
+
+typedef BroadcastRing<mbo_event> MBOFeed;
+
+
+enum class l2_msg : std::uint8_t {
+    update = 0, /* level now has aggregate size(0 = empty) */
+    refresh_begin, /* full refresh: every non-empty level follows */
+    refresh_level,
+    refresh_end
+};
+
+/* fixed 32-byte layout, host byte order; tick as in mbo_event */
+struct l2_event {
+    std::uint64_t seq;
+    std::uint64_t size;
+    std::int64_t time; /* nanoseconds, book clock(see set_virtual_time) */
+    std::int32_t tick;
+    std::uint8_t msg; /* l2_msg */
+    std::uint8_t buy;
+    std::uint8_t pad[2];
+};
+
+static_assert(sizeof(l2_event) == 32, "l2_event must be 32 bytes");
+
+typedef BroadcastRing<l2_event> L2Feed;
+
+
+class MBOBookImage{
+public:
+    struct order {
+        std::uint64_t size;
+        std::int32_t tick;
+        std::int32_t stop;
+        bool buy;
+        bool is_stop;
+    };
+
+    /* tick -> aggregate (limit) size */
+    typedef std::map<std::int32_t, std::uint64_t> levels_type;
+
+private:
+    std::unordered_map<std::uint64_t, order> _orders;
+    levels_type _bids;
+    levels_type _asks;
+
+    void
+    _remove_size(const order& o, std::uint64_t size);
+
+public:
+    MBOBookImage()
+        :
+            _orders(),
+            _bids(),
+            _asks()
+        {
+        }
+
+    void
+    apply(const mbo_event& e);
+
+    void
+    clear();
+
+    inline const levels_type&
+    bids() const
+    {
+        return _bids;
+    }
+
+    inline const levels_type&
+    asks() const
+    {
+        return _asks;
+    }
+
+    /* -1 if empty */
+    inline std::int32_t
+    best_bid() const
+    {
+        return _bids.empty() ? -1 : _bids.rbegin()->first;
+    }
+
+    inline std::int32_t
+    best_ask() const
+    {
+        return _asks.empty() ? -1 : _asks.begin()->first;
+    }
+
+    /* nullptr if not resting */
+    inline const order*
+    get_order(std::uint64_t id) const
+    {
+        auto iter = _orders.find(id);
+        return (iter == _orders.end()) ? nullptr : &iter->second;
+    }
+
+    inline size_type
+    norders() const
+    {
+        return _orders.size();
+    }
+};
+
+
+
+/* 
+ *   updates are ignored until the first complete refresh; after an overrun
+ *   call reset() and keep applying, the image will resync on the next one
+ *   (the ring has to be able to hold an entire refresh for this to work)
+ */
+class L2BookImage{
+public:
+    /* tick -> aggregate size */
+    typedef std::map<std::int32_t, std::uint64_t> levels_type;
+
+private:
+    levels_type _bids;
+    levels_type _asks;
+    levels_type _refresh_bids;
+    levels_type _refresh_asks;
+    bool _synced;
+    bool _refreshing;
+
+public:
+    L2BookImage()
+        :
+            _bids(),
+            _asks(),
+            _refresh_bids(),
+            _refresh_asks(),
+            _synced(false),
+            _refreshing(false)
+        {
+        }
+
+    void
+    apply(const l2_event& e);
+
+    void
+    reset();
+
+    inline bool
+    synced() const
+    {
+        return _synced;
+    }
+
+    inline const levels_type&
+    bids() const
+    {
+        return _bids;
+    }
+
+    inline const levels_type&
+    asks() const
+    {
+        return _asks;
+    }
+
+    /* -1 if empty */
+    inline std::int32_t
+    best_bid() const
+    {
+        return _bids.empty() ? -1 : _bids.rbegin()->first;
+    }
+
+    inline std::int32_t
+    best_ask() const
+    {
+        return _asks.empty() ? -1 : _asks.begin()->first;
+    }
+};
+
+};
+
+#endif /* JO_0815_EVENT_FEED */
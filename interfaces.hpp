@@ -98,6 +98,10 @@ public:
     virtual order_info_type 
     get_order_info(id_type id, bool search_limits_first=true) = 0;
 
+    /* bytes and objects by memory_component(see types.hpp) */
+    virtual memory_usage_type
+    memory_usage() const = 0;
+
     /* convert time & sales chrono timepoint to str via ctime */
     static std::string 
     timestamp_to_str(const time_stamp_type& tp);
@@ -126,7 +130,8 @@ public:
                        price_type limit, 
                        size_type size,
                        order_exec_cb_type exec_cb,
-                       order_admin_cb_type admin_cb = nullptr) = 0;
+                       order_admin_cb_type admin_cb = nullptr,
+                       owner_type owner = 0) = 0;
 
     virtual id_type
     replace_with_limit_order(id_type id, 
@@ -134,10 +139,63 @@ public:
                              price_type limit,
                              size_type size, 
                              order_exec_cb_type exec_cb,
-                             order_admin_cb_type admin_cb = nullptr) = 0;
+                             order_admin_cb_type admin_cb = nullptr,
+                             owner_type owner = 0) = 0;
+
+    /* rests 'display' at a time(see SimpleOrderbook::insert_iceberg_order) */
+    virtual id_type
+    insert_iceberg_order(bool buy, 
+                         price_type limit,
+                         size_type display,
+                         size_type size,
+                         order_exec_cb_type exec_cb,
+                         order_admin_cb_type admin_cb = nullptr,
+                         owner_type owner = 0) = 0;
+
+    /* 'offset' ticks less aggressive than what it's pegged to */
+    virtual id_type
+    insert_peg_order(bool buy, 
+                     peg_type peg,
+                     size_type size,
+                     order_exec_cb_type exec_cb,
+                     size_type offset = 0,
+                     order_admin_cb_type admin_cb = nullptr,
+                     owner_type owner = 0) = 0;
+
+    virtual id_type
+    insert_ioc_order(bool buy, 
+                     price_type limit,
+                     size_type size,
+                     order_exec_cb_type exec_cb,
+                     order_admin_cb_type admin_cb = nullptr,
+                     owner_type owner = 0) = 0;
+
+    virtual id_type
+    insert_fok_order(bool buy, 
+                     price_type limit,
+                     size_type size,
+                     order_exec_cb_type exec_cb,
+                     order_admin_cb_type admin_cb = nullptr,
+                     owner_type owner = 0) = 0;
 
     virtual bool 
     pull_order(id_type id, bool search_limits_first=true) = 0;
+
+    virtual id_type
+    modify_order(id_type id, size_type size) = 0;
+
+    virtual id_type
+    modify_order(id_type id, price_type limit, size_type size) = 0;
+
+    virtual size_type
+    cancel_all(const cancel_filter& filter = cancel_filter()) = 0;
+
+    virtual quote_ack
+    mass_quote(owner_type session,
+               const quote_levels_type& bids,
+               const quote_levels_type& asks,
+               order_exec_cb_type exec_cb,
+               quote_admin_cb_type admin_cb = nullptr) = 0;
 };
 
 
@@ -171,14 +229,16 @@ public:
     insert_market_order(bool buy, 
                         size_type size, 
                         order_exec_cb_type exec_cb,
-                        order_admin_cb_type admin_cb = nullptr) = 0;
+                        order_admin_cb_type admin_cb = nullptr,
+                        owner_type owner = 0) = 0;
 
     virtual id_type
     insert_stop_order(bool buy, 
                       price_type stop, 
                       size_type size,
                       order_exec_cb_type exec_cb,
-                      order_admin_cb_type admin_cb = nullptr) = 0;
+                      order_admin_cb_type admin_cb = nullptr,
+                      owner_type owner = 0) = 0;
 
     virtual id_type
     insert_stop_order(bool buy, 
@@ -186,14 +246,84 @@ public:
                       price_type limit,
                       size_type size, 
                       order_exec_cb_type exec_cb,
-                      order_admin_cb_type admin_cb = nullptr) = 0;
+                      order_admin_cb_type admin_cb = nullptr,
+                      owner_type owner = 0) = 0;
+
+    /* good-till-time; pulled(w/ a cancel callback) once the book's clock 
+       reaches 'expire'(see SimpleOrderbook::insert_gtt_order) */
+    virtual id_type
+    insert_gtt_order(bool buy, 
+                     price_type limit,
+                     size_type size,
+                     time_stamp_type expire,
+                     order_exec_cb_type exec_cb,
+                     order_admin_cb_type admin_cb = nullptr,
+                     owner_type owner = 0) = 0;
+
+    virtual id_type
+    insert_gtt_stop_order(bool buy, 
+                          price_type stop, 
+                          size_type size,
+                          time_stamp_type expire,
+                          order_exec_cb_type exec_cb,
+                          order_admin_cb_type admin_cb = nullptr,
+                          owner_type owner = 0) = 0;
+
+    virtual id_type
+    insert_gtt_stop_order(bool buy, 
+                          price_type stop, 
+                          price_type limit,
+                          size_type size, 
+                          time_stamp_type expire,
+                          order_exec_cb_type exec_cb,
+                          order_admin_cb_type admin_cb = nullptr,
+                          owner_type owner = 0) = 0;
+
+    /* 'trail' ticks behind the last(see SimpleOrderbook::
+       insert_trailing_stop_order) */
+    virtual id_type
+    insert_trailing_stop_order(bool buy, 
+                               size_type trail, 
+                               size_type size,
+                               order_exec_cb_type exec_cb,
+                               order_admin_cb_type admin_cb = nullptr,
+                               owner_type owner = 0) = 0;
+
+    virtual id_type
+    insert_trailing_stop_limit_order(bool buy, 
+                                     size_type trail, 
+                                     size_type limit_offset,
+                                     size_type size,
+                                     order_exec_cb_type exec_cb,
+                                     order_admin_cb_type admin_cb = nullptr,
+                                     owner_type owner = 0) = 0;
+
+    /* returns the ids of 'legs', in order(see SimpleOrderbook::
+       insert_oco_order) */
+    virtual std::vector<id_type>
+    insert_oco_order(const order_legs_type& legs,
+                     order_exec_cb_type exec_cb,
+                     group_admin_cb_type admin_cb = nullptr,
+                     owner_type owner = 0) = 0;
+
+    /* returns the ids of the entry, take-profit and stop-loss */
+    virtual std::vector<id_type>
+    insert_bracket_order(bool buy,
+                         price_type limit,
+                         size_type size,
+                         price_type profit,
+                         price_type loss,
+                         order_exec_cb_type exec_cb,
+                         group_admin_cb_type admin_cb = nullptr,
+                         owner_type owner = 0) = 0;
 
     virtual id_type
     replace_with_market_order(id_type id, 
                               bool buy, 
                               size_type size,
                               order_exec_cb_type exec_cb,
-                              order_admin_cb_type admin_cb = nullptr) = 0;
+                              order_admin_cb_type admin_cb = nullptr,
+                              owner_type owner = 0) = 0;
 
     virtual id_type
     replace_with_stop_order(id_type id, 
@@ -201,7 +331,8 @@ public:
                             price_type stop, 
                             size_type size,
                             order_exec_cb_type exec_cb,
-                            order_admin_cb_type admin_cb = nullptr) = 0;
+                            order_admin_cb_type admin_cb = nullptr,
+                            owner_type owner = 0) = 0;
 
     virtual id_type
     replace_with_stop_order(id_type id, 
@@ -210,7 +341,8 @@ public:
                             price_type limit, 
                             size_type size,
                             order_exec_cb_type exec_cb,
-                            order_admin_cb_type admin_cb = nullptr) = 0;
+                            order_admin_cb_type admin_cb = nullptr,
+                            owner_type owner = 0) = 0;
 
     virtual void 
     dump_buy_limits() const = 0;
@@ -0,0 +1,145 @@
+/*
+Copyright (C) 2015 Jonathon Ogden  < jeog.dev@gmail.com >
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program. If not, see http://www.gnu.org/licenses.
+*/
+
+#include "latencystats.hpp"
+
+#include <cmath>
+#include <algorithm>
+#include <iomanip>
+
+namespace NativeLayer{
+
+std::string
+latency_stage_str(const latency_stage& ls)
+{
+    switch(ls){
+    case latency_stage::queue:
+        return "queue";
+        /* no break */
+    case latency_stage::route:
+        return "route";
+        /* no break */
+    case latency_stage::callback:
+        return "callback";
+        /* no break */
+    default:
+        return "total";
+    }
+}
+
+
+LatencyHistogram::LatencyHistogram()
+    {
+        reset();
+    }
+
+
+std::uint64_t
+LatencyHistogram::_bucket_high(int i)
+{
+    int shift;
+
+    if(i < sub_buckets)
+        return i;
+
+    shift = i / sub_buckets - 1;
+    return ((std::uint64_t)(i % sub_buckets + sub_buckets + 1) << shift) - 1;
+}
+
+
+void
+LatencyHistogram::reset()
+{
+    for(int i = 0; i < nbuckets; ++i)
+        _counts[i].store(0, std::memory_order_relaxed);
+
+    _count.store(0, std::memory_order_relaxed);
+    _sum.store(0, std::memory_order_relaxed);
+    _min.store(UINT64_MAX, std::memory_order_relaxed);
+    _max.store(0, std::memory_order_relaxed);
+}
+
+
+std::uint64_t
+LatencyHistogram::percentile(double percentile) const
+{
+    std::uint64_t total, target, seen;
+
+    total = 0;
+    for(int i = 0; i < nbuckets; ++i)
+        total += _counts[i].load(std::memory_order_relaxed);
+
+    if(!total)
+        return 0;
+
+    percentile = std::min(std::max(percentile, 0.0), 100.0);
+    target = std::max((std::uint64_t)std::ceil(percentile / 100.0 * total),
+                      (std::uint64_t)1);
+
+    seen = 0;
+    for(int i = 0; i < nbuckets; ++i){
+        seen += _counts[i].load(std::memory_order_relaxed);
+        if(seen >= target)
+            return std::min(_bucket_high(i), max());
+    }
+
+    return max();
+}
+
+
+void
+LatencyStats::reset()
+{
+    for(int t = 0; t < ntypes; ++t){
+        for(int s = 0; s < nstages; ++s)
+            _hists[t][s].reset();
+    }
+}
+
+
+std::ostream&
+operator<<(std::ostream& out, const LatencyStats& ls)
+{
+    out<< std::left << std::setw(12) << "type" << std::setw(10) << "stage"
+       << std::right << std::setw(10) << "n" << std::setw(10) << "mean"
+       << std::setw(10) << "p50" << std::setw(10) << "p90"
+       << std::setw(10) << "p99" << std::setw(10) << "p99.9"
+       << std::setw(12) << "max(ns)" << std::endl;
+
+    for(int t = 0; t < norder_types; ++t){
+        for(int s = 0; s < 4; ++s){
+            const LatencyHistogram& h = ls.histogram((order_type)t, (latency_stage)s);
+            if(!h.count())
+                continue;
+
+            out<< std::left << std::setw(12)
+               << (t ? order_type_str((order_type)t) : std::string("pull/modify"))
+               << std::setw(10) << latency_stage_str((latency_stage)s)
+               << std::right << std::setw(10) << h.count()
+               << std::setw(10) << (std::uint64_t)h.mean()
+               << std::setw(10) << h.percentile(50)
+               << std::setw(10) << h.percentile(90)
+               << std::setw(10) << h.percentile(99)
+               << std::setw(10) << h.percentile(99.9)
+               << std::setw(12) << h.max() << std::endl;
+        }
+    }
+
+    return out;
+}
+
+};
@@ -0,0 +1,203 @@
+/*
+Copyright (C) 2015 Jonathon Ogden     < jeog.dev@gmail.com >
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see http://www.gnu.org/licenses.
+*/
+
+#ifndef JO_0815_LATENCY_STATS
+#define JO_0815_LATENCY_STATS
+
+#include <cstdint>
+#include <atomic>
+#include <iostream>
+
+#include "types.hpp"
+
+namespace NativeLayer{
+
+/*
+ *   LatencyHistogram is a log-bucketed(HDR-style) histogram of nanosecond
+ *   values: each power of 2 is split into 32 linear sub-buckets, so any
+ *   recorded value is reported within ~3% from 1ns up to ~18 minutes(values
+ *   past that are clamped). Recording is a handful of relaxed atomic ops and
+ *   can be done from any thread; queries and reset() don't lock either, so
+ *   they may be off by the few records that race with them.
+ *
+ *   LatencyStats holds one histogram per order type and stage(see
+ *   SimpleOrderbook::enable_latency_stats):
+ *
+ *       queue    : enqueue -> dequeue by the order dispatcher
+ *       route    : dequeue -> end of _route_order(matching, stop triggers)
+ *       callback : caller released -> its callbacks delivered
+ *       total    : enqueue -> callbacks delivered, as seen by the caller
+ *
+ *   total minus the other three is the time it took to release the caller
+ *   (journal commit, if any, and thread wake-up). Orders generated by
+ *   triggered stops have no caller: only queue and route are recorded. Pulls
+ *   and modifies are recorded under order_type::null.
+ */
+
+enum class latency_stage {
+    queue = 0,
+    route,
+    callback,
+    total
+};
+
+std::string latency_stage_str(const latency_stage& ls);
+
+
+class LatencyHistogram{
+public:
+    static const int sub_bucket_bits = 5;
+    static const int sub_buckets = 1 << sub_bucket_bits;
+    static const int magnitudes = 36;
+    static const int nbuckets = (magnitudes + 1) * sub_buckets;
+
+private:
+    std::atomic<std::uint64_t> _counts[nbuckets];
+    std::atomic<std::uint64_t> _count;
+    std::atomic<std::uint64_t> _sum;
+    std::atomic<std::uint64_t> _min;
+    std::atomic<std::uint64_t> _max;
+
+    static inline int
+    _msb(std::uint64_t v)
+    {
+#ifdef __GNUC__
+        return 63 - __builtin_clzll(v);
+#else
+        int b = 0;
+        while(v >>= 1)
+            ++b;
+        return b;
+#endif
+    }
+
+    static inline int
+    _index(std::uint64_t v)
+    {
+        int shift, i;
+
+        if(v < (std::uint64_t)sub_buckets)
+            return (int)v;
+
+        shift = _msb(v) - sub_bucket_bits;
+        i = (shift + 1) * sub_buckets + (int)((v >> shift) - sub_buckets);
+        return (i < nbuckets) ? i : nbuckets - 1;
+    }
+
+    /* highest value that lands in bucket i */
+    static std::uint64_t
+    _bucket_high(int i);
+
+    /* restrict copy / assign */
+    LatencyHistogram(const LatencyHistogram& lh);
+    LatencyHistogram& operator=(const LatencyHistogram& lh);
+
+public:
+    LatencyHistogram();
+
+    inline void
+    record(std::uint64_t ns)
+    {
+        std::uint64_t m;
+
+        _counts[_index(ns)].fetch_add(1, std::memory_order_relaxed);
+        _count.fetch_add(1, std::memory_order_relaxed);
+        _sum.fetch_add(ns, std::memory_order_relaxed);
+
+        m = _max.load(std::memory_order_relaxed);
+        while(ns > m && !_max.compare_exchange_weak(m, ns, std::memory_order_relaxed))
+            {
+            }
+
+        m = _min.load(std::memory_order_relaxed);
+        while(ns < m && !_min.compare_exchange_weak(m, ns, std::memory_order_relaxed))
+            {
+            }
+    }
+
+    void
+    reset();
+
+    /* value(ns) that 'percentile'(0 - 100) of the records are at or below */
+    std::uint64_t
+    percentile(double percentile) const;
+
+    inline std::uint64_t
+    count() const
+    {
+        return _count.load(std::memory_order_relaxed);
+    }
+
+    inline double
+    mean() const
+    {
+        std::uint64_t n = count();
+        return n ? (double)_sum.load(std::memory_order_relaxed) / n : 0;
+    }
+
+    inline std::uint64_t
+    min() const
+    {
+        return count() ? _min.load(std::memory_order_relaxed) : 0;
+    }
+
+    inline std::uint64_t
+    max() const
+    {
+        return _max.load(std::memory_order_relaxed);
+    }
+};
+
+
+class LatencyStats{
+    static const int ntypes = norder_types;
+    static const int nstages = 4;
+
+    LatencyHistogram _hists[ntypes][nstages];
+
+    /* restrict copy / assign */
+    LatencyStats(const LatencyStats& ls);
+    LatencyStats& operator=(const LatencyStats& ls);
+
+public:
+    LatencyStats()
+        {
+        }
+
+    inline void
+    record(order_type oty, latency_stage stage, clock_type::duration d)
+    {
+        long long ns = std::chrono::duration_cast<std::chrono::nanoseconds>(d).count();
+        _hists[(int)oty][(int)stage].record(ns > 0 ? ns : 0);
+    }
+
+    inline const LatencyHistogram&
+    histogram(order_type oty, latency_stage stage) const
+    {
+        return _hists[(int)oty][(int)stage];
+    }
+
+    void
+    reset();
+};
+
+/* count, mean and percentiles of every non-empty histogram */
+std::ostream& operator<<(std::ostream& out, const LatencyStats& ls);
+
+};
+
+#endif /* JO_0815_LATENCY_STATS */
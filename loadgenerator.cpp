@@ -0,0 +1,278 @@
+/*
+Copyright (C) 2015 Jonathon Ogden  < jeog.dev@gmail.com >
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program. If not, see http://www.gnu.org/licenses.
+*/
+
+#include "loadgenerator.hpp"
+
+#include <cmath>
+#include <algorithm>
+#include <iomanip>
+#include <thread>
+#include <stdexcept>
+
+namespace NativeLayer{
+
+LoadGenerator::LoadGenerator(SimpleOrderbook::FullInterface& book,
+                             const loadgen_config& cfg)
+    :
+        _book(book),
+        _cfg(cfg),
+        _cancel_misses(0),
+        _fills(0),
+        _budget(0),
+        _seconds(0)
+    {
+        if(!_cfg.nthreads)
+            throw std::invalid_argument("loadgen needs at least one thread");
+        if(_cfg.tick <= 0 || _cfg.max_price < _cfg.min_price)
+            throw std::invalid_argument("loadgen needs a tick and a price range");
+        if(_cfg.size_alpha <= 0 || !_cfg.size_min || _cfg.size_max < _cfg.size_min)
+            throw std::invalid_argument("loadgen needs a valid size distribution");
+
+        _cfg.cross_ticks = std::max(_cfg.cross_ticks, 1);
+        _cfg.stop_ticks = std::max(_cfg.stop_ticks, 1);
+        _cfg.depth_ticks = std::max(_cfg.depth_ticks, 1.0);
+        _cfg.max_live = std::max(_cfg.max_live, (size_type)1);
+
+        for(int i = 0; i < norder_types; ++i){
+            _calls[i].store(0);
+            _rejected[i].store(0);
+        }
+    }
+
+
+price_type
+LoadGenerator::_price(price_type last, long long ticks) const
+{
+    double p = (std::llround(last / _cfg.tick) + ticks) * _cfg.tick;
+    return (price_type)std::min(std::max(p, (double)_cfg.min_price),
+                                (double)_cfg.max_price);
+}
+
+
+void
+LoadGenerator::_produce(unsigned n, unsigned seed, clock_type::time_point end)
+{
+    std::default_random_engine eng(seed + n * 7919);
+    std::uniform_real_distribution<double> uni(0.0, 1.0);
+    std::exponential_distribution<double> arrival(
+        _cfg.rate > 0 ? _cfg.rate / _cfg.nthreads : 1.0
+    );
+    std::geometric_distribution<int> depth(1.0 / _cfg.depth_ticks);
+    std::uniform_int_distribution<int> stop_dist(1, _cfg.stop_ticks);
+    std::vector<id_type> live;
+    clock_type::time_point next, t0;
+    large_size_type budget;
+    order_type oty;
+    price_type last, stop;
+    size_type size;
+    id_type id;
+    bool buy;
+    long long ticks;
+    size_t i;
+    double r = 0;
+
+    double pcancel = _cfg.cancel_ratio / (1.0 + _cfg.cancel_ratio);
+
+    order_exec_cb_type cb =
+        [this](callback_msg msg, id_type, price_type, size_type){
+            if(msg == callback_msg::fill)
+                _fills.fetch_add(1, std::memory_order_relaxed);
+        };
+
+    live.reserve(_cfg.max_live);
+    next = clock_type::now();
+
+    for( ; ; ){
+        if(_cfg.norders){
+            budget = _budget.load();
+            do{
+                if(!budget)
+                    return;
+            }while( !_budget.compare_exchange_weak(budget, budget - 1) );
+        }
+
+        if(_cfg.rate > 0){
+            next += std::chrono::duration_cast<clock_type::duration>(
+                std::chrono::duration<double>(arrival(eng))
+            );
+            if(next >= end)
+                return;
+            std::this_thread::sleep_until(next);
+            t0 = next;
+        }else{
+            t0 = clock_type::now();
+            if(t0 >= end)
+                return;
+        }
+
+        if(live.size() >= _cfg.max_live || (!live.empty() && uni(eng) < pcancel))
+        {
+            oty = order_type::null;
+            i = (size_t)(uni(eng) * live.size()) % live.size();
+            id = live[i];
+            live[i] = live.back();
+            live.pop_back();
+        }else{
+            r = uni(eng);
+            if(r < _cfg.stops)
+                oty = (uni(eng) < .5) ? order_type::stop : order_type::stop_limit;
+            else if(r < _cfg.stops + _cfg.marketable)
+                oty = (uni(eng) < .5) ? order_type::market : order_type::limit;
+            else
+                oty = order_type::limit;
+            /* pareto, truncated */
+            size = (size_type)std::min(
+                _cfg.size_min * std::pow(1.0 - uni(eng), -1.0 / _cfg.size_alpha),
+                (double)_cfg.size_max
+            );
+            buy = uni(eng) < .5;
+        }
+
+        try{
+            switch(oty){
+            case order_type::null:
+                if( !_book.pull_order(id) )
+                    _cancel_misses.fetch_add(1, std::memory_order_relaxed);
+                break;
+            case order_type::market:
+                _book.insert_market_order(buy, size, cb);
+                break;
+            case order_type::limit:
+                last = _book.last_price();
+                ticks = (r < _cfg.stops + _cfg.marketable)
+                      ? _cfg.cross_ticks
+                      : -(1 + depth(eng));
+                id = _book.insert_limit_order(buy, _price(last, buy ? ticks : -ticks),
+                                              size, cb);
+                live.push_back(id);
+                break;
+            default: /* stop, stop_limit */
+                last = _book.last_price();
+                ticks = stop_dist(eng);
+                stop = _price(last, buy ? ticks : -ticks);
+                id = (oty == order_type::stop)
+                   ? _book.insert_stop_order(buy, stop, size, cb)
+                   : _book.insert_stop_order(buy, stop, stop, size, cb);
+                live.push_back(id);
+                break;
+            }
+        }catch(std::exception& e){
+            _rejected[(int)oty].fetch_add(1, std::memory_order_relaxed);
+        }
+
+        _latency[(int)oty].record(
+            std::chrono::duration_cast<std::chrono::nanoseconds>(
+                clock_type::now() - t0
+            ).count()
+        );
+        _calls[(int)oty].fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+
+loadgen_report
+LoadGenerator::run()
+{
+    std::vector<std::thread> producers;
+    clock_type::time_point start, end;
+    loadgen_report lr;
+    unsigned seed;
+
+    if(_cfg.seconds <= 0 && !_cfg.norders)
+        throw std::invalid_argument("loadgen needs seconds or norders");
+
+    for(int i = 0; i < norder_types; ++i){
+        _latency[i].reset();
+        _calls[i].store(0);
+        _rejected[i].store(0);
+    }
+    _cancel_misses.store(0);
+    _fills.store(0);
+    _budget.store(_cfg.norders);
+
+    seed = _cfg.seed ? _cfg.seed
+                     : (unsigned)clock_type::now().time_since_epoch().count();
+
+    start = clock_type::now();
+    end = (_cfg.seconds > 0)
+        ? start + std::chrono::duration_cast<clock_type::duration>(
+                      std::chrono::duration<double>(_cfg.seconds) )
+        : clock_type::time_point::max();
+
+    for(unsigned n = 0; n < _cfg.nthreads; ++n){
+        producers.push_back(
+            std::thread(&LoadGenerator::_produce, this, n, seed, end)
+        );
+    }
+    for(auto & t : producers)
+        t.join();
+
+    _seconds = std::chrono::duration<double>(clock_type::now() - start).count();
+
+    for(int i = 0; i < norder_types; ++i){
+        lr.calls[i] = _calls[i].load();
+        lr.rejected[i] = _rejected[i].load();
+    }
+    lr.cancel_misses = _cancel_misses.load();
+    lr.fills = _fills.load();
+    lr.seconds = _seconds;
+    return lr;
+}
+
+
+void
+LoadGenerator::print(std::ostream& out, const loadgen_report& lr) const
+{
+    out<< lr << std::endl
+       << std::left << std::setw(12) << "type"
+       << std::right << std::setw(10) << "n" << std::setw(10) << "mean"
+       << std::setw(10) << "p50" << std::setw(10) << "p90"
+       << std::setw(10) << "p99" << std::setw(10) << "p99.9"
+       << std::setw(12) << "max(ns)" << std::endl;
+
+    for(int t = 0; t < norder_types; ++t){
+        const LatencyHistogram& h = _latency[t];
+        if(!h.count())
+            continue;
+
+        out<< std::left << std::setw(12)
+           << (t ? order_type_str((order_type)t) : std::string("pull"))
+           << std::right << std::setw(10) << h.count()
+           << std::setw(10) << (std::uint64_t)h.mean()
+           << std::setw(10) << h.percentile(50)
+           << std::setw(10) << h.percentile(90)
+           << std::setw(10) << h.percentile(99)
+           << std::setw(10) << h.percentile(99.9)
+           << std::setw(12) << h.max() << std::endl;
+    }
+}
+
+
+std::ostream&
+operator<<(std::ostream& out, const loadgen_report& lr)
+{
+    out<< lr.total_calls() << " calls in " << lr.seconds << " sec ("
+       << (large_size_type)lr.calls_per_sec() << "/sec): ";
+    for(int t = 0; t < norder_types; ++t){
+        out<< (t ? order_type_str((order_type)t) : std::string("pull"))
+           << " " << lr.calls[t] << "(" << lr.rejected[t] << " rejected), ";
+    }
+    return out<< lr.cancel_misses << " pulls of orders already gone, "
+              << lr.fills << " fill callbacks";
+}
+
+};
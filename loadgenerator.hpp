@@ -0,0 +1,176 @@
+/*
+Copyright (C) 2015 Jonathon Ogden     < jeog.dev@gmail.com >
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see http://www.gnu.org/licenses.
+*/
+
+#ifndef JO_0815_LOAD_GENERATOR
+#define JO_0815_LOAD_GENERATOR
+
+#include <atomic>
+#include <iostream>
+#include <random>
+#include <vector>
+
+#include "types.hpp"
+#include "interfaces.hpp"
+#include "latencystats.hpp"
+
+namespace NativeLayer{
+
+/*
+ *   LoadGenerator drives a FullInterface with synthetic order flow from
+ *   'nthreads' producer threads, each with its own seeded random engine:
+ *
+ *       arrivals   : Poisson at 'rate' orders/sec(split evenly across the
+ *                    producers), or back-to-back if rate is 0
+ *       sizes      : power-law(Pareto, exponent 'size_alpha') from size_min,
+ *                    truncated at size_max
+ *       cancels    : 'cancel_ratio' pulls per insert, of a random order the
+ *                    producer inserted earlier(it may have filled already)
+ *       marketable : 'marketable' of the inserts cross: half market orders,
+ *                    half limits 'cross_ticks' through the last price
+ *       stops      : 'stops' of the inserts are stops/stop-limits 1 to
+ *                    'stop_ticks' away from the last price
+ *       passive    : the rest are limits a geometric(mean 'depth_ticks')
+ *                    number of ticks behind the last price
+ *
+ *   Prices are on the 'tick' grid and clamped to [min_price, max_price].
+ *   A producer with 'max_live' orders outstanding pulls instead of
+ *   inserting. run() blocks for 'seconds' or until 'norders' calls in total
+ *   have been made, whichever comes first(0 = no limit).
+ *
+ *   Latency is the time the call into the book took, per order type(pulls
+ *   under order_type::null); when paced it's measured from the scheduled
+ *   arrival so a stalled book shows up as latency, not a lower rate.
+ *
+ *   The producers call into the book concurrently so it must not be in 
+ *   direct mode.
+ */
+
+struct loadgen_config {
+    unsigned nthreads;
+    double rate;
+    double seconds;
+    large_size_type norders;
+    double tick;
+    price_type min_price;
+    price_type max_price;
+    double size_alpha;
+    size_type size_min;
+    size_type size_max;
+    double cancel_ratio;
+    double marketable;
+    int cross_ticks;
+    double stops;
+    int stop_ticks;
+    double depth_ticks;
+    size_type max_live;
+    unsigned seed; /* 0 = from the clock */
+
+    loadgen_config()
+        :
+            nthreads(4),
+            rate(0),
+            seconds(5),
+            norders(0),
+            tick(.01),
+            min_price(0),
+            max_price(0),
+            size_alpha(1.5),
+            size_min(1),
+            size_max(10000),
+            cancel_ratio(.5),
+            marketable(.1),
+            cross_ticks(5),
+            stops(.02),
+            stop_ticks(10),
+            depth_ticks(5),
+            max_live(1000),
+            seed(0)
+        {
+        }
+};
+
+
+struct loadgen_report {
+    large_size_type calls[norder_types]; /* by order_type; null = pulls */
+    large_size_type rejected[norder_types];
+    large_size_type cancel_misses; /* pulls of orders already gone */
+    large_size_type fills; /* fill callbacks(both sides are ours) */
+    double seconds;
+
+    inline large_size_type
+    total_calls() const
+    {
+        large_size_type n = 0;
+        for(int i = 0; i < norder_types; ++i)
+            n += calls[i];
+        return n;
+    }
+
+    inline double
+    calls_per_sec() const
+    {
+        return seconds > 0 ? total_calls() / seconds : 0;
+    }
+};
+
+std::ostream& operator<<(std::ostream& out, const loadgen_report& lr);
+
+
+class LoadGenerator{
+    SimpleOrderbook::FullInterface& _book;
+    loadgen_config _cfg;
+    LatencyHistogram _latency[norder_types];
+    std::atomic<large_size_type> _calls[norder_types];
+    std::atomic<large_size_type> _rejected[norder_types];
+    std::atomic<large_size_type> _cancel_misses;
+    std::atomic<large_size_type> _fills;
+    std::atomic<large_size_type> _budget; /* calls left if norders */
+    double _seconds;
+
+    /* producer 'n' seeds its engine from 'seed' and n */
+    void
+    _produce(unsigned n, unsigned seed, clock_type::time_point end);
+
+    price_type
+    _price(price_type last, long long ticks) const;
+
+    /* restrict copy / assign */
+    LoadGenerator(const LoadGenerator& lg);
+    LoadGenerator& operator=(const LoadGenerator& lg);
+
+public:
+    LoadGenerator(SimpleOrderbook::FullInterface& book,
+                  const loadgen_config& cfg);
+
+    /* BLOCKING; resets the previous run's results */
+    loadgen_report
+    run();
+
+    inline const LatencyHistogram&
+    latency(order_type oty) const
+    {
+        return _latency[(int)oty];
+    }
+
+    /* report plus latency percentiles by order type */
+    void
+    print(std::ostream& out, const loadgen_report& lr) const;
+};
+
+};
+
+#endif /* JO_0815_LOAD_GENERATOR */
@@ -66,7 +66,8 @@ MarketMaker::MarketMaker(order_exec_cb_type callback)
         _offer_out(0),
         _pos(0),
         _recurse_count(0),
-        _tot_recurse_count(0)
+        _tot_recurse_count(0),
+        _session(next_session++)
     {
     }
 
@@ -77,6 +78,8 @@ MarketMaker::MarketMaker(MarketMaker&& mm) noexcept /* see notes in header */
         _callback_ext( mm._callback_ext ),
         _callback( std::move(mm._callback) ),
         _my_orders( std::move(mm._my_orders) ),
+        _bid_index( std::move(mm._bid_index) ),
+        _offer_index( std::move(mm._offer_index) ),
         _is_running(mm._is_running),
         _mtx(),
         _this_fill( std::move(mm._this_fill) ),
@@ -86,7 +89,8 @@ MarketMaker::MarketMaker(MarketMaker&& mm) noexcept /* see notes in header */
         _offer_out(mm._offer_out),
         _pos(mm._pos),
         _recurse_count(mm._recurse_count),
-        _tot_recurse_count(mm._tot_recurse_count)
+        _tot_recurse_count(mm._tot_recurse_count),
+        _session(mm._session)
     {
         if(&mm == this)
             throw move_error("can't move to ourself");
@@ -97,6 +101,8 @@ MarketMaker::MarketMaker(MarketMaker&& mm) noexcept /* see notes in header */
         mm._callback_ext = nullptr;
         mm._callback = nullptr;
         mm._my_orders.clear();
+        mm._bid_index.clear();
+        mm._offer_index.clear();
         mm._is_running = false;
         mm._bid_out = 0;
         mm._offer_out = 0;
@@ -125,12 +131,54 @@ MarketMaker::stop()
     _book = nullptr;
 }
 
+
+quote_ack
+MarketMaker::quote(const quote_levels_type& bids, const quote_levels_type& asks)
+{
+    if(!_is_running)
+        throw invalid_state("market/market-maker is not in a running state");
+
+    std::lock_guard<std::recursive_mutex> rlock(_mtx);
+
+    if(_recurse_count > RECURSE_LIMIT){
+        _recurse_count = 0; /* see insert<> */
+        throw callback_overflow("market maker trying to quote after exceeding the"
+                                " recursion limit set for the callback stack");
+    }
+
+    return _book->mass_quote(
+        _session, 
+        bids, 
+        asks, 
+        dynamic_functor_wrap(_callback),
+        [=](const quote_ack& ack)
+        {
+            /* 
+             * like insert<>'s admin callback: before any callbacks for the
+             * quote's orders(pulled ones get cancel callbacks)
+             */
+            for(const quote_order_type& o : ack.orders){
+                auto iter = _my_orders.find(std::get<0>(o));
+                if(iter != _my_orders.end()){
+                    (std::get<1>(o) ? _bid_out : _offer_out) -= 
+                        std::get<2>(iter->second);
+                }
+                _add_order(std::get<0>(o), std::get<1>(o), std::get<2>(o), 
+                           std::get<3>(o));
+                (std::get<1>(o) ? _bid_out : _offer_out) += std::get<3>(o);
+            }
+        }
+    );
+}
+
+
 void 
 MarketMaker::_base_callback( callback_msg msg,
                              id_type id,
                              price_type price,
                              size_type size )
 {
+    orders_map_type::iterator iter;
     order_bndl_type ob;
     long long rem;
 
@@ -139,6 +187,7 @@ MarketMaker::_base_callback( callback_msg msg,
     /* FILL */
     case callback_msg::fill:
     {        
+        iter = _my_orders.find(id);
         ob = _my_orders.at(id);         
         rem = std::get<2>(ob) - size;
         
@@ -153,24 +202,34 @@ MarketMaker::_base_callback( callback_msg msg,
             _offer_out -= size;
         }
 
+        /* (keep the order's price, a fill can be at a better one) */
         if(rem <= 0)
-            _my_orders.erase(id);        
+            _erase_order(iter);        
         else
-            _my_orders[id] = order_bndl_type(this_fill_was_buy(), price, rem);        
+            std::get<2>(iter->second) = rem;        
     }
     break;
 
     /* CANCEL */
     case callback_msg::cancel:
     {
+        iter = _my_orders.find(id);
         ob = _my_orders.at(id); /* THROW */
 
+        /* size 0(a pull) is all of it; a self-trade decrement is part of it */
+        if(!size || size > std::get<2>(ob))
+            size = std::get<2>(ob);
+        rem = std::get<2>(ob) - size;
+
         if(std::get<0>(ob))
-            _bid_out -= std::get<2>(ob);
+            _bid_out -= size;
         else
-            _offer_out -= std::get<2>(ob);
+            _offer_out -= size;
 
-        _my_orders.erase(id);
+        if(rem <= 0)
+            _erase_order(iter);
+        else
+            std::get<2>(iter->second) = rem;
     }
     break;
 
@@ -185,6 +244,28 @@ MarketMaker::_base_callback( callback_msg msg,
 }
 
 
+void
+MarketMaker::_add_order(id_type id, bool buy, price_type price, size_type size)
+{
+    auto iter = _my_orders.find(id);
+    if(iter != _my_orders.end()){
+        _index(std::get<0>(iter->second)).erase( _index_key(id, iter->second) );
+        iter->second = order_bndl_type(buy, price, size);
+    }else{
+        iter = _my_orders.insert( orders_value_type(id, order_bndl_type(buy, price, size)) ).first;
+    }
+    _index(buy).insert( _index_key(id, iter->second) );
+}
+
+
+void
+MarketMaker::_erase_order(orders_map_type::iterator iter)
+{
+    _index(std::get<0>(iter->second)).erase( _index_key(iter->first, iter->second) );
+    _my_orders.erase(iter);
+}
+
+
 market_makers_type 
 MarketMaker::Factory(init_list_type il)
 {
@@ -387,6 +468,18 @@ MarketMaker_Random::_gen_seed()
 }
 
 
+void
+MarketMaker_Random::seed(unsigned long long s)
+{
+    _rand_engine.seed( 
+        (std::default_random_engine::result_type)
+            (s % std::numeric_limits<long>::max()) 
+    );
+    _distr.reset();
+    _distr2.reset();
+}
+
+
 void 
 MarketMaker_Random::start(NativeLayer::SimpleOrderbook::LimitInterface *book,
                           price_type implied,
@@ -561,6 +654,318 @@ MarketMaker_Random::Factory(size_type n,
     return mms;
 }
 
+namespace{
+
+/* spread a seed across the agents' RNG states */
+inline std::uint64_t
+splitmix64(std::uint64_t x)
+{
+    x += 0x9E3779B97F4A7C15ULL;
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+    return x ^ (x >> 31);
+}
+
+};
+
+
+MarketMaker_Bulk::MarketMaker_Bulk(size_type nagents,
+                                   size_type sz,
+                                   size_type max_pos,
+                                   size_type max_spread,
+                                   unsigned long long seed)
+    :
+        my_base_type(),
+        _nagents(nagents),
+        _sz(sz),
+        _max_pos(max_pos ? max_pos : 1),
+        _max_spread(max_spread ? max_spread : 1),
+        _mid(0),
+        _unallocated(0),
+        _apos(nagents, 0),
+        _abid_out(nagents, 0),
+        _aoffer_out(nagents, 0),
+        _abid_off(nagents, 1),
+        _aask_off(nagents, 1),
+        _ahalf(nagents, 1),
+        _alast(nagents, 0),
+        _arng(nagents, 0),
+        _prev_mid(0),
+        _pbid_out(nagents, 0),
+        _poffer_out(nagents, 0),
+        _pbid_off(nagents, 1),
+        _pask_off(nagents, 1),
+        _quote_ids(),
+        _bid_ladder(2 * _max_spread + 2, 0),
+        _ask_ladder(2 * _max_spread + 2, 0)
+    {
+        if(!nagents)
+            throw std::invalid_argument("MarketMaker_Bulk needs at least one agent");
+
+        if(!seed)
+            seed = clock_type::now().time_since_epoch().count() 
+                   ^ (unsigned long long)this;
+
+        _seed_agents(seed);
+    }
+
+
+MarketMaker_Bulk::MarketMaker_Bulk(MarketMaker_Bulk&& mm) noexcept
+    :   
+        my_base_type(std::move(mm)), /* my_base takes care of rebinding dynamic functor */
+        _nagents(mm._nagents),
+        _sz(mm._sz),
+        _max_pos(mm._max_pos),
+        _max_spread(mm._max_spread),
+        _mid(mm._mid),
+        _unallocated(mm._unallocated),
+        _apos(std::move(mm._apos)),
+        _abid_out(std::move(mm._abid_out)),
+        _aoffer_out(std::move(mm._aoffer_out)),
+        _abid_off(std::move(mm._abid_off)),
+        _aask_off(std::move(mm._aask_off)),
+        _ahalf(std::move(mm._ahalf)),
+        _alast(std::move(mm._alast)),
+        _arng(std::move(mm._arng)),
+        _prev_mid(mm._prev_mid),
+        _pbid_out(std::move(mm._pbid_out)),
+        _poffer_out(std::move(mm._poffer_out)),
+        _pbid_off(std::move(mm._pbid_off)),
+        _pask_off(std::move(mm._pask_off)),
+        _quote_ids(std::move(mm._quote_ids)),
+        _bid_ladder(std::move(mm._bid_ladder)),
+        _ask_ladder(std::move(mm._ask_ladder))
+    {
+    }
+
+
+void
+MarketMaker_Bulk::seed(unsigned long long s)
+{
+    _seed_agents(s);
+}
+
+
+void
+MarketMaker_Bulk::_seed_agents(unsigned long long seed)
+{
+    for(size_type i = 0; i < _nagents; ++i){
+        _arng[i] = splitmix64(seed + i) | 1; /* xorshift state can't be 0 */
+        _ahalf[i] = 1 + (long long)(_arng[i] % _max_spread);
+    }
+}
+
+
+void 
+MarketMaker_Bulk::start(NativeLayer::SimpleOrderbook::LimitInterface *book,
+                        price_type implied,
+                        price_type tick)
+{
+    my_base_type::start(book,implied,tick);
+
+    try{
+        _requote(implied);
+    }catch(invalid_order& e){
+        std::cerr<< e.what() << std::endl;
+    }
+}
+
+
+void
+MarketMaker_Bulk::_requote(price_type price)
+{
+    const long long mid = _to_ticks(price);
+    const long long s = _max_spread;
+    const long long lim = 2 * s + 1;
+    const long long sz = _sz;
+    const long long max_pos = _max_pos;
+    const size_type n = _nagents;
+    const long long skew_mul = (s << 32) / max_pos; /* (no divide in the loop) */
+    long long half, skew;
+    std::uint64_t r;
+    size_type i;
+
+    /* the last quote becomes the previous one; its fills may still come */
+    std::swap(_prev_mid, _mid);
+    _pbid_out.swap(_abid_out);
+    _poffer_out.swap(_aoffer_out);
+    _pbid_off.swap(_abid_off);
+    _pask_off.swap(_aask_off);
+
+    std::uint64_t *rng = _arng.data();
+    const long long *pos = _apos.data();
+    const long long *hlf = _ahalf.data();
+    long long *boff = _abid_off.data();
+    long long *aoff = _aask_off.data();
+    long long *bout = _abid_out.data();
+    long long *aout = _aoffer_out.data();
+
+    /* 
+     * two passes, no branches(min/max only), over contiguous arrays so the
+     * compiler can vectorize them(e.g -O3 -mavx2): step the RNGs(a tick of
+     * noise on the half spread); then skew the half spread against the 
+     * position(s ticks at +/- max_pos) and size each side to stay within 
+     * max_pos. (The RNG pass is separate so the uint64 and long long arrays
+     * don't have to be proven not to alias.)
+     */
+    for(i = 0; i < n; ++i){
+        r = rng[i];
+        r ^= r << 13;
+        r ^= r >> 7;
+        r ^= r << 17;
+        rng[i] = r;
+        boff[i] = hlf[i] + (long long)(r >> 63);
+    }
+
+    for(i = 0; i < n; ++i){
+        half = boff[i];
+        skew = std::min(std::max((pos[i] * skew_mul) >> 32, -s), s);
+
+        boff[i] = std::min(std::max(half + skew, 1LL), lim);
+        aoff[i] = std::min(std::max(half - skew, 1LL), lim);
+        bout[i] = std::min(std::max(max_pos - pos[i], 0LL), sz);
+        aout[i] = std::min(std::max(max_pos + pos[i], 0LL), sz);
+    }
+
+    /* nothing to bid at or below zero */
+    if(mid <= lim){
+        for(i = 0; i < n; ++i){
+            if(_abid_off[i] >= mid)
+                _abid_out[i] = 0;
+        }
+    }
+
+    std::fill(_bid_ladder.begin(), _bid_ladder.end(), 0);
+    std::fill(_ask_ladder.begin(), _ask_ladder.end(), 0);
+    for(i = 0; i < n; ++i){
+        _bid_ladder[_abid_off[i]] += _abid_out[i];
+        _ask_ladder[_aask_off[i]] += _aoffer_out[i];
+    }
+
+    quote_levels_type bids, asks;
+    for(long long off = lim; off > 0; --off){
+        if(_bid_ladder[off])
+            bids.push_back( quote_level_type((mid - off) * tick(), _bid_ladder[off]) );
+    }
+    for(long long off = 1; off <= lim; ++off){
+        if(_ask_ladder[off])
+            asks.push_back( quote_level_type((mid + off) * tick(), _ask_ladder[off]) );
+    }
+
+    _mid = mid;
+    try{
+        quote_ack ack = quote(bids, asks); /* one command for all of them */
+        _quote_ids.clear();
+        for(const quote_order_type& o : ack.orders)
+            _quote_ids.insert(std::get<0>(o));
+    }catch(...){
+        /* the old quote stands; the one before it is gone */
+        std::swap(_prev_mid, _mid);
+        _pbid_out.swap(_abid_out);
+        _poffer_out.swap(_aoffer_out);
+        _pbid_off.swap(_abid_off);
+        _pask_off.swap(_aask_off);
+        std::fill(_pbid_out.begin(), _pbid_out.end(), 0);
+        std::fill(_poffer_out.begin(), _poffer_out.end(), 0);
+        throw;
+    }
+}
+
+
+void
+MarketMaker_Bulk::_allocate_fill(id_type id, 
+                                 bool buy, 
+                                 price_type price, 
+                                 size_type size)
+{
+    const long long t = _to_ticks(price);
+    long long rem = size;
+
+    /* the quote the order was last part of first, then the other */
+    if( _quote_ids.count(id) ){
+        rem = _allocate_to(buy, t, rem, _mid, _abid_out, _aoffer_out, 
+                           _abid_off, _aask_off);
+        rem = _allocate_to(buy, t, rem, _prev_mid, _pbid_out, _poffer_out, 
+                           _pbid_off, _pask_off);
+    }else{
+        rem = _allocate_to(buy, t, rem, _prev_mid, _pbid_out, _poffer_out, 
+                           _pbid_off, _pask_off);
+        rem = _allocate_to(buy, t, rem, _mid, _abid_out, _aoffer_out, 
+                           _abid_off, _aask_off);
+    }
+
+    _unallocated += buy ? rem : -rem;
+}
+
+
+long long
+MarketMaker_Bulk::_allocate_to(bool buy,
+                               long long t,
+                               long long size,
+                               long long mid,
+                               std::vector<long long>& bid_out,
+                               std::vector<long long>& offer_out,
+                               const std::vector<long long>& bid_off,
+                               const std::vector<long long>& ask_off)
+{
+    /* the agents quoting at or through the fill's price */
+    const long long max_off = buy ? (mid - t) : (t - mid);
+    std::vector<long long>& out = buy ? bid_out : offer_out;
+    const std::vector<long long>& off = buy ? bid_off : ask_off;
+    long long take;
+
+    for(size_type i = 0; i < _nagents && size > 0; ++i){
+        if(!out[i] || off[i] > max_off)
+            continue;
+        take = std::min(out[i], size);
+        out[i] -= take;
+        _apos[i] += buy ? take : -take;
+        _alast[i] = t;
+        size -= take;
+    }
+
+    return size;
+}
+
+
+void 
+MarketMaker_Bulk::_exec_callback(callback_msg msg,
+                                 id_type id,
+                                 price_type price,
+                                 size_type size)
+{
+    try{
+        switch(msg){
+
+        /* FILL */
+        case callback_msg::fill:
+            _allocate_fill(id, this_fill_was_buy(), price, size);
+            break;
+
+        /* WAKE */
+        case callback_msg::wake:
+            if(price <= tick())
+                return;
+            _requote(price);
+            break;
+
+        /* CANCEL(requoted), STOP TO LIMIT */
+        default:
+            break;
+        }
+    }catch(invalid_order& e){
+        std::cerr<< e.what() << std::endl;
+    }catch(callback_overflow&){
+        std::cerr<< "callback overflow in MarketMaker_Bulk ::: price: "
+                 << std::to_string(price) 
+                 << ", size: " << std::to_string(size)
+                 << ", id: " << std::to_string(id) << std::endl;
+    }
+}
+
+
+std::atomic<owner_type> MarketMaker::next_session(0x80000000);
+
 const clock_type::time_point MarketMaker_Random::seedtp = clock_type::now();
 
 };
@@ -20,15 +20,20 @@ along with this program.    If not, see http://www.gnu.org/licenses.
 
 #include <random>
 #include <vector>
+#include <cstdint>
+#include <cmath>
 #include <functional>
 #include <memory>
 #include <map>
+#include <set>
 #include <mutex>
 #include <ratio>
 #include <algorithm>
 #include <thread>
+#include <atomic>
 
 #include "interfaces.hpp"
+#include "agentruntime.hpp"
 #include "types.hpp"
 
 namespace NativeLayer{
@@ -59,6 +64,14 @@ operator+(market_makers_type&& l, MarketMaker&& r);
  *
  *   MarketMaker::Insert<> is how you insert limit orders into the
  *   SimpleOrderbook::LimitInterface passed in to the start function.
+ *   MarketMaker::quote replaces all of them at once(see mass_quote in 
+ *   simpleorderbook.hpp); levels it still quotes keep their place in line.
+ *   Each market maker tags its orders w/ its own session(owner tag), taken
+ *   from the top half of owner_type's range.
+ *
+ *   Outstanding orders are kept by id(my_orders) and indexed by side and
+ *   price, so random_remove<>() picks the order furthest from the market
+ *   (the oldest at that price) in O(log n); pos() and is_flat() are O(1).
  *
  *   Ideally MarketMaker should be sub-classed and a virtual _exec_callback
  *   defined. But a MarketMaker(object or base class) can be instantiated
@@ -73,7 +86,12 @@ operator+(market_makers_type&& l, MarketMaker&& r);
  *   recursion until previous callbacks come off the 'stack'
  *
  *   Callbacks are handled internally by struct dynamic_functor which rebinds the
- *   underlying instance when a move occurs. Callbacks are called in this order:
+ *   underlying instance when a move occurs. It's also the market maker's 
+ *   inbox(see agentruntime.hpp): when the orderbook runs its market makers on
+ *   agent threads(SimpleOrderbook::set_agent_threads) callbacks are queued
+ *   and delivered by a worker, holding the market maker's mutex, instead of
+ *   on the thread that drains the book's callbacks; the recursion limits 
+ *   don't come into play. Callbacks are called in this order:
  *
  *       MarketMaker::_base_callback    <- handles internal admin
  *       MarketMaker::_callback_ext     <- (optionally) passed in at construction
@@ -135,15 +153,36 @@ protected:
     typedef MarketMaker my_base_type;
 
 private:
-    struct dynamic_functor{
+    struct dynamic_functor
+            : public AgentInbox{
         MarketMaker* _mm;
         bool _mm_alive;
         order_exec_cb_type _base_f;
         order_exec_cb_type _deriv_f;
 
+        /* on an agent worker(see AgentInbox::post) */
+        virtual void
+        _deliver(callback_msg msg, 
+                 id_type id, 
+                 price_type price, 
+                 size_type size)
+        {
+            if(!_mm_alive)
+                return;
+
+            std::lock_guard<std::recursive_mutex> rlock(_mm->_mtx);
+            _base_f(msg,id,price,size);
+
+            if(_mm->_callback_ext)
+                _mm->_callback_ext(msg,id,price,size);
+
+            _deriv_f(msg,id,price,size);
+        }
+
     public:
         dynamic_functor(MarketMaker* mm)
             : 
+                AgentInbox(),
                 _mm(mm), 
                 _mm_alive(true)
             { 
@@ -164,9 +203,11 @@ private:
                    price_type price, 
                    size_type size)
         {
-            if(!_mm_alive)
+            if(!_mm_alive || post(msg,id,price,size))
                 return;
 
+            std::lock_guard<std::recursive_mutex> rlock(_mm->_mtx);
+
             ++_mm->_recurse_count;
             ++_mm->_tot_recurse_count;
 
@@ -236,6 +277,10 @@ private:
     typedef std::map<id_type,order_bndl_type> orders_map_type;
     typedef orders_map_type::value_type orders_value_type;
 
+    /* (price, id) of our orders on one side, furthest from the market first
+       (offers are keyed by -price), oldest first at a price */
+    typedef std::set<std::pair<price_type,id_type>> price_index_type;
+
     typedef struct{
         bool is_buy;
         price_type price;
@@ -245,10 +290,14 @@ private:
     static const int RECURSE_LIMIT = 5;
     static const int TOTAL_RECURSE_LIMIT = 50;
 
+    static std::atomic<owner_type> next_session;
+
     NativeLayer::SimpleOrderbook::LimitInterface *_book;
     order_exec_cb_type _callback_ext;
     df_sptr_type _callback;
     orders_map_type _my_orders;
+    price_index_type _bid_index;
+    price_index_type _offer_index;
     bool _is_running;
     std::recursive_mutex _mtx; /* is this restrictive enough ? */
     fill_info _this_fill;
@@ -259,6 +308,7 @@ private:
     long long _pos;
     int _recurse_count;
     int _tot_recurse_count;
+    owner_type _session;
 
     void 
     _base_callback(callback_msg msg,
@@ -266,6 +316,25 @@ private:
                    price_type price,
                    size_type size);
 
+    /* add / update / remove an order in _my_orders and its side's index */
+    void
+    _add_order(id_type id, bool buy, price_type price, size_type size);
+
+    void
+    _erase_order(orders_map_type::iterator iter);
+
+    inline price_index_type&
+    _index(bool buy)
+    {
+        return buy ? _bid_index : _offer_index;
+    }
+
+    inline static std::pair<price_type,id_type>
+    _index_key(id_type id, const order_bndl_type& ob)
+    {
+        return std::make_pair(std::get<0>(ob) ? std::get<1>(ob) : -std::get<1>(ob), id);
+    }
+
     virtual void 
     _exec_callback(callback_msg msg,
                    id_type id, 
@@ -305,10 +374,22 @@ protected:
     virtual void
     stop();
 
+    /* reseed any randomness(called by the orderbook in simulation mode,
+       before start); by default there's none */
+    virtual void
+    seed(unsigned long long)
+    {
+        /* NULL */
+    }
+
     template<bool BuyNotSell>
     void 
     insert(price_type price, size_type size, bool no_order_cb = false);
 
+    /* replace all our orders w/ these levels(price, size), in one command */
+    quote_ack
+    quote(const quote_levels_type& bids, const quote_levels_type& asks);
+
 public:
     typedef std::initializer_list<order_exec_cb_type> init_list_type;
 
@@ -388,6 +469,18 @@ public:
         return _pos; 
     }
 
+    inline bool
+    is_flat() const
+    {
+        return _pos == 0;
+    }
+
+    inline owner_type 
+    session() const 
+    { 
+        return _session; 
+    }
+
     virtual order_exec_cb_type 
     get_callback()
     {
@@ -451,18 +544,15 @@ MarketMaker::insert(price_type price, size_type size, bool no_order_cb)
             if(id == 0)
                 throw invalid_order("order could not be inserted");
 
-            _my_orders.insert(
-                orders_value_type(
-                    id,
-                    order_bndl_type(BuyNotSell, price,size)
-                )
-            );
+            _add_order(id, BuyNotSell, price, size);
 
             if(BuyNotSell) 
                 _bid_out += size;
             else         
                 _offer_out += size;
-        }
+        },
+        /* arg 6 */
+        _session
     );
 }
 
@@ -471,33 +561,26 @@ template<bool BuyNotSell>
 size_type 
 MarketMaker::random_remove(price_type minp, id_type this_id)
 {  /*
-    * O(n) as-is
-    * could be O(c) in pracice if we exclude minp:
-    *     (1 - .50^n) chance we find it in n iters
+    * the order furthest from the market, if it's past minp(below it for 
+    * bids, above it for offers), that isn't this_id; O(log n) to pull it
     */
+    id_type id;
     size_type s;
-    orders_map_type::const_iterator riter, eiter;
-
+    
     std::lock_guard<std::recursive_mutex> rlock(_mtx);
 
-    eiter = _my_orders.end();
-    riter = std::find_if(
-                _my_orders.cbegin(),
-                eiter,
-                [=](orders_value_type p)
-                {                    
-                    return (std::get<0>(p.second) == BuyNotSell)
-                            && (BuyNotSell ? std::get<1>(p.second) < minp 
-                                           : std::get<1>(p.second) > minp)
-                            && p.first != this_id ;
-                }
-            );
-
-    s = 0;
-    if(riter != eiter){
-        s = std::get<2>(riter->second);
-        _book->pull_order(riter->first);
-    }
+    const price_index_type& idx = _index(BuyNotSell);
+    auto iter = idx.cbegin();
+
+    if(iter != idx.cend() && iter->second == this_id)
+        ++iter;
+
+    if(iter == idx.cend() || !(BuyNotSell ? iter->first < minp : -iter->first > minp))
+        return 0;
+
+    id = iter->second;
+    s = std::get<2>(_my_orders.at(id));
+    _book->pull_order(id);
     return s;
 }
 
@@ -586,6 +669,9 @@ protected:
           price_type implied, 
           price_type tick);
 
+    void
+    seed(unsigned long long s);
+
 public:
     typedef std::tuple<size_type,size_type,size_type,dispersion> init_params_type;
     typedef std::initializer_list<init_params_type> init_list_type;
@@ -617,6 +703,163 @@ private:
 };
 
 
+/*
+ *   MarketMaker_Bulk simulates 'nagents' simple makers inside ONE market
+ *   maker(one session, one callback, one inbox): no per-agent heap object,
+ *   mutex, map or functor. Their state - position, bid/offer out, quotes,
+ *   last fill and a xorshift64 RNG - is kept in contiguous arrays, one per
+ *   field, indexed by agent.
+ *
+ *   On each wake(and on start) branch-free passes over the arrays move
+ *   every agent's quote: a half spread of 1..max_spread ticks(+ a tick of
+ *   noise) around the last price, skewed against its position, sized to
+ *   keep it within max_pos. The quotes are summed by price and submitted as
+ *   a single mass_quote for the session.
+ *
+ *   A fill is allocated to the agents quoting at(or through) its price, in
+ *   agent order. The book only sees the aggregate ladder, so within a price
+ *   the agents share one place in line. Fills of the quote before the last
+ *   can come in after a requote, so it's kept too: a fill goes to the 
+ *   quote its order was last part of first, then the other. What neither
+ *   accounts for is added to unallocated_pos(); the agents' positions plus 
+ *   it always add up to pos().
+ */
+class MarketMaker_Bulk
+    : public MarketMaker{
+
+    size_type _nagents;
+    size_type _sz;
+    long long _max_pos;
+    long long _max_spread;
+    long long _mid; /* in ticks, at the last quote */
+    long long _unallocated; /* filled size no agent was quoting(+ bought) */
+
+    /* per-agent state */
+    std::vector<long long> _apos;
+    std::vector<long long> _abid_out;
+    std::vector<long long> _aoffer_out;
+    std::vector<long long> _abid_off; /* ticks below _mid */
+    std::vector<long long> _aask_off; /* ticks above _mid */
+    std::vector<long long> _ahalf; /* base half spread, in ticks */
+    std::vector<long long> _alast; /* last fill, in ticks(0: none) */
+    std::vector<std::uint64_t> _arng;
+
+    /* the quote before the last(see _allocate_fill) */
+    long long _prev_mid;
+    std::vector<long long> _pbid_out;
+    std::vector<long long> _poffer_out;
+    std::vector<long long> _pbid_off;
+    std::vector<long long> _pask_off;
+
+    /* the orders of the last quote */
+    std::set<id_type> _quote_ids;
+
+    /* aggregate size by offset from _mid(scratch, reused) */
+    std::vector<size_type> _bid_ladder;
+    std::vector<size_type> _ask_ladder;
+
+    DEFAULT_MOVE_TO_NEW(MarketMaker_Bulk);
+
+    virtual void
+    _exec_callback(callback_msg msg, 
+                   id_type id, 
+                   price_type price, 
+                   size_type size);
+
+    /* move every agent's quote around 'price' and submit them */
+    void
+    _requote(price_type price);
+
+    void
+    _allocate_fill(id_type id, bool buy, price_type price, size_type size);
+
+    /* allocate up to 'size' to one quote's agents; returns what's left */
+    long long
+    _allocate_to(bool buy, 
+                 long long t, 
+                 long long size, 
+                 long long mid,
+                 std::vector<long long>& bid_out,
+                 std::vector<long long>& offer_out,
+                 const std::vector<long long>& bid_off,
+                 const std::vector<long long>& ask_off);
+
+    /* per-agent RNG state and base half spread */
+    void
+    _seed_agents(unsigned long long seed);
+
+    inline long long
+    _to_ticks(price_type price) const
+    {
+        return std::llround(price / tick());
+    }
+
+    /* disable copy construction */
+    MarketMaker_Bulk(const MarketMaker_Bulk& mm);
+
+protected:
+    void 
+    start(NativeLayer::SimpleOrderbook::LimitInterface *book, 
+          price_type implied, 
+          price_type tick);
+
+    void
+    seed(unsigned long long s);
+
+public:
+    /* seed == 0: seeded from the clock */
+    MarketMaker_Bulk(size_type nagents, 
+                     size_type sz, 
+                     size_type max_pos,
+                     size_type max_spread = 5,
+                     unsigned long long seed = 0);
+
+    MarketMaker_Bulk(MarketMaker_Bulk&& mm) noexcept;
+
+    virtual 
+    ~MarketMaker_Bulk() noexcept 
+        {
+        }
+
+    inline size_type
+    nagents() const
+    {
+        return _nagents;
+    }
+
+    inline long long
+    agent_pos(size_type i) const
+    {
+        return _apos.at(i);
+    }
+
+    inline size_type
+    agent_bid_out(size_type i) const
+    {
+        return _abid_out.at(i);
+    }
+
+    inline size_type
+    agent_offer_out(size_type i) const
+    {
+        return _aoffer_out.at(i);
+    }
+
+    inline price_type
+    agent_last_fill(size_type i) const
+    {
+        return _alast.at(i) * tick();
+    }
+
+    /* filled size(+ bought, - sold) not allocated to any agent */
+    inline long long
+    unallocated_pos() const
+    {
+        return _unallocated;
+    }
+};
+
+
 
 };
 #endif
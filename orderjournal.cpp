@@ -0,0 +1,310 @@
+/*
+Copyright (C) 2015 Jonathon Ogden  < jeog.dev@gmail.com >
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program. If not, see http://www.gnu.org/licenses.
+*/
+
+#include "orderjournal.hpp"
+
+#include <cstring>
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+namespace NativeLayer{
+
+const char OrderJournal::magic[4] = {'S','O','B','J'};
+
+
+OrderJournal::OrderJournal(const std::string& path,
+                           const journal_header& header,
+                           journal_sync sync,
+                           int sync_interval)
+    :
+        _fd(-1),
+        _path(path),
+        _header(header),
+        _time_base(),
+        _buffer(),
+        _seq(0),
+        _sync(sync),
+        _sync_interval(sync_interval),
+        _last_sync(clock_type::now())
+    {
+        struct stat st;
+
+        _fd = open(path.c_str(), O_RDWR | O_CREAT, 0644);
+        if(_fd < 0)
+            throw journal_error(cat("could not open journal: ", path.c_str()).c_str());
+
+        if(fstat(_fd, &st) || st.st_size < 0){
+            close(_fd);
+            throw journal_error("could not stat journal");
+        }
+
+        try{
+            if(st.st_size == 0)
+                _write(&_header, sizeof(journal_header));
+            else
+                _open_existing(header);
+        }catch(...){
+            close(_fd);
+            throw;
+        }
+
+        _time_base = journal_time_base(_header);
+        _buffer.reserve(256);
+    }
+
+
+OrderJournal::~OrderJournal()
+    {
+        try{
+            commit();
+        }catch(...){
+        }
+        if(_fd >= 0)
+            close(_fd);
+    }
+
+
+void
+OrderJournal::_open_existing(const journal_header& header)
+{
+    journal_header h;
+    journal_record r;
+    off_t end, nrecs;
+
+    if(pread(_fd, &h, sizeof(journal_header), 0) != sizeof(journal_header))
+        throw journal_error("could not read journal header");
+
+    if(!Compatible(h, header))
+        throw journal_error("journal header doesn't match this orderbook");
+
+    /* expiries already in it are relative to its time base */
+    _header.time_base = h.time_base;
+    if(h.memory_limit != header.memory_limit)
+        set_memory_limit(header.memory_limit);
+
+    end = lseek(_fd, 0, SEEK_END);
+    nrecs = (end - (off_t)sizeof(journal_header)) / (off_t)sizeof(journal_record);
+
+    /* drop a cut short mass_quote/group */
+    nrecs = (off_t)_complete( nrecs,
+        [this](std::uint64_t i)
+        {
+            journal_record rr;
+            if(pread(_fd, &rr, sizeof(journal_record), 
+                     sizeof(journal_header) + i * sizeof(journal_record))
+               != sizeof(journal_record))
+            {
+                throw journal_error("could not read journal record");
+            }
+            return rr;
+        }
+    );
+
+    /* drop a partially written trailing record(and anything cut short) */
+    end = sizeof(journal_header) + nrecs * sizeof(journal_record);
+    if(ftruncate(_fd, end))
+        throw journal_error("could not truncate partial journal record");
+
+    if(nrecs){
+        if(pread(_fd, &r, sizeof(journal_record), end - sizeof(journal_record))
+           != sizeof(journal_record))
+        {
+            throw journal_error("could not read last journal record");
+        }
+        _seq = r.seq;
+    }
+
+    lseek(_fd, 0, SEEK_END);
+}
+
+
+template<typename F>
+std::uint64_t
+OrderJournal::_complete(std::uint64_t n, F at)
+{  /*
+    * the records of a mass_quote or group are appended together, right 
+    * after their header: back up over any at the end to the header and 
+    * check it has all of them
+    */
+    journal_record r;
+    std::uint64_t i = n;
+
+    while(i){
+        r = at(--i);
+        if( !(r.flags & (JOURNAL_FLAG_QUOTE | JOURNAL_FLAG_GROUP))
+            || r.type == JOURNAL_REJECT )
+        {
+            break; /* not part of one */
+        }
+        if(r.type == (std::uint8_t)order_type::null)
+            return (r.size > n - i - 1) ? i : n; /* its header */
+    }
+
+    return n;
+}
+
+
+void
+OrderJournal::_write(const void* buf, size_t n)
+{
+    const char* p = (const char*)buf;
+    ssize_t w;
+
+    while(n){
+        w = write(_fd, p, n);
+        if(w < 0){
+            if(errno == EINTR)
+                continue;
+            throw journal_error(cat("journal write failed: ", strerror(errno)).c_str());
+        }
+        p += w;
+        n -= w;
+    }
+}
+
+
+void
+OrderJournal::set_memory_limit(std::uint64_t bytes)
+{
+    _header.memory_limit = bytes;
+    if(pwrite(_fd, &_header, sizeof(journal_header), 0) != sizeof(journal_header))
+        throw journal_error("could not rewrite journal header");
+}
+
+
+void
+OrderJournal::commit()
+{
+    clock_type::time_point now;
+
+    if(_buffer.empty())
+        return;
+
+    _write(_buffer.data(), _buffer.size() * sizeof(journal_record));
+    _buffer.clear();
+
+    switch(_sync){
+    case journal_sync::batch:
+        if(fsync(_fd))
+            throw journal_error("journal fsync failed");
+        break;
+
+    case journal_sync::interval:
+        now = clock_type::now();
+        if(now - _last_sync >= _sync_interval){
+            if(fsync(_fd))
+                throw journal_error("journal fsync failed");
+            _last_sync = now;
+        }
+        break;
+
+    default:
+        break;
+    }
+}
+
+
+journal_header
+OrderJournal::MakeHeader(long long tick_num,
+                         long long tick_den,
+                         long long min_incr,
+                         unsigned long long total_incr,
+                         unsigned long long memory_limit)
+{
+    journal_header h;
+    memcpy(h.magic, OrderJournal::magic, sizeof(h.magic));
+    h.version = OrderJournal::version;
+    h.tick_num = tick_num;
+    h.tick_den = tick_den;
+    h.min_incr = min_incr;
+    h.total_incr = total_incr;
+    h.memory_limit = memory_limit;
+    h.time_base = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::system_clock::now().time_since_epoch()
+    ).count();
+    return h;
+}
+
+
+bool
+OrderJournal::Compatible(const journal_header& h1, const journal_header& h2)
+{
+    return !memcmp(h1.magic, h2.magic, sizeof(h1.magic))
+           && h1.version == h2.version
+           && h1.tick_num == h2.tick_num
+           && h1.tick_den == h2.tick_den
+           && h1.min_incr == h2.min_incr
+           && h1.total_incr == h2.total_incr;
+}
+
+
+std::vector<journal_record>
+OrderJournal::Read(const std::string& path, journal_header* header)
+{
+    struct stat st;
+    std::vector<journal_record> recs;
+    size_t nrecs;
+    ssize_t r;
+    char* p;
+    size_t n;
+
+    int fd = open(path.c_str(), O_RDONLY);
+    if(fd < 0)
+        throw journal_error(cat("could not open journal: ", path.c_str()).c_str());
+
+    try{
+        if(fstat(fd, &st) || (size_t)st.st_size < sizeof(journal_header))
+            throw journal_error("invalid journal file");
+
+        if(read(fd, header, sizeof(journal_header)) != sizeof(journal_header)
+           || memcmp(header->magic, OrderJournal::magic, sizeof(header->magic))
+           || header->version != OrderJournal::version)
+        {
+            throw journal_error("invalid journal header");
+        }
+
+        /* ignore a partially written trailing record */
+        nrecs = (st.st_size - sizeof(journal_header)) / sizeof(journal_record);
+        recs.resize(nrecs);
+
+        p = (char*)recs.data();
+        n = nrecs * sizeof(journal_record);
+        while(n){
+            r = read(fd, p, n);
+            if(r < 0 && errno == EINTR)
+                continue;
+            if(r <= 0)
+                throw journal_error("journal read failed");
+            p += r;
+            n -= r;
+        }
+    }catch(...){
+        close(fd);
+        throw;
+    }
+
+    close(fd);
+
+    /* and a cut short mass_quote/group(not committed) */
+    recs.resize( _complete(recs.size(), 
+                           [&recs](std::uint64_t i){ return recs[i]; }) );
+    return recs;
+}
+
+};
@@ -0,0 +1,284 @@
+/*
+Copyright (C) 2015 Jonathon Ogden     < jeog.dev@gmail.com >
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see http://www.gnu.org/licenses.
+*/
+
+#ifndef JO_0815_ORDER_JOURNAL
+#define JO_0815_ORDER_JOURNAL
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <chrono>
+
+#include "types.hpp"
+
+namespace NativeLayer{
+
+/*
+ *   OrderJournal is an append-only, binary, write-ahead log of every command
+ *   the order dispatcher routes into the book: inserts(by type), pulls, 
+ *   modifies and the limit/market orders generated when stops are triggered.
+ *   Replace calls are journaled as the pull and insert they are composed of.
+ *   A modify is a pull record with a size(and a limit if the price changed);
+ *   if it moves the order the new id isn't recorded, it's the next one the
+ *   book generates. Iceberg orders are limit records with a display size;
+ *   the slices they rest as are regenerated by the book.
+ *   A cancel_all is a pull record with id 0, the filter's sides and types in
+ *   'cancel', its price band in limit(low) and stop(high) and its owner.
+ *   A mass_quote is a pull record flagged JOURNAL_FLAG_QUOTE w/ the session
+ *   as its owner and the number of levels as its size, followed by a limit
+ *   record, also flagged, for each level; the ids of the orders it inserts
+ *   aren't recorded, they're the next ones the book generates.
+ *   A pegged order is a limit record w/o a limit, flagged w/ its peg_type and
+ *   its offset; repricing isn't journaled, the book reprices the same way.
+ *   A trailing stop(-limit) is a stop(-limit) record w/o prices, flagged, w/
+ *   its trail in 'offset' and the limit's offset in 'display'; ratchets
+ *   aren't journaled either.
+ *   An OCO or bracket group is a pull record flagged JOURNAL_FLAG_GROUP(and
+ *   JOURNAL_FLAG_BRACKET) w/ its owner and the number of orders as its size,
+ *   followed by a record, also flagged, for each order; like a mass_quote's
+ *   their ids are the next ones the book generates, and cancelling the rest
+ *   of a group or placing a bracket isn't journaled.
+ *   A good-till-time order is flagged JOURNAL_FLAG_EXPIRY w/ its expiry, in
+ *   nanoseconds from the journal's time base, split across 'display'(high 
+ *   bits) and 'offset'(low bits); a sweep of the orders that expired is a 
+ *   pull record w/ id 0, flagged the same way w/ the time it swept up to(see
+ *   journal_record_expiry). The header's time base is the wall clock when the
+ *   journal was created; the book's clock is steady, so it's converted to 
+ *   where that clock was then(see journal_time_base) by whoever writes or 
+ *   replays the journal, in whatever process. Expiries on the virtual clock
+ *   keep their distance from each other and the sweeps, not the wall clock.
+ *   A command the book refused before routing it because of its memory
+ *   limit(see SimpleOrderbook::set_memory_limit) is followed by a reject
+ *   record(type JOURNAL_REJECT) w/ the seq of its(first) record as its id;
+ *   replay skips it instead of routing it again, as the allocator byte 
+ *   counts the limit is checked against aren't journaled.
+ *
+ *   Records are fixed-size (see journal_record) and prices are stored as tick
+ *   indices from the minimum price of the book that wrote them; the header
+ *   carries enough information(tick ratio, min, number of ticks) to refuse a
+ *   replay into an incompatible book. It also carries the memory limit of the
+ *   book, rewritten whenever it changes, so replay can restore it.
+ *
+ *   The dispatcher appends to an in-memory buffer and calls commit() when the
+ *   order queue drains or the batch limit is hit(group commit). Callers of the
+ *   blocking insert/pull calls aren't released until the batch containing
+ *   their order has been committed. When the data is forced to disk is
+ *   controlled by journal_sync:
+ *
+ *       none     : write(2) on commit, let the OS decide when to flush
+ *       batch    : write(2) + fsync(2) on every commit
+ *       interval : write(2) on commit, fsync(2) if sync_interval ms have
+ *                  elapsed since the last one
+ *
+ *   Opening an existing journal appends to it, continuing the sequence; a
+ *   partially written trailing record(crash mid-write) is truncated, as is a
+ *   trailing mass_quote or group cut short(a header w/ more levels/orders 
+ *   than records after it) by a crash mid-commit: it wasn't committed.
+ *
+ *   OrderJournal::Read(...) loads an entire journal for replay(see
+ *   SimpleOrderbook::replay_journal and ReplayEngine::run_journal); it 
+ *   leaves off the same partial record and cut short command, so replay 
+ *   stops before them.
+ */
+
+enum class journal_sync {
+    none = 0,
+    batch,
+    interval
+};
+
+/* fixed 48-byte layout, host byte order */
+struct journal_record {
+    std::uint64_t seq;
+    std::uint64_t id;
+    std::uint64_t size;
+    std::int32_t limit; /* tick index, -1 if none */
+    std::int32_t stop; /* tick index, -1 if none */
+    std::uint8_t type; /* order_type; null indicates a pull(modify if size) */
+    std::uint8_t buy; /* for pulls: search limits first */
+    std::uint8_t flags;
+    std::uint8_t cancel; /* non-zero: a cancel_all(sides/types, as the book's bits) */
+    std::uint32_t display; /* iceberg display size(trailing stop-limit: limit offset) */
+    std::uint32_t owner; /* owner tag, 0 if none */
+    std::uint32_t offset; /* ticks from what a peg is pegged to(or a trailing stop trails) */
+};
+
+static_assert(sizeof(journal_record) == 48, "journal_record must be 48 bytes");
+
+#define JOURNAL_FLAG_TRIGGERED 0x01 /* order generated by a triggered stop */
+#define JOURNAL_FLAG_QUOTE 0x02 /* mass_quote: header(null) or level(limit) */
+#define JOURNAL_FLAG_PEG_PRIMARY 0x04 /* limit pegged to its own side */
+#define JOURNAL_FLAG_PEG_MIDPOINT 0x08 /* limit pegged to the midpoint */
+#define JOURNAL_FLAG_TRAILING 0x10 /* trailing stop / stop-limit */
+#define JOURNAL_FLAG_GROUP 0x20 /* OCO/bracket: header(null) or order */
+#define JOURNAL_FLAG_BRACKET 0x40 /* the group is a bracket */
+#define JOURNAL_FLAG_EXPIRY 0x80 /* GTT order(or an expiry sweep: null) */
+
+#define JOURNAL_REJECT 0xFF /* type of a reject record(see OrderJournal::reject) */
+
+struct journal_header {
+    char magic[4];
+    std::uint32_t version;
+    std::int64_t tick_num;
+    std::int64_t tick_den;
+    std::int64_t min_incr; /* min price of the book, in ticks */
+    std::uint64_t total_incr; /* number of tick levels in the book */
+    std::uint64_t memory_limit; /* bytes, 0 if none; not checked by Compatible */
+    std::int64_t time_base; /* wall clock(ns since the epoch) at creation */
+};
+
+static_assert(sizeof(journal_header) == 56, "journal_header must be 56 bytes");
+
+/* where the book's(steady) clock was at the header's time base */
+inline time_stamp_type
+journal_time_base(const journal_header& h)
+{
+    auto since = std::chrono::system_clock::now().time_since_epoch() 
+               - std::chrono::nanoseconds(h.time_base);
+    return clock_type::now() - std::chrono::duration_cast<clock_type::duration>(since);
+}
+
+/* JOURNAL_FLAG_EXPIRY: the expiry(sweep time); 'base' from journal_time_base */
+inline time_stamp_type
+journal_record_expiry(const journal_record& r, time_stamp_type base)
+{
+    std::int64_t ns = (std::int64_t)(((std::uint64_t)r.display << 32) | r.offset);
+    return base + std::chrono::duration_cast<clock_type::duration>(
+        std::chrono::nanoseconds(ns)
+    );
+}
+
+inline void
+journal_record_set_expiry(journal_record& r, 
+                          time_stamp_type expire, 
+                          time_stamp_type base)
+{
+    std::uint64_t ns = (std::uint64_t)std::chrono::duration_cast<
+        std::chrono::nanoseconds>(expire - base).count();
+    r.display = (std::uint32_t)(ns >> 32);
+    r.offset = (std::uint32_t)ns;
+}
+
+class OrderJournal{
+    int _fd;
+    std::string _path;
+    journal_header _header;
+    time_stamp_type _time_base;
+    std::vector<journal_record> _buffer;
+    std::uint64_t _seq;
+    journal_sync _sync;
+    std::chrono::milliseconds _sync_interval;
+    clock_type::time_point _last_sync;
+
+    void
+    _open_existing(const journal_header& header);
+
+    /* how many of the 'n' records, 'at(i)' reads record i, are left w/o a
+       trailing mass_quote or group cut short */
+    template<typename F>
+    static std::uint64_t
+    _complete(std::uint64_t n, F at);
+
+    void
+    _write(const void* buf, size_t n);
+
+    /* restrict copy / move / assign */
+    OrderJournal(const OrderJournal& oj);
+    OrderJournal& operator=(const OrderJournal& oj);
+
+public:
+    static const std::uint32_t version = 9;
+    static const char magic[4];
+
+    OrderJournal(const std::string& path,
+                 const journal_header& header,
+                 journal_sync sync = journal_sync::batch,
+                 int sync_interval = 100);
+
+    ~OrderJournal();
+
+    /* buffer a record, assigning the next sequence number */
+    inline std::uint64_t
+    append(journal_record& r)
+    {
+        r.seq = ++_seq;
+        _buffer.push_back(r);
+        return _seq;
+    }
+
+    /* the command whose(first) record is 'seq' was refused by the book */
+    inline std::uint64_t
+    reject(std::uint64_t seq)
+    {
+        journal_record r = journal_record();
+        r.id = seq;
+        r.limit = r.stop = -1;
+        r.type = JOURNAL_REJECT;
+        return append(r);
+    }
+
+    /* the header's time base on the book's clock(see journal_time_base) */
+    inline time_stamp_type
+    time_base() const
+    {
+        return _time_base;
+    }
+
+    /* rewrite the header's memory limit; throws journal_error */
+    void
+    set_memory_limit(std::uint64_t bytes);
+
+    /* write buffered records and sync per policy; throws journal_error */
+    void
+    commit();
+
+    inline size_t
+    pending() const
+    {
+        return _buffer.size();
+    }
+
+    inline std::uint64_t
+    last_seq() const
+    {
+        return _seq;
+    }
+
+    inline const std::string&
+    path() const
+    {
+        return _path;
+    }
+
+    static journal_header
+    MakeHeader(long long tick_num,
+               long long tick_den,
+               long long min_incr,
+               unsigned long long total_incr,
+               unsigned long long memory_limit = 0);
+
+    static bool
+    Compatible(const journal_header& h1, const journal_header& h2);
+
+    /* read an entire journal; throws journal_error on a bad header */
+    static std::vector<journal_record>
+    Read(const std::string& path, journal_header* header);
+};
+
+};
+
+#endif /* JO_0815_ORDER_JOURNAL */
@@ -20,7 +20,9 @@ py_library_dir = "/usr/lib/python3.4/config-3.4m-x86_64-linux-gnu"
 py_library_name = "python3.4m"
 
 cpp_sources = ["simpleorderbook_py.cpp","marketmaker_py.cpp", # py wrapper 
-               "../simpleorderbook.cpp", "../marketmaker.cpp"] # native
+               "../simpleorderbook.cpp", "../marketmaker.cpp", 
+               "../orderjournal.cpp", "../eventfeed.cpp",
+               "../latencystats.cpp", "../agentruntime.cpp"] # native
 
 _setup_dict = {
     "name":'simpleorderbook',
@@ -320,6 +320,231 @@ SOB_trade_stop_limit(pySOB* self, PyObject* args, PyObject* kwds)
 }
 
 
+template<bool BuyNotSell>
+PyObject* 
+SOB_trade_iceberg(pySOB* self, PyObject* args, PyObject* kwds)
+{
+    using namespace NativeLayer;
+
+    price_type limit;
+    long display;
+    long size;
+    PyObject* callback;
+
+    id_type id = 0;
+    callback = PyLong_FromLong(1); //dummy
+
+    static char kw_display[] = "display";
+    static char* kwlist[] = {okws[2],kw_display,okws[3],okws[4],NULL};
+    /* arg order to interface :::  limit, display, size, callback */
+    if(!get_order_args(args, kwds, "fllO:callback", kwlist, 
+                       &callback, &limit, &display, &size))
+        return NULL;
+
+    if(size <= 0 || display <= 0){
+        PyErr_SetString(PyExc_ValueError, "size and display must be > 0");
+        return NULL;
+    }
+
+    try{
+        SimpleOrderbook::FullInterface* sob = (SimpleOrderbook::FullInterface*)self->_sob;
+        order_exec_cb_type cb = order_exec_cb_type(ExecCallbackWrap(callback));
+
+        id = sob->insert_iceberg_order(BuyNotSell, limit, display, size, cb);
+    }catch(std::exception& e){
+        THROW_PY_EXCEPTION_FROM_NATIVE(e);
+    }
+
+    return PyLong_FromUnsignedLong(id);
+}
+
+
+template<bool BuyNotSell>
+PyObject* 
+SOB_trade_peg(pySOB* self, PyObject* args, PyObject* kwds)
+{
+    using namespace NativeLayer;
+
+    const char* peg;
+    long size;
+    long offset = 0;
+    PyObject* callback;
+    peg_type pt;
+
+    id_type id = 0;
+
+    static char kw_peg[] = "peg", kw_offset[] = "offset";
+    static char* kwlist[] = {kw_peg,okws[3],okws[4],kw_offset,NULL};
+
+    if(!PyArg_ParseTupleAndKeywords(args, kwds, "slO|l", kwlist, 
+                                    &peg, &size, &callback, &offset))
+        return NULL;
+
+    if(!PyCallable_Check(callback)){
+        PyErr_SetString(PyExc_TypeError,"callback must be callable");
+        return NULL;
+    }
+
+    if(!strcmp(peg, "primary"))
+        pt = peg_type::primary;
+    else if(!strcmp(peg, "midpoint"))
+        pt = peg_type::midpoint;
+    else{
+        PyErr_SetString(PyExc_ValueError, "peg must be 'primary' or 'midpoint'");
+        return NULL;
+    }
+
+    if(size <= 0 || offset < 0){
+        PyErr_SetString(PyExc_ValueError, "size must be > 0, offset >= 0");
+        return NULL;
+    }
+
+    try{
+        SimpleOrderbook::FullInterface* sob = (SimpleOrderbook::FullInterface*)self->_sob;
+        order_exec_cb_type cb = order_exec_cb_type(ExecCallbackWrap(callback));
+
+        id = sob->insert_peg_order(BuyNotSell, pt, size, cb, offset);
+    }catch(std::exception& e){
+        THROW_PY_EXCEPTION_FROM_NATIVE(e);
+    }
+
+    return PyLong_FromUnsignedLong(id);
+}
+
+
+template<bool BuyNotSell>
+PyObject* 
+SOB_trade_gtt(pySOB* self, PyObject* args, PyObject* kwds)
+{
+    using namespace NativeLayer;
+
+    price_type limit;
+    long size;
+    double seconds;
+    PyObject* callback;
+
+    id_type id = 0;
+    callback = PyLong_FromLong(1); //dummy
+
+    static char kw_seconds[] = "seconds";
+    static char* kwlist[] = {okws[2],okws[3],kw_seconds,okws[4],NULL};
+    /* arg order to interface :::  limit, size, seconds, callback */
+    if(!get_order_args(args, kwds, "fldO:callback", kwlist, 
+                       &callback, &limit, &size, &seconds))
+        return NULL;
+
+    if(size <= 0 || seconds <= 0){
+        PyErr_SetString(PyExc_ValueError, "size and seconds must be > 0");
+        return NULL;
+    }
+
+    try{
+        SimpleOrderbook::FullInterface* sob = (SimpleOrderbook::FullInterface*)self->_sob;
+        order_exec_cb_type cb = order_exec_cb_type(ExecCallbackWrap(callback));
+        /* the wall clock; the bindings don't use the virtual one */
+        time_stamp_type expire = clock_type::now() 
+            + std::chrono::duration_cast<clock_type::duration>(
+                  std::chrono::duration<double>(seconds) );
+
+        id = sob->insert_gtt_order(BuyNotSell, limit, size, expire, cb);
+    }catch(std::exception& e){
+        THROW_PY_EXCEPTION_FROM_NATIVE(e);
+    }
+
+    return PyLong_FromUnsignedLong(id);
+}
+
+
+template<bool BuyNotSell, bool WithLimit>
+PyObject* 
+SOB_trade_trailing_stop(pySOB* self, PyObject* args, PyObject* kwds)
+{
+    using namespace NativeLayer;
+
+    long trail;
+    long limit_offset = 0;
+    long size;
+    PyObject* callback;
+    bool ares;
+
+    id_type id = 0;
+    callback = PyLong_FromLong(1); //dummy
+
+    static char kw_trail[] = "trail", kw_limit_offset[] = "limit_offset";
+    if(WithLimit){
+        static char* kwlist[] = {kw_trail,kw_limit_offset,okws[3],okws[4],NULL};
+        /* arg order to interface :::  trail, limit_offset, size, callback */
+        ares = get_order_args(args, kwds, "lllO:callback", kwlist, 
+                              &callback, &trail, &limit_offset, &size);
+    }else{
+        static char* kwlist[] = {kw_trail,okws[3],okws[4],NULL};
+        /* arg order to interface :::  trail, size, callback */
+        ares = get_order_args(args, kwds, "llO:callback", kwlist, 
+                              &callback, &trail, &size);
+    }
+    if(!ares)
+        return NULL;
+
+    if(size <= 0 || trail <= 0 || limit_offset < 0){
+        PyErr_SetString(PyExc_ValueError, 
+                        "size and trail must be > 0, limit_offset >= 0");
+        return NULL;
+    }
+
+    try{
+        SimpleOrderbook::FullInterface* sob = (SimpleOrderbook::FullInterface*)self->_sob;
+        order_exec_cb_type cb = order_exec_cb_type(ExecCallbackWrap(callback));
+
+        id = WithLimit 
+           ? sob->insert_trailing_stop_limit_order(BuyNotSell, trail, 
+                                                   limit_offset, size, cb)
+           : sob->insert_trailing_stop_order(BuyNotSell, trail, size, cb);
+    }catch(std::exception& e){
+        THROW_PY_EXCEPTION_FROM_NATIVE(e);
+    }
+
+    return PyLong_FromUnsignedLong(id);
+}
+
+
+template<bool BuyNotSell, bool FillOrKill>
+PyObject* 
+SOB_trade_ioc(pySOB* self, PyObject* args, PyObject* kwds)
+{
+    using namespace NativeLayer;
+
+    price_type limit;
+    long size;
+    PyObject* callback;
+
+    id_type id = 0;
+    callback = PyLong_FromLong(1); //dummy
+
+    static char* kwlist[] = {okws[2],okws[3],okws[4],NULL};
+    /* arg order to interface :::  limit, size, callback */
+    if(!get_order_args(args, kwds, "flO:callback", kwlist, 
+                       &callback, &limit, &size))
+        return NULL;
+
+    if(size <= 0){
+        PyErr_SetString(PyExc_ValueError, "size must be > 0");
+        return NULL;
+    }
+
+    try{
+        SimpleOrderbook::FullInterface* sob = (SimpleOrderbook::FullInterface*)self->_sob;
+        order_exec_cb_type cb = order_exec_cb_type(ExecCallbackWrap(callback));
+
+        id = FillOrKill ? sob->insert_fok_order(BuyNotSell, limit, size, cb)
+                        : sob->insert_ioc_order(BuyNotSell, limit, size, cb);
+    }catch(std::exception& e){
+        THROW_PY_EXCEPTION_FROM_NATIVE(e);
+    }
+
+    return PyLong_FromUnsignedLong(id);
+}
+
+
 PyObject* 
 SOB_pull_order(pySOB* self, PyObject* args, PyObject* kwds)
 {
@@ -343,6 +568,285 @@ SOB_pull_order(pySOB* self, PyObject* args, PyObject* kwds)
 }
 
 
+PyObject* 
+SOB_modify_order(pySOB* self, PyObject* args, PyObject* kwds)
+{
+    using namespace NativeLayer;
+
+    id_type id;
+    long size;
+    double limit = 0;
+
+    static char* kwlist[] = {okws[0],okws[3],okws[2],NULL};
+
+    if(!PyArg_ParseTupleAndKeywords(args, kwds, "kl|d", kwlist, &id, &size, &limit))
+        return NULL;
+
+    if(size <= 0){
+        PyErr_SetString(PyExc_ValueError, "size must be > 0");
+        return NULL;
+    }
+
+    try{
+        SimpleOrderbook::FullInterface* sob = 
+            (SimpleOrderbook::FullInterface*)self->_sob;
+        id = limit ? sob->modify_order(id, (price_type)limit, size)
+                   : sob->modify_order(id, size);
+    }catch(std::exception& e){
+        THROW_PY_EXCEPTION_FROM_NATIVE(e);
+    }
+
+    return PyLong_FromUnsignedLong(id);
+}
+
+
+PyObject* 
+SOB_cancel_all(pySOB* self, PyObject* args, PyObject* kwds)
+{
+    using namespace NativeLayer;
+
+    unsigned int owner = 0;
+    int side = 0;
+    const char* type = nullptr;
+    double min = 0, max = 0;
+    size_type n;
+
+    static char kw_owner[] = "owner", kw_side[] = "side", kw_type[] = "type",
+                kw_min[] = "min", kw_max[] = "max";
+    static char* kwlist[] = {kw_owner,kw_side,kw_type,kw_min,kw_max,NULL};
+
+    if(!PyArg_ParseTupleAndKeywords(args, kwds, "|Iizdd", kwlist, 
+                                    &owner, &side, &type, &min, &max))
+        return NULL;
+
+    cancel_filter filter(owner, 
+                         side > 0 ? side_of_market::bid 
+                                  : (side < 0 ? side_of_market::ask 
+                                              : side_of_market::both),
+                         order_type::null, (price_type)min, (price_type)max);
+    if(type){
+        if(!strcmp(type, "limit"))
+            filter.type = order_type::limit;
+        else if(!strcmp(type, "stop"))
+            filter.type = order_type::stop;
+        else if(!strcmp(type, "stop_limit"))
+            filter.type = order_type::stop_limit;
+        else{
+            PyErr_SetString(PyExc_ValueError, 
+                            "type must be 'limit', 'stop' or 'stop_limit'");
+            return NULL;
+        }
+    }
+
+    try{
+        n = ((SimpleOrderbook::FullInterface*)self->_sob)->cancel_all(filter);
+    }catch(std::exception& e){
+        THROW_PY_EXCEPTION_FROM_NATIVE(e);
+    }
+
+    return PyLong_FromUnsignedLong(n);
+}
+
+
+static bool
+get_quote_levels(PyObject* seq, NativeLayer::quote_levels_type& levels)
+{ /* a sequence of (price, size) */
+    using namespace NativeLayer;
+
+    double price;
+    unsigned long size;
+
+    PyObject* fast = PySequence_Fast(seq, "quote levels must be a sequence");
+    if(!fast)
+        return false;
+
+    Py_ssize_t n = PySequence_Fast_GET_SIZE(fast);
+    for(Py_ssize_t i = 0; i < n; ++i){
+        if(!PyArg_ParseTuple(PySequence_Fast_GET_ITEM(fast, i), "dk", &price, &size)){
+            Py_DECREF(fast);
+            return false;
+        }
+        levels.push_back( quote_level_type((price_type)price, size) );
+    }
+
+    Py_DECREF(fast);
+    return true;
+}
+
+
+PyObject* 
+SOB_mass_quote(pySOB* self, PyObject* args, PyObject* kwds)
+{
+    using namespace NativeLayer;
+
+    unsigned int session;
+    PyObject *pbids, *pasks, *callback, *list, *tup;
+    quote_levels_type bids, asks;
+    quote_ack ack;
+
+    static char kw_session[] = "session", kw_bids[] = "bids", kw_asks[] = "asks",
+                kw_callback[] = "callback";
+    static char* kwlist[] = {kw_session,kw_bids,kw_asks,kw_callback,NULL};
+
+    if(!PyArg_ParseTupleAndKeywords(args, kwds, "IOOO", kwlist, 
+                                    &session, &pbids, &pasks, &callback))
+        return NULL;
+
+    if(!PyCallable_Check(callback)){
+        PyErr_SetString(PyExc_TypeError,"callback must be callable");
+        return NULL;
+    }
+
+    if(!get_quote_levels(pbids, bids) || !get_quote_levels(pasks, asks))
+        return NULL;
+
+    try{
+        ack = ((SimpleOrderbook::FullInterface*)self->_sob)->mass_quote(
+                  session, bids, asks, 
+                  order_exec_cb_type(ExecCallbackWrap(callback)) );
+    }catch(std::exception& e){
+        THROW_PY_EXCEPTION_FROM_NATIVE(e);
+    }
+
+    list = PyList_New(ack.orders.size());
+    for(size_t i = 0; i < ack.orders.size(); ++i){
+        const quote_order_type& o = ack.orders[i];
+        tup = Py_BuildValue("(k,O,f,k)", std::get<0>(o), 
+                            std::get<1>(o) ? Py_True : Py_False,
+                            std::get<2>(o), std::get<3>(o));
+        PyList_SET_ITEM(list, i, tup);
+    }
+
+    return Py_BuildValue("(N,k,k,k,k)", list, ack.kept, ack.reduced, 
+                         ack.cancelled, ack.inserted);
+}
+
+
+static bool
+get_order_legs(PyObject* seq, NativeLayer::order_legs_type& legs)
+{ /* a sequence of (type, buy, limit, stop, size) */
+    using namespace NativeLayer;
+
+    const char* type;
+    PyObject* buy;
+    double limit, stop;
+    unsigned long size;
+    order_type ot;
+
+    PyObject* fast = PySequence_Fast(seq, "legs must be a sequence");
+    if(!fast)
+        return false;
+
+    Py_ssize_t n = PySequence_Fast_GET_SIZE(fast);
+    for(Py_ssize_t i = 0; i < n; ++i){
+        if(!PyArg_ParseTuple(PySequence_Fast_GET_ITEM(fast, i), "sOddk", 
+                             &type, &buy, &limit, &stop, &size)){
+            Py_DECREF(fast);
+            return false;
+        }
+        if(!strcmp(type, "limit"))
+            ot = order_type::limit;
+        else if(!strcmp(type, "stop"))
+            ot = order_type::stop;
+        else if(!strcmp(type, "stop_limit"))
+            ot = order_type::stop_limit;
+        else{
+            Py_DECREF(fast);
+            PyErr_SetString(PyExc_ValueError, 
+                            "leg type must be 'limit', 'stop' or 'stop_limit'");
+            return false;
+        }
+        legs.push_back( order_leg(ot, PyObject_IsTrue(buy) == 1, 
+                                  (price_type)limit, (price_type)stop, size) );
+    }
+
+    Py_DECREF(fast);
+    return true;
+}
+
+
+static PyObject*
+ids_to_list(const std::vector<NativeLayer::id_type>& ids)
+{
+    PyObject* list = PyList_New(ids.size());
+    for(size_t i = 0; i < ids.size(); ++i)
+        PyList_SET_ITEM(list, i, PyLong_FromUnsignedLong(ids[i]));
+    return list;
+}
+
+
+PyObject* 
+SOB_insert_oco(pySOB* self, PyObject* args, PyObject* kwds)
+{
+    using namespace NativeLayer;
+
+    PyObject *plegs, *callback;
+    order_legs_type legs;
+    std::vector<id_type> ids;
+
+    static char kw_legs[] = "legs", kw_callback[] = "callback";
+    static char* kwlist[] = {kw_legs,kw_callback,NULL};
+
+    if(!PyArg_ParseTupleAndKeywords(args, kwds, "OO", kwlist, &plegs, &callback))
+        return NULL;
+
+    if(!PyCallable_Check(callback)){
+        PyErr_SetString(PyExc_TypeError,"callback must be callable");
+        return NULL;
+    }
+
+    if(!get_order_legs(plegs, legs))
+        return NULL;
+
+    try{
+        ids = ((SimpleOrderbook::FullInterface*)self->_sob)->insert_oco_order(
+                  legs, order_exec_cb_type(ExecCallbackWrap(callback)) );
+    }catch(std::exception& e){
+        THROW_PY_EXCEPTION_FROM_NATIVE(e);
+    }
+
+    return ids_to_list(ids);
+}
+
+
+template<bool BuyNotSell>
+PyObject* 
+SOB_trade_bracket(pySOB* self, PyObject* args, PyObject* kwds)
+{
+    using namespace NativeLayer;
+
+    price_type limit, profit, loss;
+    long size;
+    PyObject* callback;
+    std::vector<id_type> ids;
+
+    callback = PyLong_FromLong(1); //dummy
+
+    static char kw_profit[] = "profit", kw_loss[] = "loss";
+    static char* kwlist[] = {okws[2],okws[3],kw_profit,kw_loss,okws[4],NULL};
+    /* arg order to interface :::  limit, size, profit, loss, callback */
+    if(!get_order_args(args, kwds, "flffO:callback", kwlist, 
+                       &callback, &limit, &size, &profit, &loss))
+        return NULL;
+
+    if(size <= 0){
+        PyErr_SetString(PyExc_ValueError, "size must be > 0");
+        return NULL;
+    }
+
+    try{
+        SimpleOrderbook::FullInterface* sob = (SimpleOrderbook::FullInterface*)self->_sob;
+        order_exec_cb_type cb = order_exec_cb_type(ExecCallbackWrap(callback));
+
+        ids = sob->insert_bracket_order(BuyNotSell, limit, size, profit, loss, cb);
+    }catch(std::exception& e){
+        THROW_PY_EXCEPTION_FROM_NATIVE(e);
+    }
+
+    return ids_to_list(ids);
+}
+
+
 static PyObject* 
 SOB_time_and_sales(pySOB* self, PyObject* args)
 {
@@ -391,6 +895,34 @@ SOB_time_and_sales(pySOB* self, PyObject* args)
 }
 
 
+static PyObject* 
+SOB_memory_usage(pySOB* self)
+{
+    using namespace NativeLayer;
+
+    SimpleOrderbook::FullInterface* sob;
+    memory_usage_type mu;
+    PyObject *dict, *tup;
+
+    try{
+        sob = (SimpleOrderbook::FullInterface*)self->_sob;
+        mu = sob->memory_usage();
+
+        dict = PyDict_New();
+        for(int i = 0; i < memory_usage_type::ncomponents; ++i){
+            tup = Py_BuildValue("(k,k)", mu.bytes[i], mu.objects[i]);
+            PyDict_SetItemString(dict, 
+                memory_component_str((memory_component)i).c_str(), tup);
+            Py_DECREF(tup);
+        }
+    }catch(std::exception& e){
+        THROW_PY_EXCEPTION_FROM_NATIVE(e);
+    }
+
+    return dict;
+}
+
+
 template<NativeLayer::side_of_market Side>
 static PyObject* 
 SOB_market_depth(pySOB* self, PyObject* args,PyObject* kwds)
@@ -709,10 +1241,101 @@ static PyMethodDef pySOB_methods[] = {
      METH_VARARGS | METH_KEYWORDS,
      "sell stop limit order; (stop, limit, size, callback) -> order ID"},
 
+    {"buy_iceberg",(PyCFunction)SOB_trade_iceberg<true>,
+     METH_VARARGS | METH_KEYWORDS,
+     "buy iceberg order; (limit, display, size, callback) -> order ID"},
+
+    {"sell_iceberg",(PyCFunction)SOB_trade_iceberg<false>,
+     METH_VARARGS | METH_KEYWORDS,
+     "sell iceberg order; (limit, display, size, callback) -> order ID"},
+
+    {"buy_peg",(PyCFunction)SOB_trade_peg<true>,
+     METH_VARARGS | METH_KEYWORDS,
+     "buy pegged limit order; (peg('primary','midpoint'), size, callback, "
+     "offset=0(ticks less aggressive)) -> order ID"},
+
+    {"sell_peg",(PyCFunction)SOB_trade_peg<false>,
+     METH_VARARGS | METH_KEYWORDS,
+     "sell pegged limit order; (peg('primary','midpoint'), size, callback, "
+     "offset=0(ticks less aggressive)) -> order ID"},
+
+    {"buy_gtt",(PyCFunction)SOB_trade_gtt<true>,
+     METH_VARARGS | METH_KEYWORDS,
+     "buy good-till-time limit order; (limit, size, seconds(from now), "
+     "callback) -> order ID"},
+
+    {"sell_gtt",(PyCFunction)SOB_trade_gtt<false>,
+     METH_VARARGS | METH_KEYWORDS,
+     "sell good-till-time limit order; (limit, size, seconds(from now), "
+     "callback) -> order ID"},
+
+    {"buy_trailing_stop",(PyCFunction)SOB_trade_trailing_stop<true,false>,
+     METH_VARARGS | METH_KEYWORDS,
+     "buy trailing stop order; (trail(ticks), size, callback) -> order ID"},
+
+    {"sell_trailing_stop",(PyCFunction)SOB_trade_trailing_stop<false,false>,
+     METH_VARARGS | METH_KEYWORDS,
+     "sell trailing stop order; (trail(ticks), size, callback) -> order ID"},
+
+    {"buy_trailing_stop_limit",(PyCFunction)SOB_trade_trailing_stop<true,true>,
+     METH_VARARGS | METH_KEYWORDS,
+     "buy trailing stop limit order; (trail(ticks), limit_offset(ticks), "
+     "size, callback) -> order ID"},
+
+    {"sell_trailing_stop_limit",(PyCFunction)SOB_trade_trailing_stop<false,true>,
+     METH_VARARGS | METH_KEYWORDS,
+     "sell trailing stop limit order; (trail(ticks), limit_offset(ticks), "
+     "size, callback) -> order ID"},
+
+    {"buy_ioc",(PyCFunction)SOB_trade_ioc<true,false>,
+     METH_VARARGS | METH_KEYWORDS,
+     "buy immediate-or-cancel order; (limit, size, callback) -> order ID"},
+
+    {"sell_ioc",(PyCFunction)SOB_trade_ioc<false,false>,
+     METH_VARARGS | METH_KEYWORDS,
+     "sell immediate-or-cancel order; (limit, size, callback) -> order ID"},
+
+    {"buy_fok",(PyCFunction)SOB_trade_ioc<true,true>,
+     METH_VARARGS | METH_KEYWORDS,
+     "buy fill-or-kill order; (limit, size, callback) -> order ID"},
+
+    {"sell_fok",(PyCFunction)SOB_trade_ioc<false,true>,
+     METH_VARARGS | METH_KEYWORDS,
+     "sell fill-or-kill order; (limit, size, callback) -> order ID"},
+
     /* PULL */
     {"pull_order",(PyCFunction)SOB_pull_order, METH_VARARGS | METH_KEYWORDS,
      "remove order; (id) -> success/failure(boolean)"},
 
+    /* MODIFY */
+    {"modify_order",(PyCFunction)SOB_modify_order, METH_VARARGS | METH_KEYWORDS,
+     "change size(and price) of a limit order, keeping its place if only "
+     "reduced; (id, size, limit=0) -> order ID(new if moved), 0 on failure"},
+
+    {"cancel_all",(PyCFunction)SOB_cancel_all, METH_VARARGS | METH_KEYWORDS,
+     "cancel every resting order that matches; (owner=0(any), side=0(both; "
+     "1 bids, -1 asks), type=None(any; 'limit','stop','stop_limit'), min=0, "
+     "max=0(price band, 0 = no bound)) -> number cancelled"},
+
+    {"mass_quote",(PyCFunction)SOB_mass_quote, METH_VARARGS | METH_KEYWORDS,
+     "replace a session's quote; (session, bids, asks, callback; levels are "
+     "(price, size)) -> ([(id, buy, price, size),...], kept, reduced, "
+     "cancelled, inserted)"},
+
+    {"oco",(PyCFunction)SOB_insert_oco, METH_VARARGS | METH_KEYWORDS,
+     "one-cancels-other group; (legs, callback; legs are (type('limit','stop',"
+     "'stop_limit'), buy, limit, stop, size)) -> [order ID,...]"},
+
+    {"buy_bracket",(PyCFunction)SOB_trade_bracket<true>,
+     METH_VARARGS | METH_KEYWORDS,
+     "buy bracket order; (limit, size, profit, loss, callback) -> "
+     "[entry ID, take-profit ID, stop-loss ID]"},
+
+    {"sell_bracket",(PyCFunction)SOB_trade_bracket<false>,
+     METH_VARARGS | METH_KEYWORDS,
+     "sell bracket order; (limit, size, profit, loss, callback) -> "
+     "[entry ID, take-profit ID, stop-loss ID]"},
+
     /* REPLACE */
     {"replace_with_buy_limit",(PyCFunction)SOB_trade_limit<true,true>,
      METH_VARARGS | METH_KEYWORDS, 
@@ -771,6 +1394,9 @@ static PyMethodDef pySOB_methods[] = {
     {"time_and_sales",(PyCFunction)SOB_time_and_sales, METH_VARARGS,
      "(size) -> list of 3-tuples [(str,float,int),(str,float,int),..] "},
 
+    {"memory_usage",(PyCFunction)SOB_memory_usage, METH_NOARGS,
+     "() -> dict of {component: (bytes, objects)}"},
+
     {NULL}
 };
 
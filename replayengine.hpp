@@ -0,0 +1,781 @@
+/*
+Copyright (C) 2015 Jonathon Ogden     < jeog.dev@gmail.com >
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see http://www.gnu.org/licenses.
+*/
+
+#ifndef JO_0815_REPLAY_ENGINE
+#define JO_0815_REPLAY_ENGINE
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include <unordered_map>
+
+#include "simpleorderbook.hpp"
+#include "orderjournal.hpp"
+
+namespace NativeLayer{
+
+/*
+ *   ReplayEngine<SobTy> drives a SimpleOrderbook from recorded order flow as
+ *   fast as the book can match, and reproducibly: the book is put in direct
+ *   (single-threaded, dispatcher-less) mode and trades are stamped with a
+ *   virtual clock taken from the events. Two runs over the same input into
+ *   books built with the same parameters write byte-identical output.
+ *
+ *   The book shouldn't have market makers(their callbacks interleave with
+ *   ours) and should be new(ids are assigned in event order).
+ *
+ *   run_csv(...) reads one event per line (blank lines and '#' ignored):
+ *
+ *       time,type,id,side,limit,stop,size
+ *
+ *           time  : virtual time in nanoseconds
+ *           type  : limit | market | stop | stop_limit | ioc | fok | pull 
+ *                   | modify
+ *           id    : the event file's id for the order (what pulls and 
+ *                   modifies refer to)
+ *           side  : B | S (ignored for pulls, modifies)
+ *           limit : limit price (limit, stop_limit, ioc, fok; modify if the
+ *                   price changes), else empty or 0
+ *           stop  : stop price (stop, stop_limit), else empty or 0
+ *           size  : order size, new size for modifies (ignored for pulls)
+ *
+ *   run_journal(...) reads a binary OrderJournal(see orderjournal.hpp).
+ *   Records have no time so the sequence number is used; records of orders
+ *   generated by triggered stops are skipped as the book regenerates them.
+ *   Iceberg, pegged and trailing stop orders are replayed as such, 
+ *   cancel_alls as one cancel_all, mass_quotes as one mass_quote and OCO/
+ *   bracket groups as one group(the orders they insert go by the ids the
+ *   journaling book gave them). GTT orders are inserted w/ the expiries they
+ *   were journaled w/; a sweep moves the virtual clock to the time it swept
+ *   up to(expiring the same orders) and back. Orders the journaling book's
+ *   memory limit rejected are output as rejected w/o being inserted.
+ *   An order moved by a modify keeps the id it was entered with in the 
+ *   output.
+ *
+ *   Output, one line per event, ids are those of the event file:
+ *
+ *       F,time,id,price,size                  fill
+ *       T,time,price,size,aggressor,resting   trade
+ *       C,time,id                             cancel
+ *       L,time,id,limit,size                  stop-limit triggered
+ *       R,time,id,reason                      rejected
+ *
+ *   run_... return replay_stats (counts, wall-clock seconds, events/sec).
+ */
+
+struct replay_stats {
+    large_size_type events;
+    large_size_type rejects;
+    large_size_type fills;
+    large_size_type trades;
+    double seconds;
+
+    inline double
+    events_per_sec() const
+    {
+        return seconds > 0 ? events / seconds : 0;
+    }
+};
+
+inline std::ostream&
+operator<<(std::ostream& out, const replay_stats& rs)
+{
+    out<< "events: " << rs.events << ", rejects: " << rs.rejects
+       << ", fills: " << rs.fills << ", trades: " << rs.trades
+       << ", seconds: " << rs.seconds << ", events/sec: " << rs.events_per_sec();
+    return out;
+}
+
+
+template<typename SobTy>
+class ReplayEngine{
+    typedef std::pair<id_type,size_type> order_ref_type; /* book id, remaining */
+    typedef std::unordered_map<id_type,order_ref_type> order_refs_type;
+
+    SobTy& _book;
+    std::ostream& _out;
+    order_refs_type _orders;
+    replay_stats _stats;
+    long long _time;
+    time_stamp_type _time_base; /* of the journal being run */
+    bool _was_direct;
+
+    /* the two fills of a trade are delivered back to back: aggressor first */
+    bool _half_trade;
+    id_type _half_trade_id;
+
+    char _buf[256];
+
+    void
+    _on_exec(id_type fid,
+             callback_msg msg,
+             id_type id,
+             price_type price,
+             size_type size);
+
+    /* the book's id, 0 if rejected; a journal record 'r' adds the owner 
+       and makes it an iceberg, peg or trailing stop(see orderjournal.hpp) */
+    id_type
+    _insert(order_type oty,
+            bool buy,
+            price_type limit,
+            price_type stop,
+            size_type size,
+            id_type fid,
+            const journal_record* r = nullptr);
+
+    void
+    _pull(id_type fid);
+
+    /* the book's new id if the order moved, else 0 */
+    id_type
+    _modify(id_type fid, price_type limit, size_type size);
+
+    /* a journaled cancel_all; its band is in 'low', 'high' */
+    void
+    _cancel_all(const journal_record& r, price_type low, price_type high);
+
+    /* a journaled mass_quote(header at recs[i]); leaves i at its last level */
+    void
+    _mass_quote(const std::vector<journal_record>& recs, 
+                size_t& i, 
+                const journal_header& hdr,
+                long long offset);
+
+    /* a journaled expiry sweep */
+    void
+    _expire(const journal_record& r);
+
+    /* a journaled OCO/bracket group(header at recs[i]); leaves i at its 
+       last order */
+    void
+    _group(const std::vector<journal_record>& recs, 
+           size_t& i, 
+           const journal_header& hdr,
+           long long offset);
+
+    void
+    _reject(id_type fid, const char* reason);
+
+    void
+    _set_time(long long t);
+
+    void
+    _parse_csv_line(char* line, size_type lineno);
+
+    /* restrict copy / assign */
+    ReplayEngine(const ReplayEngine& re);
+    ReplayEngine& operator=(const ReplayEngine& re);
+
+public:
+    ReplayEngine(SobTy& book, std::ostream& out);
+    ~ReplayEngine();
+
+    replay_stats
+    run_csv(std::istream& in);
+
+    replay_stats
+    run_csv(const std::string& path);
+
+    replay_stats
+    run_journal(const std::string& path);
+};
+
+
+template<typename SobTy>
+ReplayEngine<SobTy>::ReplayEngine(SobTy& book, std::ostream& out)
+    :
+        _book(book),
+        _out(out),
+        _orders(),
+        _stats(),
+        _time(0),
+        _time_base(),
+        _was_direct(book.in_direct_mode()),
+        _half_trade(false),
+        _half_trade_id(0)
+    {
+        _book.set_direct_mode(true);
+        _set_time(0);
+    }
+
+
+template<typename SobTy>
+ReplayEngine<SobTy>::~ReplayEngine()
+    {
+        try{
+            _book.use_wall_clock();
+            _book.set_direct_mode(_was_direct);
+        }catch(...){
+        }
+    }
+
+
+template<typename SobTy>
+void
+ReplayEngine<SobTy>::_set_time(long long t)
+{
+    _time = t;
+    _book.set_virtual_time(
+        time_stamp_type(
+            std::chrono::duration_cast<clock_type::duration>(std::chrono::nanoseconds(t))
+        )
+    );
+}
+
+
+template<typename SobTy>
+void
+ReplayEngine<SobTy>::_on_exec(id_type fid,
+                              callback_msg msg,
+                              id_type id,
+                              price_type price,
+                              size_type size)
+{
+    int n;
+    typename order_refs_type::iterator oiter;
+
+    switch(msg){
+    case callback_msg::fill:
+        ++_stats.fills;
+        n = snprintf(_buf, sizeof(_buf), "F,%lld,%lu,%.5f,%lu\n",
+                     _time, fid, (double)price, size);
+        _out.write(_buf, n);
+
+        if(_half_trade){
+            ++_stats.trades;
+            n = snprintf(_buf, sizeof(_buf), "T,%lld,%.5f,%lu,%lu,%lu\n",
+                         _time, (double)price, size, _half_trade_id, fid);
+            _out.write(_buf, n);
+        }else{
+            _half_trade_id = fid;
+        }
+        _half_trade = !_half_trade;
+
+        oiter = _orders.find(fid);
+        if(oiter != _orders.end()){
+            if(oiter->second.second <= size)
+                _orders.erase(oiter);
+            else
+                oiter->second.second -= size;
+        }
+        break;
+
+    case callback_msg::cancel:
+        n = snprintf(_buf, sizeof(_buf), "C,%lld,%lu\n", _time, fid);
+        _out.write(_buf, n);
+
+        /* a self-trade decrement only cancels part of it */
+        oiter = _orders.find(fid);
+        if(oiter != _orders.end()){
+            if(!size || oiter->second.second <= size)
+                _orders.erase(oiter);
+            else
+                oiter->second.second -= size;
+        }
+        break;
+
+    case callback_msg::stop_to_limit:
+        n = snprintf(_buf, sizeof(_buf), "L,%lld,%lu,%.5f,%lu\n",
+                     _time, fid, (double)price, size);
+        _out.write(_buf, n);
+        break;
+
+    default:
+        break;
+    }
+}
+
+
+template<typename SobTy>
+void
+ReplayEngine<SobTy>::_reject(id_type fid, const char* reason)
+{
+    int n;
+
+    ++_stats.rejects;
+    n = snprintf(_buf, sizeof(_buf), "R,%lld,%lu,%s\n", _time, fid, reason);
+    _out.write(_buf, n);
+}
+
+
+template<typename SobTy>
+id_type
+ReplayEngine<SobTy>::_insert(order_type oty,
+                             bool buy,
+                             price_type limit,
+                             price_type stop,
+                             size_type size,
+                             id_type fid,
+                             const journal_record* r)
+{
+    id_type id;
+    owner_type owner = r ? r->owner : 0;
+    std::uint8_t flags = r ? r->flags : 0;
+    order_exec_cb_type cb =
+        [this,fid](callback_msg msg, id_type id, price_type price, size_type size)
+        {
+            this->_on_exec(fid, msg, id, price, size);
+        };
+
+    try{
+        switch(oty){
+        case order_type::limit:
+            if(flags & JOURNAL_FLAG_EXPIRY)
+                id = _book.insert_gtt_order(buy, limit, size, 
+                                            journal_record_expiry(*r, _time_base),
+                                            cb, nullptr, owner);
+            else if(flags & (JOURNAL_FLAG_PEG_PRIMARY | JOURNAL_FLAG_PEG_MIDPOINT))
+                id = _book.insert_peg_order(buy, 
+                                            (flags & JOURNAL_FLAG_PEG_PRIMARY) 
+                                                ? peg_type::primary 
+                                                : peg_type::midpoint,
+                                            size, cb, r->offset, nullptr, owner);
+            else if(r && r->display)
+                id = _book.insert_iceberg_order(buy, limit, r->display, size, cb, 
+                                                nullptr, owner);
+            else
+                id = _book.insert_limit_order(buy, limit, size, cb, nullptr, owner);
+            break;
+        case order_type::market:
+            id = _book.insert_market_order(buy, size, cb, nullptr, owner);
+            break;
+        case order_type::stop:
+            if(flags & JOURNAL_FLAG_EXPIRY)
+                id = _book.insert_gtt_stop_order(buy, stop, size, 
+                                                 journal_record_expiry(*r, _time_base),
+                                                 cb, nullptr, owner);
+            else if(flags & JOURNAL_FLAG_TRAILING)
+                id = _book.insert_trailing_stop_order(buy, r->offset, size, cb, nullptr, owner);
+            else
+                id = _book.insert_stop_order(buy, stop, size, cb, nullptr, owner);
+            break;
+        case order_type::stop_limit:
+            if(flags & JOURNAL_FLAG_EXPIRY)
+                id = _book.insert_gtt_stop_order(buy, stop, limit, size, 
+                                                 journal_record_expiry(*r, _time_base), 
+                                                 cb, nullptr, owner);
+            else if(flags & JOURNAL_FLAG_TRAILING)
+                id = _book.insert_trailing_stop_limit_order(buy, r->offset, r->display, size, 
+                                                            cb, nullptr, owner);
+            else
+                id = _book.insert_stop_order(buy, stop, limit, size, cb, nullptr, owner);
+            break;
+        case order_type::immediate_or_cancel:
+            id = _book.insert_ioc_order(buy, limit, size, cb, nullptr, owner);
+            break;
+        case order_type::fill_or_kill:
+            id = _book.insert_fok_order(buy, limit, size, cb, nullptr, owner);
+            break;
+        default:
+            _reject(fid, "invalid order type");
+            return 0;
+        }
+    }catch(liquidity_exception&){
+        _half_trade = false;
+        _reject(fid, "liquidity");
+        return 0;
+    }catch(std::invalid_argument&){
+        _reject(fid, "invalid order");
+        return 0;
+    }
+
+    /* only orders that can rest can be pulled */
+    if(oty == order_type::limit || oty == order_type::stop 
+       || oty == order_type::stop_limit)
+        _orders[fid] = order_ref_type(id, size);
+
+    return id;
+}
+
+
+template<typename SobTy>
+void
+ReplayEngine<SobTy>::_pull(id_type fid)
+{
+    auto oiter = _orders.find(fid);
+    if(oiter == _orders.end() || !_book.pull_order(oiter->second.first))
+        _reject(fid, "unknown order");
+}
+
+
+template<typename SobTy>
+id_type
+ReplayEngine<SobTy>::_modify(id_type fid, price_type limit, size_type size)
+{
+    id_type id, id_new;
+
+    auto oiter = _orders.find(fid);
+    if(oiter == _orders.end()){
+        _reject(fid, "unknown order");
+        return 0;
+    }
+
+    id = oiter->second.first;
+    oiter->second.second = size; /* fills(if it moves and trades) come off this */
+
+    try{
+        id_new = limit ? _book.modify_order(id, limit, size)
+                       : _book.modify_order(id, size);
+    }catch(std::invalid_argument&){
+        _reject(fid, "invalid order");
+        return 0;
+    }
+
+    if(!id_new){
+        _orders.erase(fid);
+        _reject(fid, "unknown order");
+        return 0;
+    }
+
+    oiter = _orders.find(fid);
+    if(oiter != _orders.end())
+        oiter->second.first = id_new;
+
+    return (id_new != id) ? id_new : 0;
+}
+
+
+template<typename SobTy>
+void
+ReplayEngine<SobTy>::_cancel_all(const journal_record& r, 
+                                 price_type low, 
+                                 price_type high)
+{
+    cancel_filter filter(r.owner, side_of_market::both, order_type::null, low, high);
+
+    if(!(r.cancel & SobTy::CANCEL_SELLS))
+        filter.side = side_of_market::bid;
+    else if(!(r.cancel & SobTy::CANCEL_BUYS))
+        filter.side = side_of_market::ask;
+
+    switch(r.cancel & (SobTy::CANCEL_LIMITS | SobTy::CANCEL_STOPS 
+                       | SobTy::CANCEL_STOP_LIMITS))
+    {
+    case SobTy::CANCEL_LIMITS:
+        filter.type = order_type::limit;
+        break;
+    case SobTy::CANCEL_STOPS:
+        filter.type = order_type::stop;
+        break;
+    case SobTy::CANCEL_STOP_LIMITS:
+        filter.type = order_type::stop_limit;
+        break;
+    }
+
+    /* each order's callback writes its own cancel line */
+    _book.cancel_all(filter);
+}
+
+
+template<typename SobTy>
+void
+ReplayEngine<SobTy>::_mass_quote(const std::vector<journal_record>& recs,
+                                 size_t& i,
+                                 const journal_header& hdr,
+                                 long long offset)
+{
+    quote_levels_type bids, asks;
+    double tick = (double)hdr.tick_num / hdr.tick_den;
+    owner_type session = recs[i].owner;
+
+    for(size_t n = recs[i].size; n && i + 1 < recs.size(); --n){
+        const journal_record& r = recs[++i];
+        (r.buy ? bids : asks).push_back( 
+            quote_level_type((hdr.min_incr + r.limit) * tick, r.size) 
+        );
+    }
+
+    /* one callback for the quote's orders; out by the journaling book's ids */
+    order_exec_cb_type cb =
+        [this,offset](callback_msg msg, id_type id, price_type price, size_type size)
+        {
+            this->_on_exec(id + offset, msg, id, price, size);
+        };
+
+    try{
+        _book.mass_quote(session, bids, asks, cb,
+            [this,offset](const quote_ack& a){
+                for(const quote_order_type& o : a.orders){
+                    this->_orders[std::get<0>(o) + offset] = 
+                        order_ref_type(std::get<0>(o), std::get<3>(o));
+                }
+            }
+        );
+    }catch(std::invalid_argument&){
+        _reject(0, "invalid quote");
+    }
+}
+
+
+template<typename SobTy>
+void
+ReplayEngine<SobTy>::_expire(const journal_record& r)
+{
+    _book.set_virtual_time( journal_record_expiry(r, _time_base) );
+    _set_time(_time);
+}
+
+
+template<typename SobTy>
+void
+ReplayEngine<SobTy>::_group(const std::vector<journal_record>& recs,
+                            size_t& i,
+                            const journal_header& hdr,
+                            long long offset)
+{
+    order_legs_type legs;
+    double tick = (double)hdr.tick_num / hdr.tick_den;
+    const journal_record& h = recs[i];
+
+    for(size_t n = h.size; n && i + 1 < recs.size(); --n){
+        const journal_record& r = recs[++i];
+        legs.push_back( 
+            order_leg((order_type)r.type, r.buy,
+                      (r.limit >= 0) ? (hdr.min_incr + r.limit) * tick : 0,
+                      (r.stop >= 0) ? (hdr.min_incr + r.stop) * tick : 0,
+                      r.size) 
+        );
+    }
+
+    /* one callback for the group's orders; out by the journaling book's ids */
+    order_exec_cb_type cb =
+        [this,offset](callback_msg msg, id_type id, price_type price, size_type size)
+        {
+            this->_on_exec(id + offset, msg, id, price, size);
+        };
+
+    /* (before any of their callbacks) */
+    group_admin_cb_type admin_cb = 
+        [this,offset,&legs](const std::vector<id_type>& ids)
+        {
+            for(size_t n = 0; n < ids.size() && n < legs.size(); ++n)
+                this->_orders[ids[n] + offset] = order_ref_type(ids[n], legs[n].size);
+        };
+
+    try{
+        if((h.flags & JOURNAL_FLAG_BRACKET) && legs.size() == 3){
+            _book.insert_bracket_order(legs[0].buy, legs[0].limit, legs[0].size,
+                                       legs[1].limit, legs[2].stop, cb, admin_cb,
+                                       h.owner);
+        }else{
+            _book.insert_oco_order(legs, cb, admin_cb, h.owner);
+        }
+    }catch(std::invalid_argument&){
+        _reject(0, "invalid group");
+    }
+}
+
+
+template<typename SobTy>
+void
+ReplayEngine<SobTy>::_parse_csv_line(char* line, size_type lineno)
+{
+    char* fields[7];
+    char* p;
+    int nfields;
+    bool buy;
+    long long t;
+    order_type oty;
+    id_type fid;
+    price_type limit, stop;
+    size_type size;
+    bool modify = false;
+
+    for(p = line; *p == ' ' || *p == '\t'; ++p)
+        {
+        }
+    if(*p == '\0' || *p == '#' || *p == '\r')
+        return;
+
+    nfields = 0;
+    fields[nfields++] = p;
+    for( ; *p && nfields < 7; ++p){
+        if(*p == ','){
+            *p = '\0';
+            fields[nfields++] = p + 1;
+        }
+    }
+
+    if(nfields != 7){
+        throw invalid_parameters(
+            cat("replay event needs 7 fields, line ", std::to_string(lineno)).c_str()
+        );
+    }
+
+    t = strtoll(fields[0], nullptr, 10);
+    fid = strtoul(fields[2], nullptr, 10);
+    buy = (fields[3][0] == 'B' || fields[3][0] == 'b');
+    limit = strtod(fields[4], nullptr);
+    stop = strtod(fields[5], nullptr);
+    size = strtoul(fields[6], nullptr, 10);
+
+    if(!strcmp(fields[1], "limit"))
+        oty = order_type::limit;
+    else if(!strcmp(fields[1], "market"))
+        oty = order_type::market;
+    else if(!strcmp(fields[1], "stop"))
+        oty = order_type::stop;
+    else if(!strcmp(fields[1], "stop_limit"))
+        oty = order_type::stop_limit;
+    else if(!strcmp(fields[1], "ioc"))
+        oty = order_type::immediate_or_cancel;
+    else if(!strcmp(fields[1], "fok"))
+        oty = order_type::fill_or_kill;
+    else if(!strcmp(fields[1], "pull"))
+        oty = order_type::null;
+    else if(!strcmp(fields[1], "modify")){
+        oty = order_type::null;
+        modify = true;
+    }
+    else{
+        throw invalid_parameters(
+            cat("invalid replay event type, line ", std::to_string(lineno)).c_str()
+        );
+    }
+
+    ++_stats.events;
+    _set_time(t);
+
+    if(modify)
+        _modify(fid, limit, size);
+    else if(oty == order_type::null)
+        _pull(fid);
+    else
+        _insert(oty, buy, limit, stop, size, fid);
+}
+
+
+template<typename SobTy>
+replay_stats
+ReplayEngine<SobTy>::run_csv(std::istream& in)
+{
+    std::string line;
+    size_type lineno = 0;
+
+    _stats = replay_stats();
+    auto t0 = clock_type::now();
+
+    while(std::getline(in, line))
+        _parse_csv_line(&line[0], ++lineno);
+
+    _out.flush();
+    _stats.seconds = std::chrono::duration<double>(clock_type::now() - t0).count();
+    return _stats;
+}
+
+
+template<typename SobTy>
+replay_stats
+ReplayEngine<SobTy>::run_csv(const std::string& path)
+{
+    std::ifstream in(path);
+    if(!in)
+        throw invalid_parameters(cat("could not open replay file: ", path.c_str()).c_str());
+
+    return run_csv(in);
+}
+
+
+template<typename SobTy>
+replay_stats
+ReplayEngine<SobTy>::run_journal(const std::string& path)
+{
+    journal_header hdr;
+    price_type limit, stop;
+    double tick;
+    id_type fid, id;
+    /* journal id - our book's id; ids are handed out in the same order */
+    long long offset;
+    /* id the book gave a moved order -> the id it was entered with */
+    std::unordered_map<id_type,id_type> moved;
+
+    std::vector<journal_record> recs = OrderJournal::Read(path, &hdr);
+    tick = (double)hdr.tick_num / hdr.tick_den;
+    _time_base = journal_time_base(hdr);
+
+    _stats = replay_stats();
+    offset = 0;
+    auto t0 = clock_type::now();
+
+    for(size_t i = 0; i < recs.size(); ++i){
+        const journal_record& r = recs[i];
+        if(r.flags & JOURNAL_FLAG_TRIGGERED || r.type == JOURNAL_REJECT)
+            continue;
+
+        ++_stats.events;
+        _set_time(r.seq);
+
+        limit = (r.limit >= 0) ? (hdr.min_incr + r.limit) * tick : 0;
+        stop = (r.stop >= 0) ? (hdr.min_incr + r.stop) * tick : 0;
+
+        if(r.type == (std::uint8_t)order_type::null && r.cancel){
+            _cancel_all(r, limit, stop);
+            continue;
+        }
+
+        if(r.flags & JOURNAL_FLAG_QUOTE){
+            _mass_quote(recs, i, hdr, offset);
+            continue;
+        }
+
+        if(r.flags & JOURNAL_FLAG_GROUP){
+            _group(recs, i, hdr, offset);
+            continue;
+        }
+
+        if(r.type == (std::uint8_t)order_type::null && (r.flags & JOURNAL_FLAG_EXPIRY)){
+            _expire(r);
+            continue;
+        }
+
+        if(r.type == (std::uint8_t)order_type::null){
+            auto miter = moved.find(r.id);
+            fid = (miter != moved.end()) ? miter->second : r.id;
+            if(!r.size)
+                _pull(fid);
+            else if( (id = _modify(fid, limit, r.size)) )
+                moved[id + offset] = fid;
+            continue;
+        }
+
+        if(i + 1 < recs.size() && recs[i+1].type == JOURNAL_REJECT 
+           && recs[i+1].id == r.seq)
+        {
+            _reject(r.id, "memory limit");
+            ++i;
+            continue;
+        }
+
+        id = _insert((order_type)r.type, r.buy, limit, stop, r.size, r.id, &r);
+        if(id)
+            offset = (long long)r.id - (long long)id;
+    }
+
+    _out.flush();
+    _stats.seconds = std::chrono::duration<double>(clock_type::now() - t0).count();
+    return _stats;
+}
+
+};
+
+#endif /* JO_0815_REPLAY_ENGINE */
@@ -51,6 +51,12 @@ order_type_str(const order_type& ot) /* types.hpp */
     case order_type::stop_limit: 
         return "stop_limit";
         /* no break */
+    case order_type::immediate_or_cancel: 
+        return "ioc";
+        /* no break */
+    case order_type::fill_or_kill: 
+        return "fok";
+        /* no break */
     default: 
         return "null";
     }
@@ -72,6 +78,45 @@ operator<<(std::ostream& out, const order_info_type& o) /* types.hpp */
     return out;
 }
 
+std::string
+memory_component_str(const memory_component& mc) /* types.hpp */
+{
+    switch(mc){
+    case memory_component::limit_chains:
+        return "limit_chains";
+        /* no break */
+    case memory_component::stop_chains:
+        return "stop_chains";
+        /* no break */
+    case memory_component::ladder:
+        return "ladder";
+        /* no break */
+    case memory_component::order_queue:
+        return "order_queue";
+        /* no break */
+    case memory_component::callback_queue:
+        return "callback_queue";
+        /* no break */
+    default:
+        return "time_and_sales";
+    }
+}
+
+std::ostream&
+operator<<(std::ostream& out, const memory_usage_type& mu) /* types.hpp */
+{
+    for(int i = 0; i < memory_usage_type::ncomponents; ++i){
+        out<< memory_component_str((memory_component)i) << ": "
+           << mu.bytes[i] << " bytes, " << mu.objects[i] << " objects" 
+           << std::endl;
+    }
+    out<< "total: " << mu.total_bytes() << " bytes";
+    if(mu.limit)
+        out<< " (limit " << mu.limit << ")";
+    return out;
+}
+
+
 
 namespace SimpleOrderbook{
 
@@ -19,6 +19,7 @@ along with this program.  If not, see http://www.gnu.org/licenses.
 #define JO_0815_SIMPLE_ORDERBOOK
 
 #include <map>
+#include <unordered_map>
 #include <vector>
 #include <memory>
 #include <iostream>
@@ -36,8 +37,17 @@ along with this program.  If not, see http://www.gnu.org/licenses.
 #include <condition_variable>
 #include <chrono>
 #include <fstream>
+#include <exception>
+#include <cstdint>
+#include <limits>
 
 #include "marketmaker.hpp"
+#include "orderjournal.hpp"
+#include "eventfeed.hpp"
+#include "latencystats.hpp"
+#include "enginecounters.hpp"
+#include "countingallocator.hpp"
+#include "tracepoints.hpp"
 
 namespace NativeLayer{
 
@@ -51,7 +61,8 @@ namespace SimpleOrderbook{
  *   provides a memory limit. Upon construction, if the memory required to build
  *   the internal 'chains' of the book exceeds this memory limit it throws 
  *   NativeLayer::allocation_error. (NOTE: MaxMemory is not the maximum total
- *   memory the book can use, as number and types of orders are run-time dependent)
+ *   memory the book can use, as number and types of orders are run-time dependent;
+ *   see memory_usage() and set_memory_limit(...))
  *
  *   types.hpp contains a number of important global objects and typedefs,
  *   including instantiations of SimpleOrderbook with the most popular tick
@@ -84,6 +95,66 @@ namespace SimpleOrderbook{
  *   On success the order id will be returned, 0 on failure. The order id for a 
  *   stop-limit becomes the id for the limit once the stop is triggered.
  *
+ *   insert_ioc_order(...) and insert_fok_order(...) take a limit price but 
+ *   never rest: an immediate-or-cancel order fills what it can through its 
+ *   limit; a fill-or-kill order first checks there's enough size through its
+ *   limit(not counting the owner's own orders under a self-trade prevention
+ *   policy) and fills all of it or none. Either way what isn't filled is 
+ *   cancelled, calling back with callback_msg::cancel, the limit and the 
+ *   size cancelled.
+ *
+ *   insert_iceberg_order(...) inserts a limit order that only shows 'display'
+ *   of its 'size' at a time. When the displayed slice is filled the book 
+ *   shows the next one from the reserve, at the back of the line at that 
+ *   price. Depth, inside size and the feeds only see the displayed slice; 
+ *   fills and the cancel callback are under the order's id(the feeds give 
+ *   each slice its own id). Icebergs can't be modified.
+ *
+ *   insert_peg_order(...) inserts a limit order whose price follows the best
+ *   bid or ask(peg_type::primary) or the midpoint(peg_type::midpoint),
+ *   'offset' ticks less aggressive. It follows the best prices of orders that
+ *   aren't pegged, so pegs can't chase each other, and is repriced once the
+ *   command that moved them is done: to the back of the line at the new
+ *   price, trading first if it crosses(only another peg can be crossed).
+ *   Like an iceberg it rests under a new id each time it moves(the feeds see
+ *   a modify) while fills, pulls and the cancel callback use the order's id.
+ *   Throws invalid_order if there's nothing to peg to; pegged orders can't
+ *   be modified.
+ *
+ *   insert_trailing_stop_order(...) and insert_trailing_stop_limit_order(...)
+ *   insert a stop(stop-limit) 'trail' ticks behind the last price: below it
+ *   for a sell, above it for a buy. As trades print past the best price 
+ *   since it was inserted the engine ratchets the stop(and the limit, 
+ *   'limit_offset' ticks past the stop) after it; it never moves back. 
+ *   Otherwise they're ordinary stops: same chains, ids, callbacks and 
+ *   triggering(the feeds see each ratchet as a modify).
+ *
+ *   insert_oco_order(...) inserts a one-cancels-other group of limit, stop
+ *   and stop-limit orders(limits can't cross each other) linked inside the
+ *   book: when one of them fills(any of it) or is triggered the rest are
+ *   cancelled, w/ cancel callbacks, in the same command. If one trades as
+ *   it goes in the ones after it aren't inserted, just cancelled.
+ *   insert_bracket_order(...) inserts an entry limit order that, once it's
+ *   completely filled, places a take-profit limit and a stop-loss stop for
+ *   its size on the other side as an OCO. Their ids are given out w/ the
+ *   entry's(like a stop-limit's limit they keep them when placed); if the
+ *   entry is pulled, partly filled or not, the bracket goes w/ it. Both
+ *   return the ids of the group's orders, in order, and pass them to the
+ *   admin callback. Pulling an order takes it out of its group; orders in
+ *   a group can't be modified and mass_quote(...) leaves them alone.
+ *
+ *   insert_gtt_order(...) and insert_gtt_stop_order(...) insert a good-till-
+ *   time limit, stop or stop-limit order that the book pulls, w/ a cancel
+ *   callback, once its clock(the wall clock or the virtual one, see
+ *   set_virtual_time) reaches 'expire'(good-till-date: convert the date to
+ *   the book's clock). The expiries are kept in a heap owned by the book;
+ *   the dispatcher sweeps everything due, as one command, when it's idle
+ *   and the first one comes up(wall clock), before routing the next order
+ *   and when set_virtual_time(...) passes one. A triggered stop-limit's
+ *   limit keeps the expiry, a modify that moves the order takes it along.
+ *   Cancel callbacks of a sweep the dispatcher does on its own are delivered
+ *   like any other deferred callbacks, with the next call into the book.
+ *
  *   pull_order(...) attempts to cancel the order, calling back with the id
  *   and callback_msg::cancel on success
  *
@@ -91,6 +162,47 @@ namespace SimpleOrderbook{
  *   respective insert call, if pull_order is successful. On success the order 
  *   id will be returned, 0 on failure.
  *
+ *   modify_order(...) changes the size and/or price of a resting limit order
+ *   in one pass through the book. Reducing the size at the same price is done
+ *   in place: the order keeps its id and its place in line. Anything else
+ *   (new price, more size) moves it to the back of the line at its(new)
+ *   price with a new id, trading first if the new price crosses; it keeps
+ *   its callback and there's no cancel callback. Returns the order's id(new
+ *   or old) or 0 if there's no such resting limit order.
+ *
+ *   The insert calls(and their replace calls) take an optional 'owner' tag 
+ *   (e.g. a session or market maker); it stays with the order, and with the
+ *   limit(market) order a stop-limit(stop) becomes.
+ *
+ *   set_stp_policy(...) turns on self-trade prevention: when an order would
+ *   trade against a resting order w/ the same(non-zero) owner tag the book,
+ *   instead of a fill, cancels what's left of the incoming order, the resting
+ *   order or both, or takes the smaller size off both(see stp_policy in 
+ *   types.hpp). The check is an integer compare per resting order hit, and 
+ *   is only made if there's a policy. Cancels come w/ cancel callbacks for
+ *   the size cancelled(the rest of an incoming order's size never rests, 
+ *   and a market order that's cancelled this way doesn't throw); a resting 
+ *   order that's decremented gets one for the size taken off. The policy is
+ *   book-wide, isn't journaled or snapshot: a book replaying a journal needs
+ *   the same one.
+ *
+ *   cancel_all(...) cancels every resting order that matches a cancel_filter
+ *   (owner, side, type, price band; see types.hpp) as one command: it walks
+ *   only the levels in the band on the sides asked for, fixes up the cached
+ *   extremes once at the end and delivers the cancel callbacks together. 
+ *   Returns the number of orders cancelled.
+ *
+ *   mass_quote(...) replaces a session's quote(its resting limit orders, by
+ *   owner tag) w/ new bid and ask levels(price, total size) in one command.
+ *   At a level it still quotes the session's orders are kept in line, cut
+ *   down in place and/or pulled to get to the new size; more size is added 
+ *   as a new order at the back. Levels it no longer quotes are pulled(w/ 
+ *   cancel callbacks). Both sides are pulled/reduced before anything new is
+ *   inserted, and the quote can't be crossed. The consolidated quote_ack
+ *   (see types.hpp) goes to the admin callback, before any callbacks for the
+ *   quote's orders, and is returned. The session's icebergs, pegged orders
+ *   and orders in a group are left alone.
+ *
  *   Some of the state calls(via SimpleOrderbook::QueryInterface):
  *
  *       bid_price / ask_price: current 'inside' bid / ask price
@@ -128,6 +240,81 @@ namespace SimpleOrderbook{
  *   The dump calls(via SimpleOrderbook::FullInterface) will dump ALL the
  *   orders - of the type named in the call - in a readable form to stdout.
  *
+ *   open_journal(...) starts a binary write-ahead journal(see orderjournal.hpp)
+ *   of every command routed into the book; callers are released once the 
+ *   batch containing their order has been committed. replay_journal(...) 
+ *   rebuilds a new book from a journal, routing directly into the book(no 
+ *   dispatcher round trips) and bypassing all callbacks. Orders the memory 
+ *   limit rejected are journaled as such and aren't routed again; the book 
+ *   is left w/ the journal's memory limit.
+ *
+ *   set_direct_mode(true) puts the book in a single-threaded, dispatcher-less
+ *   mode: the insert/pull/replace calls route the order from the calling 
+ *   thread, execute any stops it triggers immediately after it(in order), 
+ *   and deliver callbacks before returning. Combined with set_virtual_time(...)
+ *   (time & sales stamped with a caller-supplied clock) it makes runs over 
+ *   the same order flow reproducible(see replayengine.hpp).
+ *
+ *   start_simulation(seed, start) goes one step further for runs that 
+ *   include market makers: direct mode and the virtual clock(from 'start'),
+ *   each market maker reseeded(MarketMaker::seed) from 'seed' in the order
+ *   it was added and the waker replaced by the virtual clock: each time
+ *   set_virtual_time(...) passes another wake interval('sleep' from the
+ *   constructor) every market maker is woken, in the same order. Market 
+ *   makers added after it are seeded before they start, so their initial
+ *   orders are reproducible too. The same seed and the same calls give the
+ *   same fills, callbacks and time & sales, run after run.
+ *
+ *   By default market makers run in the callback path: whichever thread 
+ *   drains the callback queue runs them, one after another, and their 
+ *   orders are routed(and their callbacks delivered) recursively, bounded by 
+ *   MarketMaker::RECURSE_LIMIT. set_agent_threads(n) moves them onto n agent
+ *   workers(see agentruntime.hpp): each market maker gets its own inbox,
+ *   draining the callback queue just posts to them, and the workers run 
+ *   different market makers in parallel, each submitting its orders from
+ *   its worker. An agent only waits for its own order to be routed, not for
+ *   the order queue to drain. wait_for_agents() blocks until they've all 
+ *   settled. Agent threads can't be used in direct mode.
+ *
+ *   set_mbo_feed(...) attaches a level-3(market-by-order) feed(see 
+ *   eventfeed.hpp): every add, cancel, execution and stop trigger is 
+ *   published, with a sequence number, from inside the matching path. 
+ *   Attaching publishes a clear and an image of the resting orders first.
+ *   set_l2_feed(...) does the same for price levels: the new aggregate size
+ *   of every limit level that changes, plus a full refresh on attach and
+ *   every 'refresh_every' updates.
+ *
+ *   enable_latency_stats() starts timing each order at enqueue, dequeue by
+ *   the dispatcher, end of routing and callback delivery into log-bucketed
+ *   histograms by order type and stage(see latencystats.hpp); latency_stats()
+ *   returns them for percentile queries. Disabled by default.
+ *
+ *   memory_usage() breaks the footprint of the book down by component: the
+ *   chains and queues allocate through counting allocators, the ladder and 
+ *   time & sales are fixed-size. (Captures held by std::function callbacks 
+ *   beyond the size of the function object itself aren't seen.) With 
+ *   set_memory_limit(...) limit orders that don't cross and stop orders are
+ *   rejected(allocation_error) while the book is at or over the limit; 
+ *   orders that can only reduce it(pulls, market and marketable limit 
+ *   orders, orders from triggered stops) still go through. The limit is 
+ *   checked against process-local allocator byte counts, so whether an order
+ *   is rejected isn't reproducible from the order flow alone: rejections 
+ *   are journaled(replay_journal skips the orders rather than re-checking 
+ *   them) and snapshots only hold what was accepted, but a replay of the 
+ *   same flow w/o a journal(e.g. replayengine.hpp's CSV) may not reject the
+ *   same orders.
+ *
+ *   counters() are always on: orders accepted/rejected by type, fills, 
+ *   levels swept, stop trigger cascades, peak order and callback queue 
+ *   depths, callback skips and contention on the master lock. They can be
+ *   sampled from any thread without locking(see enginecounters.hpp).
+ *
+ *   snapshot(...) writes the entire state of the book - limit and stop 
+ *   chains, cached extremes, last, last id, volume, time & sales - to a
+ *   compact, versioned binary file; restore(...) bulk-loads that file into a
+ *   new book without matching. Callbacks can't be saved: restored orders
+ *   have none.
+ *
  *   For the time being copy/move/assign is restricted
  *
  *   ::New(...) can be used as a factory w/ basic type-checking
@@ -137,6 +324,147 @@ namespace SimpleOrderbook{
  */
 
 
+/*
+ *   snapshot file layout (host byte order):
+ *
+ *       snapshot_header
+ *       snapshot_header::nlimits x snapshot_limit
+ *       snapshot_header::nstops x snapshot_stop
+ *       snapshot_header::ntands x snapshot_tands
+ *       snapshot_header::nicebergs x snapshot_iceberg
+ *       snapshot_header::npegs x snapshot_peg
+ *       snapshot_header::ntrailing x snapshot_trailing
+ *       snapshot_header::ngroups x snapshot_group
+ *       snapshot_header::nexpiries x snapshot_expiry
+ *
+ *   prices are tick indices from the min price of the book; -1 and
+ *   total_incr are the null positions below and above the book
+ */
+
+struct snapshot_header {
+    char magic[4];
+    std::uint32_t version;
+    std::int64_t tick_num;
+    std::int64_t tick_den;
+    std::int64_t min_incr;
+    std::uint64_t total_incr;
+    std::uint64_t last_id;
+    std::uint64_t volume;
+    std::uint64_t last_size;
+    std::int32_t last;
+    std::int32_t bid;
+    std::int32_t ask;
+    std::int32_t low_buy_limit;
+    std::int32_t high_sell_limit;
+    std::int32_t low_buy_stop;
+    std::int32_t high_buy_stop;
+    std::int32_t low_sell_stop;
+    std::int32_t high_sell_stop;
+    std::uint32_t pad;
+    std::uint64_t nlimits;
+    std::uint64_t nstops;
+    std::uint64_t ntands;
+    std::uint64_t nicebergs;
+    std::uint64_t npegs;
+    std::uint64_t ntrailing;
+    std::uint64_t ngroups;
+    std::uint64_t nexpiries;
+};
+
+struct snapshot_limit {
+    std::uint64_t id;
+    std::uint64_t size;
+    std::int32_t tick;
+    std::uint32_t owner;
+    std::uint8_t buy;
+    std::uint8_t pad[7];
+};
+
+struct snapshot_stop {
+    std::uint64_t id;
+    std::uint64_t size;
+    std::int32_t tick;
+    std::int32_t limit; /* -1 if stop-market */
+    std::uint8_t buy;
+    std::uint8_t pad[3];
+    std::uint32_t owner;
+};
+
+struct snapshot_tands {
+    std::int64_t time; /* system_clock, nanoseconds since epoch */
+    std::uint64_t size;
+    std::int32_t tick;
+    std::uint32_t pad;
+};
+
+/* the hidden side of a resting iceberg; its slice is in the limits */
+struct snapshot_iceberg {
+    std::uint64_t slice_id;
+    std::uint64_t id;
+    std::uint64_t display;
+    std::uint64_t reserve;
+};
+
+/* a resting pegged order; rid is the id it rests under in the limits */
+struct snapshot_peg {
+    std::uint64_t rid;
+    std::uint64_t id;
+    std::uint64_t offset;
+    std::int32_t tick;
+    std::uint8_t buy;
+    std::uint8_t peg; /* peg_type */
+    std::uint8_t pad[2];
+};
+
+/* a trailing stop; its stop(w/ the current stop/limit) is in the stops */
+struct snapshot_trailing {
+    std::uint64_t id;
+    std::uint64_t trail;
+    std::int32_t mark; /* the high(sells) or low(buys) it trails */
+    std::int32_t tick; /* the stop */
+    std::uint32_t limit_offset;
+    std::uint8_t buy;
+    std::uint8_t stop_limit;
+    std::uint8_t pad[2];
+};
+
+/* an order in a group, which is in the limits/stops; a bracket whose entry
+   hasn't filled is one record, the entry's, w/ what it places when it does */
+struct snapshot_group {
+    std::uint64_t group;
+    std::uint64_t id;
+    std::uint64_t profit_id; /* bracket: the take-profit's id(0 if not one) */
+    std::uint64_t loss_id;
+    std::uint64_t size; /* bracket: the entry's size */
+    std::int32_t profit;
+    std::int32_t loss;
+    std::uint32_t owner;
+    std::uint8_t stop; /* a stop(-limit) */
+    std::uint8_t buy; /* bracket: the entry's side */
+    std::uint8_t pad[2];
+};
+
+/* a GTT order's expiry: system time if the book was on the wall clock, so
+   it means something later(like time & sales), else virtual clock ticks */
+struct snapshot_expiry {
+    std::uint64_t id;
+    std::int64_t expire;
+    std::int32_t tick;
+    std::uint8_t stop; /* a stop(-limit) */
+    std::uint8_t wall;
+    std::uint8_t pad[2];
+};
+
+static_assert(sizeof(snapshot_limit) == 32, "snapshot_limit must be 32 bytes");
+static_assert(sizeof(snapshot_stop) == 32, "snapshot_stop must be 32 bytes");
+static_assert(sizeof(snapshot_tands) == 24, "snapshot_tands must be 24 bytes");
+static_assert(sizeof(snapshot_iceberg) == 32, "snapshot_iceberg must be 32 bytes");
+static_assert(sizeof(snapshot_peg) == 32, "snapshot_peg must be 32 bytes");
+static_assert(sizeof(snapshot_trailing) == 32, "snapshot_trailing must be 32 bytes");
+static_assert(sizeof(snapshot_group) == 56, "snapshot_group must be 56 bytes");
+static_assert(sizeof(snapshot_expiry) == 24, "snapshot_expiry must be 24 bytes");
+
+
 #define SOB_TEMPLATE template<typename TickRatio,size_type MaxMemory>
 #define SOB_CLASS SimpleOrderbook<TickRatio,MaxMemory>
 
@@ -160,6 +488,13 @@ public:
     static constexpr double tick_size = (double)tick_ratio::num / tick_ratio::den;
     static constexpr double ticks_per_unit = tick_ratio::den / tick_ratio::num;
 
+    /* the sides/types of a cancel_all, as routed and journaled */
+    static const std::uint8_t CANCEL_BUYS = 0x01;
+    static const std::uint8_t CANCEL_SELLS = 0x02;
+    static const std::uint8_t CANCEL_LIMITS = 0x04;
+    static const std::uint8_t CANCEL_STOPS = 0x08;
+    static const std::uint8_t CANCEL_STOP_LIMITS = 0x10;
+
 private:
     static_assert(!std::ratio_less<TickRatio,std::ratio<1,10000>>::value,
                   "Increment Ratio < ratio<1,10000> " );
@@ -171,15 +506,20 @@ private:
     typedef std::tuple<callback_msg, order_exec_cb_type,
                        id_type, price_type,size_type>  dfrd_cb_elem_type;
 
-    /* limit bundle type holds the size and callback of each limit order
+    /* limit bundle type holds the size, callback and owner of each limit order
      * limit 'chain' type holds all limit orders at a price */
-    typedef std::pair<size_type, order_exec_cb_type> limit_bndl_type;
-    typedef std::map<id_type, limit_bndl_type> limit_chain_type;
+    typedef std::tuple<size_type,order_exec_cb_type,owner_type> limit_bndl_type;
+    typedef std::map<id_type, limit_bndl_type, std::less<id_type>,
+                     counting_allocator<std::pair<const id_type, limit_bndl_type>>
+                     > limit_chain_type;
 
-    /* stop bundle type holds the size and callback of each stop order
+    /* stop bundle type holds the side, limit, size, callback and owner of 
+     * each stop order
      * stop 'chain' type holds all stop orders at a price(limit or market) */
-    typedef std::tuple<bool,void*,size_type,order_exec_cb_type> stop_bndl_type;
-    typedef std::map<id_type, stop_bndl_type> stop_chain_type;
+    typedef std::tuple<bool,void*,size_type,order_exec_cb_type,owner_type> stop_bndl_type;
+    typedef std::map<id_type, stop_bndl_type, std::less<id_type>,
+                     counting_allocator<std::pair<const id_type, stop_bndl_type>>
+                     > stop_chain_type;
 
     /* chain pair is the limit and stop chain at a particular price
      * use a (less safe) pointer for plevel because iterator
@@ -192,7 +532,172 @@ private:
     /* a vector of all chain pairs (how we reprsent the 'book' internally) */
     typedef std::vector<chain_pair_type> order_book_type;
 
-    /* type, buy/sell, limit, stop, size, exec cb, id, admin cb, promise */
+    /* a mass_quote's levels by side(sorted, no size 0), its admin callback
+       and the ack the dispatcher fills in for the caller */
+    typedef std::vector<std::pair<plevel,size_type>> quote_side_type;
+
+    struct quote_bndl_type {
+        quote_side_type bids;
+        quote_side_type asks;
+        quote_admin_cb_type admin_cb;
+        quote_ack ack;
+    };
+
+    /* an order group as routed: its orders(a bracket's are the entry, the
+       take-profit and the stop-loss), its admin callback and the ids the 
+       dispatcher gives them for the caller */
+    struct group_leg_type {
+        order_type type;
+        bool buy;
+        plevel limit;
+        plevel stop;
+        size_type size;
+    };
+
+    struct group_cmd_type {
+        std::vector<group_leg_type> legs;
+        bool bracket;
+        group_admin_cb_type admin_cb;
+        std::vector<id_type> ids;
+    };
+
+    /* the less common order parameters, carried through the order queue */
+    struct order_params_type {
+        size_type display; /* iceberg: size shown at a time(0 = all of it) */
+        owner_type owner;
+        std::uint8_t cancel; /* cancel_all: CANCEL_ bits(0 = not one) */
+        std::shared_ptr<quote_bndl_type> quote; /* mass_quote */
+        std::uint8_t peg; /* pegged: peg_type + 1(0 = not pegged) */
+        size_type offset; /* pegged: ticks less aggressive than the peg */
+        size_type trail; /* trailing stop: ticks behind the last(0 = not one) */
+        size_type limit_offset; /* trailing stop-limit: ticks from stop to limit */
+        std::shared_ptr<group_cmd_type> group; /* OCO or bracket group */
+        time_stamp_type expire; /* GTT: when it expires(epoch = never); a sweep: up to when */
+        bool sweep; /* expiry sweep */
+
+        order_params_type(size_type display = 0, 
+                          owner_type owner = 0, 
+                          std::uint8_t cancel = 0,
+                          std::shared_ptr<quote_bndl_type> quote = nullptr)
+            :
+                display(display),
+                owner(owner),
+                cancel(cancel),
+                quote(quote),
+                peg(0),
+                offset(0),
+                trail(0),
+                limit_offset(0),
+                group(nullptr),
+                expire(),
+                sweep(false)
+            {
+            }
+
+        /* a cancel_all, mass_quote, group or expiry sweep; commands, not 
+           orders, so no id */
+        inline bool
+        is_command() const
+        {
+            return cancel || quote || group || sweep;
+        }
+    };
+
+    /* a cancel_all command is order_type::null w/ the filter's sides and 
+       types as CANCEL_ bits(see above), its price band in the limit(low) 
+       and stop(high) fields and its owner in the params; a mass_quote is 
+       order_type::null w/ its session as the owner, its levels in the 
+       params and the exec callback for all of its orders; a group is 
+       order_type::null w/ its orders in the params, their exec callback 
+       and their owner; an expiry sweep is order_type::null w/ 'sweep' and
+       the time it sweeps up to in the params */
+
+    /* iceberg orders rest one(displayed) slice at a time; each slice has 
+       its own id(priority) so they're kept by slice id w/ the order's id 
+       and the reserve still hidden, and by order id w/ the resting slice */
+    struct iceberg_bndl_type {
+        id_type id;
+        size_type display;
+        size_type reserve;
+    };
+    typedef std::unordered_map<id_type, iceberg_bndl_type> iceberg_slices_type;
+    typedef std::unordered_map<id_type, id_type> iceberg_orders_type;
+
+    /* pegged orders are kept in a chain per side and peg_type(so repricing
+       only walks them), by order id w/ where they rest and under what id, 
+       by resting id w/ the order's id and its chain, and by order id w/ its
+       chain(so finding one doesn't walk every chain) */
+    struct peg_bndl_type {
+        id_type rid;
+        plevel limit;
+        size_type offset;
+    };
+    typedef std::map<id_type, peg_bndl_type> peg_chain_type;
+    typedef std::unordered_map<id_type, 
+                               std::pair<id_type, peg_chain_type*>> peg_resting_type;
+    typedef std::unordered_map<id_type, peg_chain_type*> peg_orders_type;
+
+    /* trailing stops rest in the stop chains; they're also kept by side, 
+       in order of the high(sells) or low(buys) of the last they trail, so
+       a print only has to touch those it moves past(and by id to find 
+       them on the way out) */
+    struct trailing_bndl_type {
+        id_type id;
+        bool buy;
+        bool stop_limit;
+        size_type trail;
+        size_type limit_offset;
+        plevel stop;
+    };
+    typedef std::multimap<plevel, trailing_bndl_type> trailing_stops_type;
+    typedef std::unordered_map<id_type, 
+                               typename trailing_stops_type::iterator> trailing_ids_type;
+
+    /* order groups are kept by group id(its first order's id) w/ their 
+       orders, and by order id w/ the group. A bracket's group is just its
+       entry, w/ what it places, until the entry fills; the take-profit and
+       stop-loss are then placed as an OCO group of their own */
+    struct group_bndl_type {
+        std::vector<std::pair<id_type,bool>> orders; /* id, is a stop(-limit) */
+        order_exec_cb_type exec_cb;
+        owner_type owner;
+        bool buy; /* bracket: the entry's side */
+        size_type size; /* bracket: the entry's size */
+        plevel profit;
+        plevel loss;
+        id_type profit_id; /* bracket: 0 if not one */
+        id_type loss_id;
+    };
+    typedef std::unordered_map<id_type, group_bndl_type> groups_type;
+    typedef std::unordered_map<id_type, id_type> group_ids_type;
+
+    /* GTT orders are kept by id w/ their expiry and where they rest, and in 
+       a min-heap by expiry the sweeps pop off of. Orders that leave the book
+       are only erased by id; their heap entries go stale(no id, or another 
+       expiry) and are skipped, or pruned when they reach the top */
+    struct expiry_bndl_type {
+        time_stamp_type expire;
+        plevel where;
+        bool stop;
+    };
+    typedef std::unordered_map<id_type, expiry_bndl_type> expiries_type;
+    typedef std::pair<time_stamp_type, id_type> expiry_elem_type;
+    typedef std::priority_queue<expiry_elem_type,
+                                std::vector<expiry_elem_type>,
+                                std::greater<expiry_elem_type>> expiry_heap_type;
+
+    /* a peg taken out to be repriced(see _reprice_pegs) */
+    struct peg_move_type {
+        id_type id;
+        id_type rid;
+        bool buy;
+        plevel limit;
+        limit_bndl_type bndl;
+        peg_chain_type* chain;
+    };
+
+    /* type, buy/sell, limit, stop, size, exec cb, id, admin cb, promise, 
+       enqueue time(only if latency stats are enabled), params */
     typedef std::tuple<order_type,
                        bool,
                        plevel,
@@ -201,7 +706,36 @@ private:
                        order_exec_cb_type,
                        id_type,
                        order_admin_cb_type,
-                       std::promise<id_type>>  order_queue_elem_type;
+                       std::promise<id_type>,
+                       time_stamp_type,
+                       order_params_type>  order_queue_elem_type;
+
+    typedef std::deque<order_queue_elem_type, 
+                       counting_allocator<order_queue_elem_type>> order_deque_type;
+
+    typedef std::deque<dfrd_cb_elem_type,
+                       counting_allocator<dfrd_cb_elem_type>> dfrd_cb_deque_type;
+
+    /* live bytes/allocations of the chains and queues, by memory_component;
+       ladder and time_and_sales are fixed-size and computed in memory_usage()
+       (declared before _book so they're ready for its chains) */
+    allocation_counter _alloc_counters[memory_usage_type::ncomponents];
+    std::atomic<size_type> _memory_limit;
+
+    template<typename T>
+    inline counting_allocator<T>
+    _counting_allocator(memory_component mc)
+    {
+        return counting_allocator<T>(&_alloc_counters[(int)mc]);
+    }
+
+    /* tracked bytes, without locking */
+    size_type
+    _memory_total() const;
+
+    /* PART OF THE ENCLOSING CRITICAL SECTION; throws allocation_error */
+    void
+    _check_memory_limit(const order_queue_elem_type& e);
 
     /* state fields */
     size_type _bid_size;
@@ -232,11 +766,42 @@ private:
     large_size_type _total_volume;
     large_size_type _last_id;
 
+    /* resting icebergs(see iceberg_bndl_type) */
+    iceberg_slices_type _iceberg_slices;
+    iceberg_orders_type _iceberg_orders;
+
+    /* resting pegged orders, [buy][peg_type](see peg_bndl_type), and the 
+       best bid/ask that isn't pegged they were last priced off of */
+    peg_chain_type _peg_chains[2][2];
+    peg_resting_type _peg_resting;
+    peg_orders_type _peg_orders;
+    plevel _peg_bid;
+    plevel _peg_ask;
+
+    /* resting trailing stops, [buy](see trailing_bndl_type) */
+    trailing_stops_type _trailing_stops[2];
+    trailing_ids_type _trailing_ids;
+
+    /* linked order groups(see group_bndl_type) and the brackets whose entry
+       filled in the command being routed, placed at the end of it */
+    groups_type _groups;
+    group_ids_type _group_ids;
+    std::vector<group_bndl_type> _brackets_filled;
+
+    /* resting GTT orders(see expiry_bndl_type) and the first expiry on the
+       heap, in clock ticks(0 = none), for the dispatcher to wait on */
+    expiries_type _expiries;
+    expiry_heap_type _expiry_heap;
+    std::atomic<clock_type::rep> _next_expiry;
+
+    /* self-trade prevention(see set_stp_policy) */
+    stp_policy _stp;
+
     /* autonomous market makers */
     market_makers_type _market_makers;
 
     /* store deferred callbacks info until we are clear to execute */
-    std::deque<dfrd_cb_elem_type> _deferred_callback_queue;
+    dfrd_cb_deque_type _deferred_callback_queue;
 
     /* time & sales */
     std::vector< t_and_s_type > _t_and_s;
@@ -244,7 +809,7 @@ private:
     bool _t_and_s_full;
 
     /* async order queue and sync objects */
-    std::queue<order_queue_elem_type> _order_queue;
+    std::queue<order_queue_elem_type, order_deque_type> _order_queue;
     std::unique_ptr<std::mutex> _order_queue_mtx;
     std::condition_variable _order_queue_cond;
     std::thread _order_dispatcher_thread;
@@ -254,6 +819,184 @@ private:
     void 
     _block_on_outstanding_orders();
 
+    /* promise, id, exception of orders waiting on a journal commit */
+    typedef std::tuple<std::promise<id_type>,
+                       id_type,
+                       std::exception_ptr> journal_pending_elem_type;
+
+    /* write-ahead journal; only touched by the dispatcher once set */
+    std::shared_ptr<OrderJournal> _journal;
+    std::vector<journal_pending_elem_type> _journal_pending;
+    size_type _journal_batch_max;
+
+    /* direct(dispatcher-less) routing from the calling thread; triggered
+       stops are diverted here instead of the order queue */
+    bool _direct;
+    order_deque_type _direct_orders;
+
+    id_type
+    _route_direct(order_queue_elem_type&& e);
+
+    /* virtual clock for time & sales and GTT orders(see set_virtual_time); 
+       the dispatcher only waits on wall clock expiries */
+    std::atomic_bool _use_virtual_time;
+    time_stamp_type _virtual_time;
+
+    inline time_stamp_type
+    _now() const
+    {
+        return _use_virtual_time ? _virtual_time : clock_type::now();
+    }
+
+    /* seeded simulation(see start_simulation); wakes on the virtual clock */
+    bool _sim;
+    unsigned long long _sim_seed;
+    unsigned long long _sim_nseeded;
+    clock_type::duration _wake_interval;
+    time_stamp_type _next_wake;
+
+    /* PART OF THE _mm_mtx CRITICAL SECTION */
+    void
+    _sim_seed_market_maker(MarketMaker& mm);
+
+    /* wake the market makers once for each wake interval tp has passed */
+    void
+    _sim_wake(time_stamp_type tp);
+
+    journal_header
+    _journal_header() const;
+
+    /* returns the seq of the(first) record */
+    std::uint64_t
+    _journal_order(OrderJournal* journal, 
+                   const order_queue_elem_type& e, 
+                   id_type id);
+
+    /* commit journal and release the orders waiting on it */
+    void
+    _commit_journal(OrderJournal* journal);
+
+    order_queue_elem_type
+    _journal_record_to_order(const journal_record& r, 
+                             time_stamp_type time_base) const;
+
+    /* a mass_quote's header record at recs[i] and its levels after it;
+       leaves i at the last level */
+    order_queue_elem_type
+    _journal_records_to_quote(const std::vector<journal_record>& recs,
+                              size_t& i) const;
+
+    /* a group's header record at recs[i] and its orders after it; leaves i
+       at the last order */
+    order_queue_elem_type
+    _journal_records_to_group(const std::vector<journal_record>& recs,
+                              size_t& i) const;
+
+    static const std::uint32_t snapshot_version = 7;
+
+    /* plevel <-> snapshot tick index (null positions allowed) */
+    inline std::int32_t
+    _plevel_to_tick(plevel p) const
+    {
+        return (std::int32_t)(p - _beg);
+    }
+
+    plevel
+    _tick_to_plevel(std::int32_t tick, bool allow_null) const;
+
+    /* level-3 feed; only published to under _master_mtx */
+    std::shared_ptr<MBOFeed> _mbo_feed;
+
+    inline void
+    _publish_mbo(mbo_msg msg, 
+                 id_type id, 
+                 id_type ref, 
+                 size_type size, 
+                 plevel limit, 
+                 plevel stop, 
+                 bool buy, 
+                 std::uint8_t flags = 0)
+    {
+        if(_mbo_feed)
+            _publish_mbo_event(msg, id, ref, size, limit, stop, buy, flags);
+    }
+
+    void
+    _publish_mbo_event(mbo_msg msg, 
+                       id_type id, 
+                       id_type ref, 
+                       size_type size, 
+                       plevel limit, 
+                       plevel stop, 
+                       bool buy, 
+                       std::uint8_t flags);
+
+    /* clear followed by an add for every resting order */
+    void
+    _publish_mbo_image();
+
+    /* level-2 feed; only published to under _master_mtx */
+    std::shared_ptr<L2Feed> _l2_feed;
+    size_type _l2_refresh_every;
+    size_type _l2_since_refresh;
+
+    /* publish the new aggregate size of a limit level */
+    inline void
+    _publish_l2(plevel p, bool buy)
+    {
+        if(_l2_feed)
+            _publish_l2_update(p, buy);
+    }
+
+    void
+    _publish_l2_update(plevel p, bool buy);
+
+    void
+    _publish_l2_event(l2_msg msg, plevel p, size_type size, bool buy);
+
+    /* begin, every non-empty limit level, end */
+    void
+    _publish_l2_refresh();
+
+    /* per-order latency histograms; allocated on first enable, never freed */
+    std::unique_ptr<LatencyStats> _latency;
+    std::atomic_bool _latency_on;
+
+    /* time stamp if latency stats are enabled, epoch(i.e don't record) if not */
+    inline time_stamp_type
+    _latency_stamp() const
+    {
+        return _latency_on.load(std::memory_order_acquire) 
+            ? clock_type::now() 
+            : time_stamp_type();
+    }
+
+    inline void
+    _record_latency(order_type oty, 
+                    latency_stage stage, 
+                    time_stamp_type from, 
+                    time_stamp_type to)
+    {
+        if(from != time_stamp_type() && to != time_stamp_type())
+            _latency->record(oty, stage, to - from);
+    }
+
+    /* always-on counters(see enginecounters.hpp); updated from const queries */
+    mutable engine_counters _counters;
+    /* orders from triggered stops not yet routed; guarded by _master_mtx */
+    size_type _stops_pending;
+    large_size_type _stop_cascade_len;
+
+    void
+    _count_routed(const order_queue_elem_type& e, id_type id, bool ok);
+
+    /* tracepoint price arg(see tracepoints.hpp): tick index or -1 */
+    inline long
+    _trace_tick(plevel p) const
+    {
+        return (p && p >= _beg && p < _end) ? (long)(p - _beg) : -1L;
+    }
+
     /* handles the async/consumer side of the order queue */
     void 
     _threaded_order_dispatcher();
@@ -265,6 +1008,8 @@ private:
     std::unique_ptr<std::mutex> _master_mtx;
     /* sync mm access */
     std::unique_ptr<std::recursive_mutex> _mm_mtx;
+    /* agent workers the market makers run on(see set_agent_threads) */
+    std::unique_ptr<AgentRuntime> _agents;
 
     /* periodic async calls to callback with callback_msg::wake */
     std::thread _waker_thread;
@@ -309,7 +1054,8 @@ private:
                          size_type size,
                          order_exec_cb_type cb,
                          order_admin_cb_type admin_cb= nullptr,
-                         id_type id = 0);
+                         id_type id = 0,
+                         order_params_type params = order_params_type());
 
     /* push order onto the order queue, DONT block */
     void 
@@ -320,7 +1066,8 @@ private:
                         size_type size, 
                         order_exec_cb_type cb,
                         order_admin_cb_type admin_cb = nullptr,
-                        id_type id = 0);
+                        id_type id = 0,
+                        order_params_type params = order_params_type());
 
     /* generate order ids; don't worry about overflow */
     inline large_size_type 
@@ -371,6 +1118,35 @@ private:
     bool 
     _pull_order(id_type id);
 
+    /* change size/price of a resting limit; null 'limit' keeps the price */
+    id_type
+    _modify_order(id_type id, plevel limit, size_type size);
+
+    template<bool BuyLimit>
+    id_type
+    _modify_limit_order(id_type id, 
+                        plevel p, 
+                        limit_chain_type* c, 
+                        plevel limit, 
+                        size_type size);
+
+    /* take a limit out of the book quietly(no feed msg or callback) */
+    template<bool BuyLimit>
+    void
+    _unlink_limit_order(id_type id, plevel p, limit_chain_type* c);
+
+    /* put a limit taken out of the book('id') back at the back of the line 
+       at 'limit' under a new id, trading first if it crosses; fills are 
+       under 'exec_id'(0 = the new id). Returns the new id */
+    template<bool BuyLimit>
+    id_type
+    _relink_limit_order(id_type id,
+                        plevel limit,
+                        size_type size,
+                        order_exec_cb_type cb,
+                        owner_type owner,
+                        id_type exec_id = 0);
+
     /* optimize by checking limit or stop chains first */  
     inline bool 
     _pull_order(bool limits_first, id_type id)   
@@ -384,7 +1160,7 @@ private:
     inline order_exec_cb_type 
     _get_cb_from_bndl(limit_bndl_type& b)
     { 
-        return b.second; 
+        return std::get<1>(b); 
     }
 
     inline order_exec_cb_type 
@@ -393,6 +1169,30 @@ private:
         return std::get<3>(b);
     }
 
+    /* refresh the cached inside size after orders at 'p' shrink */
+    inline void
+    _refresh_inside_size(plevel p)
+    {
+        if(p == _bid)
+            _bid_size = _chain<limit_chain_type>::size(&p->first);
+        else if(p == _ask)
+            _ask_size = _chain<limit_chain_type>::size(&p->first);
+    }
+
+    /* helper for publishing the cancel of a pulled order (before erasing) */
+    inline void
+    _publish_mbo_cancel(id_type id, plevel p, limit_bndl_type& b)
+    {
+        _publish_mbo(mbo_msg::cancel, id, 0, std::get<0>(b), p, nullptr, p <= _bid);
+    }
+
+    inline void
+    _publish_mbo_cancel(id_type id, plevel p, stop_bndl_type& b)
+    {
+        _publish_mbo(mbo_msg::cancel, id, 0, std::get<2>(b), 
+                     (plevel)std::get<1>(b), p, std::get<0>(b), MBO_FLAG_STOP);
+    }
+
     /* called from _pull order to update cached pointers */
     template<bool BuyStop>
     void 
@@ -425,19 +1225,43 @@ private:
     void 
     _handle_triggered_stop_chain(plevel plev);
 
+    /* 'owner' of the incoming order if self-trades are checked(0 if not);
+       'stp_kill' is set if what's left of it has to be cancelled */
     size_type
     _hit_chain(plevel plev,
                id_type id,
                size_type size,
-               order_exec_cb_type& exec_cb);
+               order_exec_cb_type& exec_cb,
+               owner_type owner,
+               bool& stp_kill);
 
     template<bool BidSize>
     size_type 
     _trade(plevel plev, 
            id_type id, 
            size_type size,
-           order_exec_cb_type& exec_cb);
-
+           order_exec_cb_type& exec_cb,
+           owner_type owner = 0);
+
+
+    /* self-trade prevention on the resting order 'elem'(order id 'rid') at 
+       'plev'; PART OF _hit_chain, which erases it from the chain: cancel it
+       (an iceberg w/ its reserve) or take 'amount' off it and the incoming
+       order 'id'(true if that's all of it) */
+    void
+    _stp_cancel_resting(plevel plev,
+                        typename limit_chain_type::value_type& elem,
+                        id_type rid,
+                        typename iceberg_slices_type::iterator& ice);
+
+    bool
+    _stp_decrement(plevel plev,
+                   typename limit_chain_type::value_type& elem,
+                   id_type id,
+                   id_type rid,
+                   size_type amount,
+                   order_exec_cb_type& exec_cb,
+                   typename iceberg_slices_type::iterator& ice);
 
     /* signal trade has occurred(admin only, DONT INSERT NEW TRADES IN HERE!) */
     void 
@@ -456,14 +1280,124 @@ private:
                         size_type size,
                         order_exec_cb_type exec_cb, 
                         id_type id,
-                        order_admin_cb_type admin_cb = nullptr);
+                        order_admin_cb_type admin_cb = nullptr,
+                        owner_type owner = 0);
 
     template<bool BuyMarket>
     void 
     _insert_market_order(size_type size,
                          order_exec_cb_type exec_cb, 
                          id_type id,
-                         order_admin_cb_type admin_cb = nullptr);
+                         order_admin_cb_type admin_cb = nullptr,
+                         owner_type owner = 0);
+
+    template<bool BuyLimit>
+    void 
+    _insert_iceberg_order(plevel limit, 
+                          size_type size,
+                          size_type display,
+                          order_exec_cb_type exec_cb, 
+                          id_type id,
+                          order_admin_cb_type admin_cb = nullptr,
+                          owner_type owner = 0);
+
+    /* show the next slice of the iceberg whose slice 'i' just filled
+       PART OF _hit_chain; appends to the chain it's iterating */
+    void
+    _replenish_iceberg(plevel plev, 
+                       typename iceberg_slices_type::iterator i,
+                       const limit_bndl_type& bndl);
+
+    /* the id an order rests under(its iceberg slice or the id a pegged 
+       order was last repriced under, or itself) */
+    inline id_type
+    _resting_id(id_type id) const
+    {
+        if( !_iceberg_orders.empty() ){
+            auto i = _iceberg_orders.find(id);
+            if(i != _iceberg_orders.end())
+                return i->second;
+        }
+        if( !_peg_orders.empty() ){
+            auto i = _peg_orders.find(id);
+            if(i != _peg_orders.end())
+                return i->second->at(id).rid;
+        }
+        return id;
+    }
+
+    /* forget the iceberg(if any) resting as 'slice_id' */
+    inline void
+    _erase_iceberg(id_type slice_id)
+    {
+        if(_iceberg_slices.empty())
+            return;
+        auto i = _iceberg_slices.find(slice_id);
+        if(i != _iceberg_slices.end()){
+            _iceberg_orders.erase(i->second.id);
+            _iceberg_slices.erase(i);
+        }
+    }
+
+    template<bool BuyLimit>
+    void 
+    _insert_peg_order(peg_type peg,
+                      size_type offset,
+                      size_type size,
+                      order_exec_cb_type exec_cb, 
+                      id_type id,
+                      order_admin_cb_type admin_cb = nullptr,
+                      owner_type owner = 0);
+
+    /* forget the pegged order(if any) resting as 'rid' */
+    inline void
+    _erase_peg(id_type rid)
+    {
+        if(_peg_resting.empty())
+            return;
+        auto i = _peg_resting.find(rid);
+        if(i != _peg_resting.end()){
+            i->second.second->erase(i->second.first);
+            _peg_orders.erase(i->second.first);
+            _peg_resting.erase(i);
+        }
+    }
+
+    /* the best bid and ask that aren't pegged(null positions if none) */
+    void
+    _peg_references(plevel* bid, plevel* ask) const;
+
+    /* where a peg goes, given _peg_bid/_peg_ask; null if nothing to peg to */
+    template<bool BuyLimit>
+    plevel
+    _peg_price(peg_type peg, size_type offset) const;
+
+    /* reprice pegs if _peg_bid/_peg_ask moved; PART OF THE ENCLOSING 
+       CRITICAL SECTION, at the end of a routed command */
+    void
+    _reprice_pegs();
+
+    /* take the pegs in a chain that have to move out of the book */
+    template<bool BuyLimit>
+    void
+    _unlink_pegs(peg_type peg, std::vector<peg_move_type>& moves);
+
+    /* immediate-or-cancel; fill-or-kill if 'all_or_none' */
+    template<bool BuyLimit>
+    void 
+    _insert_ioc_order(plevel limit, 
+                      size_type size,
+                      order_exec_cb_type exec_cb, 
+                      id_type id,
+                      order_admin_cb_type admin_cb,
+                      bool all_or_none,
+                      owner_type owner = 0);
+
+    /* is there at least 'size' on the other side, through 'limit', that
+       'owner' can trade w/(see set_stp_policy) */
+    template<bool BuyLimit>
+    bool
+    _can_fill(plevel limit, size_type size, owner_type owner);
 
     template<bool BuyStop>
     void 
@@ -471,7 +1405,8 @@ private:
                        size_type size,
                        order_exec_cb_type exec_cb, 
                        id_type id,
-                       order_admin_cb_type admin_cb = nullptr);
+                       order_admin_cb_type admin_cb = nullptr,
+                       owner_type owner = 0);
 
     template<bool BuyStop>
     void 
@@ -480,7 +1415,154 @@ private:
                        size_type size,
                        order_exec_cb_type exec_cb, 
                        id_type id,
-                       order_admin_cb_type admin_cb = nullptr);
+                       order_admin_cb_type admin_cb = nullptr,
+                       owner_type owner = 0);
+
+    template<bool BuyStop>
+    void 
+    _insert_trailing_stop_order(size_type trail,
+                                bool stop_limit,
+                                size_type limit_offset,
+                                size_type size,
+                                order_exec_cb_type exec_cb, 
+                                id_type id,
+                                order_admin_cb_type admin_cb = nullptr,
+                                owner_type owner = 0);
+
+    /* where a trailing stop(and its limit) goes for the high/low 'mark' */
+    template<bool BuyStop>
+    plevel
+    _trailing_stop_price(plevel mark, size_type trail) const;
+
+    template<bool BuyStop>
+    plevel
+    _trailing_limit_price(plevel stop, size_type limit_offset) const;
+
+    /* move the trailing stops 'last' just printed past; PART OF THE 
+       ENCLOSING CRITICAL SECTION(from _trade_has_occured) */
+    void
+    _ratchet_trailing_stops(plevel last);
+
+    template<bool BuyStop>
+    void
+    _move_stop_order(id_type id, plevel from, plevel to, plevel limit);
+
+    /* forget the trailing stop(if any) 'id' */
+    inline void
+    _erase_trailing(id_type id)
+    {
+        if(_trailing_ids.empty())
+            return;
+        auto i = _trailing_ids.find(id);
+        if(i != _trailing_ids.end()){
+            _trailing_stops[i->second->second.buy].erase(i->second);
+            _trailing_ids.erase(i);
+        }
+    }
+
+    /* cancel_all; PART OF THE ENCLOSING CRITICAL SECTION */
+    size_type
+    _cancel_all(plevel low, plevel high, owner_type owner, std::uint8_t what);
+
+    template<bool BuyLimit>
+    size_type
+    _cancel_limits(plevel low, plevel high, owner_type owner);
+
+    template<bool BuyStop>
+    size_type
+    _cancel_stops(plevel low, plevel high, owner_type owner, std::uint8_t what);
+
+    /* after pulling/reducing limits on a side; fix up the cached extremes */
+    template<bool BuyLimit>
+    void
+    _fix_limit_extremes();
+
+    /* mass_quote; PART OF THE ENCLOSING CRITICAL SECTION */
+    size_type
+    _mass_quote(quote_bndl_type& q, order_exec_cb_type& exec_cb, owner_type session);
+
+    /* keep/reduce/pull a side of the old quote, leaving what to add in 'adds' */
+    template<bool BuyLimit>
+    void
+    _requote_limits(const quote_side_type& levels, 
+                    owner_type session, 
+                    quote_ack& ack, 
+                    quote_side_type& adds);
+
+    /* price levels -> sorted plevels; throws invalid_order */
+    void
+    _quote_levels_to_side(const quote_levels_type& levels, quote_side_type& side);
+
+    /* insert_oco_order / insert_bracket_order; PART OF THE ENCLOSING 
+       CRITICAL SECTION; returns the first order's id */
+    id_type
+    _insert_group(group_cmd_type& g, order_exec_cb_type& exec_cb, owner_type owner);
+
+    void
+    _insert_group_order(const group_leg_type& leg, 
+                        id_type id, 
+                        order_exec_cb_type& exec_cb, 
+                        owner_type owner);
+
+    /* resting 'id' traded('done' if all of it); PART OF _hit_chain */
+    void
+    _group_fill(id_type id, bool done);
+
+    /* 'id' filled or was triggered: unlink its group and cancel the rest of
+       it; from _handle_triggered_stop_chain w/ the chain(copy) it's in */
+    void
+    _fire_group(id_type id, 
+                plevel plev = nullptr, 
+                stop_chain_type* triggered = nullptr);
+
+    /* place the brackets in _brackets_filled; PART OF THE ENCLOSING 
+       CRITICAL SECTION, at the end of a routed command */
+    void
+    _place_brackets();
+
+    /* take 'id'(if it's in one) out of its group on its way out of the book;
+       a group left w/ one order is dissolved */
+    void
+    _ungroup(id_type id);
+
+    /* GTT 'id' rests at 'where'; PART OF THE ENCLOSING CRITICAL SECTION */
+    void
+    _set_expiry(id_type id, time_stamp_type expire, plevel where, bool stop);
+
+    /* forget the GTT order(if any) 'id'; returns its expiry(epoch if none) */
+    inline time_stamp_type
+    _erase_expiry(id_type id)
+    {
+        time_stamp_type expire;
+        if(_expiries.empty())
+            return expire;
+        auto i = _expiries.find(id);
+        if(i != _expiries.end()){
+            expire = i->second.expire;
+            _expiries.erase(i);
+            _prune_expiries();
+        }
+        return expire;
+    }
+
+    /* pop stale entries off the top of the heap; update _next_expiry */
+    void
+    _prune_expiries();
+
+    /* pull the GTT orders that expire at or before 'now', fixing up the 
+       cached extremes once; PART OF THE ENCLOSING CRITICAL SECTION */
+    size_type
+    _expire_orders(time_stamp_type now);
+
+    /* after pulling stops on a side; fix up the cached extremes */
+    template<bool BuyStop>
+    void
+    _fix_stop_extremes();
+
+    /* route(and journal) a sweep if a GTT order is due; from the dispatcher
+       or, in direct mode('direct'), the calling thread, before an order */
+    bool
+    _route_expiry_sweep(OrderJournal* journal, bool direct);
 
     /***************************************************
      *** RESTRICT COPY / MOVE / ASSIGN ... (for now) ***
@@ -510,6 +1592,17 @@ public:
     void 
     add_market_maker(pMarketMaker&& mms);
 
+    /* run market makers on 'nthreads' agent workers(0: in the callback path) */
+    void
+    set_agent_threads(unsigned int nthreads);
+
+    unsigned int
+    get_agent_threads();
+
+    /* block until the agents and the callbacks they generate have settled */
+    void
+    wait_for_agents();
+
     /* should be const ptr, locking mtx though */
     order_info_type 
     get_order_info(id_type id, bool search_limits_first=true);
@@ -519,20 +1612,69 @@ public:
                        price_type limit, 
                        size_type size,
                        order_exec_cb_type exec_cb,
-                       order_admin_cb_type admin_cb = nullptr);
+                       order_admin_cb_type admin_cb = nullptr,
+                       owner_type owner = 0);
 
     id_type 
     insert_market_order(bool buy, 
                         size_type size,
                         order_exec_cb_type exec_cb,
-                        order_admin_cb_type admin_cb = nullptr);
+                        order_admin_cb_type admin_cb = nullptr,
+                        owner_type owner = 0);
+
+    id_type 
+    insert_iceberg_order(bool buy, 
+                         price_type limit,
+                         size_type display,
+                         size_type size,
+                         order_exec_cb_type exec_cb,
+                         order_admin_cb_type admin_cb = nullptr,
+                         owner_type owner = 0);
+
+    /* 'offset' ticks less aggressive than what it's pegged to */
+    id_type 
+    insert_peg_order(bool buy, 
+                     peg_type peg,
+                     size_type size,
+                     order_exec_cb_type exec_cb,
+                     size_type offset = 0,
+                     order_admin_cb_type admin_cb = nullptr,
+                     owner_type owner = 0);
+
+    /* good-till-time; pulled(w/ a cancel callback) once the book's clock
+       reaches 'expire'(see set_virtual_time) */
+    id_type 
+    insert_gtt_order(bool buy, 
+                     price_type limit,
+                     size_type size,
+                     time_stamp_type expire,
+                     order_exec_cb_type exec_cb,
+                     order_admin_cb_type admin_cb = nullptr,
+                     owner_type owner = 0);
+
+    id_type 
+    insert_ioc_order(bool buy, 
+                     price_type limit,
+                     size_type size,
+                     order_exec_cb_type exec_cb,
+                     order_admin_cb_type admin_cb = nullptr,
+                     owner_type owner = 0);
+
+    id_type 
+    insert_fok_order(bool buy, 
+                     price_type limit,
+                     size_type size,
+                     order_exec_cb_type exec_cb,
+                     order_admin_cb_type admin_cb = nullptr,
+                     owner_type owner = 0);
 
     id_type 
     insert_stop_order(bool buy, 
                       price_type stop, 
                       size_type size,
                       order_exec_cb_type exec_cb,
-                      order_admin_cb_type admin_cb = nullptr);
+                      order_admin_cb_type admin_cb = nullptr,
+                      owner_type owner = 0);
 
     id_type 
     insert_stop_order(bool buy, 
@@ -540,12 +1682,85 @@ public:
                       price_type limit,
                       size_type size, 
                       order_exec_cb_type exec_cb,
-                      order_admin_cb_type admin_cb = nullptr);
+                      order_admin_cb_type admin_cb = nullptr,
+                      owner_type owner = 0);
+
+    id_type 
+    insert_gtt_stop_order(bool buy, 
+                          price_type stop, 
+                          size_type size,
+                          time_stamp_type expire,
+                          order_exec_cb_type exec_cb,
+                          order_admin_cb_type admin_cb = nullptr,
+                          owner_type owner = 0);
+
+    id_type 
+    insert_gtt_stop_order(bool buy, 
+                          price_type stop, 
+                          price_type limit,
+                          size_type size, 
+                          time_stamp_type expire,
+                          order_exec_cb_type exec_cb,
+                          order_admin_cb_type admin_cb = nullptr,
+                          owner_type owner = 0);
+
+    /* 'trail' ticks behind the last; the limit 'limit_offset' ticks past 
+       the stop(below it for a sell, above for a buy) */
+    id_type 
+    insert_trailing_stop_order(bool buy, 
+                               size_type trail, 
+                               size_type size,
+                               order_exec_cb_type exec_cb,
+                               order_admin_cb_type admin_cb = nullptr,
+                               owner_type owner = 0);
+
+    id_type 
+    insert_trailing_stop_limit_order(bool buy, 
+                                     size_type trail, 
+                                     size_type limit_offset,
+                                     size_type size,
+                                     order_exec_cb_type exec_cb,
+                                     order_admin_cb_type admin_cb = nullptr,
+                                     owner_type owner = 0);
 
     bool 
     pull_order(id_type id,
                bool search_limits_first=true);
 
+    id_type
+    modify_order(id_type id, size_type size);
+
+    id_type
+    modify_order(id_type id, price_type limit, size_type size);
+
+    size_type
+    cancel_all(const cancel_filter& filter = cancel_filter());
+
+    quote_ack
+    mass_quote(owner_type session,
+               const quote_levels_type& bids,
+               const quote_levels_type& asks,
+               order_exec_cb_type exec_cb,
+               quote_admin_cb_type admin_cb = nullptr);
+
+    /* returns the ids of 'legs', in order */
+    std::vector<id_type>
+    insert_oco_order(const order_legs_type& legs,
+                     order_exec_cb_type exec_cb,
+                     group_admin_cb_type admin_cb = nullptr,
+                     owner_type owner = 0);
+
+    /* returns the ids of the entry, take-profit and stop-loss */
+    std::vector<id_type>
+    insert_bracket_order(bool buy,
+                         price_type limit,
+                         size_type size,
+                         price_type profit,
+                         price_type loss,
+                         order_exec_cb_type exec_cb,
+                         group_admin_cb_type admin_cb = nullptr,
+                         owner_type owner = 0);
+
     /* DO WE WANT TO TRANSFER CALLBACK OBJECT TO NEW ORDER ?? */
     id_type 
     replace_with_limit_order(id_type id, 
@@ -553,14 +1768,16 @@ public:
                              price_type limit,
                              size_type size, 
                              order_exec_cb_type exec_cb,
-                             order_admin_cb_type admin_cb = nullptr);
+                             order_admin_cb_type admin_cb = nullptr,
+                             owner_type owner = 0);
 
     id_type 
     replace_with_market_order(id_type id, 
                               bool buy, 
                               size_type size,
                               order_exec_cb_type exec_cb,
-                              order_admin_cb_type admin_cb = nullptr);
+                              order_admin_cb_type admin_cb = nullptr,
+                              owner_type owner = 0);
 
     id_type 
     replace_with_stop_order(id_type id, 
@@ -568,7 +1785,8 @@ public:
                             price_type stop,
                             size_type size, 
                             order_exec_cb_type exec_cb,
-                            order_admin_cb_type admin_cb = nullptr);
+                            order_admin_cb_type admin_cb = nullptr,
+                            owner_type owner = 0);
 
     id_type 
     replace_with_stop_order(id_type id, 
@@ -577,7 +1795,8 @@ public:
                             price_type limit, 
                             size_type size,
                             order_exec_cb_type exec_cb,
-                            order_admin_cb_type admin_cb = nullptr);
+                            order_admin_cb_type admin_cb = nullptr,
+                            owner_type owner = 0);
 
     inline void 
     dump_buy_limits() const 
@@ -606,6 +1825,119 @@ public:
     void 
     dump_cached_plevels() const;
 
+    /* journal all routed orders (see orderjournal.hpp) */
+    void
+    open_journal(const std::string& path, 
+                 journal_sync sync = journal_sync::batch,
+                 size_type batch_max = 256,
+                 int sync_interval = 100);
+
+    void
+    close_journal();
+
+    /* rebuild a new (empty) book from a journal, bypassing callbacks */
+    void
+    replay_journal(const std::string& path);
+
+    /* route orders from the calling thread(single-threaded use only) */
+    void
+    set_direct_mode(bool on);
+
+    inline bool
+    in_direct_mode() const
+    {
+        return _direct;
+    }
+
+    /* stamp trades with tp instead of clock_type::now(); expires the GTT 
+       orders tp reaches */
+    void
+    set_virtual_time(time_stamp_type tp);
+
+    void
+    use_wall_clock();
+
+    /* direct mode on the virtual clock(starting at 'start'), market makers
+       seeded from 'seed' and woken by the virtual clock */
+    void
+    start_simulation(unsigned long long seed, 
+                     time_stamp_type start = time_stamp_type());
+
+    void
+    stop_simulation();
+
+    inline bool
+    in_simulation() const
+    {
+        return _sim;
+    }
+
+    /* publish level-3 events to feed(nullptr to detach) */
+    void
+    set_mbo_feed(std::shared_ptr<MBOFeed> feed);
+
+    /* publish level-2 updates to feed(nullptr to detach); 0 = no periodic refresh */
+    void
+    set_l2_feed(std::shared_ptr<L2Feed> feed, size_type refresh_every = 10000);
+
+    /* time orders through the dispatcher(see latencystats.hpp) */
+    void
+    enable_latency_stats(bool on = true);
+
+    /* nullptr if never enabled */
+    inline const LatencyStats*
+    latency_stats() const
+    {
+        return _latency.get();
+    }
+
+    void
+    reset_latency_stats();
+
+    /* lock-free; see enginecounters.hpp */
+    inline const engine_counters&
+    counters() const
+    {
+        return _counters;
+    }
+
+    inline void
+    reset_counters()
+    {
+        _counters.reset();
+    }
+
+    /* live bytes and objects by memory_component(see types.hpp) */
+    memory_usage_type
+    memory_usage() const;
+
+    /* once memory_usage() reaches 'bytes' new resting orders are rejected 
+       with allocation_error; 0 = no limit */
+    void
+    set_memory_limit(size_type bytes);
+
+    inline size_type
+    memory_limit() const
+    {
+        return _memory_limit.load();
+    }
+
+    /* what to do w/ orders that would trade against their own owner's; 
+       applies from the next order routed */
+    void
+    set_stp_policy(stp_policy policy);
+
+    stp_policy
+    get_stp_policy();
+
+    /* write the state of the book to a binary file */
+    void
+    snapshot(const std::string& path);
+
+    /* bulk-load a snapshot into a new (empty) book, without matching */
+    void
+    restore(const std::string& path);
+
     inline market_depth_type 
     bid_depth(size_type depth=8) const
     {
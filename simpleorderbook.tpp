@@ -16,6 +16,8 @@ along with this program. If not, see http://www.gnu.org/licenses.
 */
 
 #include <iterator>
+#include <cstring>
+#include <cstdio>
 
 #include "types.hpp"
 #include "simpleorderbook.hpp"
@@ -34,6 +36,8 @@ SOB_CLASS::SimpleOrderbook(my_price_type price,
     :   
         /*  ORDER OF INITIALIZATION IS IMPORTANT */
 
+        _memory_limit(0), /* none until set_memory_limit */
+
         _bid_size(0),
         _ask_size(0),
         _last_size(0), 
@@ -45,7 +49,15 @@ SOB_CLASS::SimpleOrderbook(my_price_type price,
         _total_incr(_generate_and_check_total_incr()),
 
         _base(min),
-        _book(_total_incr + 1), /*pad the beg side */
+        _book(_total_incr + 1, /*pad the beg side */
+              chain_pair_type(
+                  limit_chain_type( _counting_allocator<
+                      typename limit_chain_type::value_type
+                  >(memory_component::limit_chains) ),
+                  stop_chain_type( _counting_allocator<
+                      typename stop_chain_type::value_type
+                  >(memory_component::stop_chains) )
+              )), 
 
        /************************************************************************
        :: our ersatz iterator approach ::
@@ -75,6 +87,10 @@ SOB_CLASS::SimpleOrderbook(my_price_type price,
         /* internal trade stats */
         _total_volume(0),
         _last_id(0), 
+        _peg_bid( &(*(_beg-1)) ),
+        _peg_ask( &(*_end) ),
+        _next_expiry(0),
+        _stp(stp_policy::none),
         _t_and_s(),
         _t_and_s_max_sz(1000),
         _t_and_s_full(false),
@@ -82,18 +98,48 @@ SOB_CLASS::SimpleOrderbook(my_price_type price,
         _market_makers(),
         _mm_mtx(new std::recursive_mutex), /* smart ptr */
         
-        _deferred_callback_queue(), 
+        _deferred_callback_queue(
+            _counting_allocator<dfrd_cb_elem_type>(memory_component::callback_queue)
+        ), 
         _busy_with_callbacks(false),
 
         /* our threaded approach to order queuing/exec */
-        _order_queue(),
+        _order_queue(
+            _counting_allocator<order_queue_elem_type>(memory_component::order_queue)
+        ),
         _order_queue_mtx(new std::mutex), /* smart ptr */   
         _order_queue_cond(),
         _noutstanding_orders(0),                       
+
+        /* no journal until open_journal */
+        _journal(),
+        _journal_pending(),
+        _journal_batch_max(256),
+        _direct(false),
+        _direct_orders(
+            _counting_allocator<order_queue_elem_type>(memory_component::order_queue)
+        ),
+        _use_virtual_time(false),
+        _virtual_time(),
+        _sim(false),
+        _sim_seed(0),
+        _sim_nseeded(0),
+        _wake_interval( std::chrono::milliseconds(sleep > 0 ? sleep : 0) ),
+        _next_wake(),
+        _mbo_feed(),
+        _l2_feed(),
+        _l2_refresh_every(0),
+        _l2_since_refresh(0),
+        _latency(),
+        _latency_on(false),
+        _counters(),
+        _stops_pending(0),
+        _stop_cascade_len(0),
         _need_check_for_stops(false),
 
         _master_mtx(new std::mutex), /* smart ptr */ 
-        _master_run_flag(true)       
+        _agents(), /* run market makers in the callback path */
+        _master_run_flag(true)
     {             
         if( min.to_incr() == 0 )
             throw std::invalid_argument("(TrimmedRational) min price must be > 0");
@@ -120,12 +166,19 @@ SOB_CLASS::SimpleOrderbook(my_price_type price,
 SOB_TEMPLATE 
 SOB_CLASS::~SimpleOrderbook()
     { /*
-       *    1) _master_run_flag = false
-       *    2) join killed _waker 
-       *    3) join killed _order_dispatcher 
+       *    1) stop agent workers(they may still be submitting orders)
+       *    2) _master_run_flag = false
+       *    3) join killed _waker 
+       *    4) join killed _order_dispatcher 
        *
        *  ?? Is it an issue we set an unguarded _master_run_flag to false here ??
        */
+        try{
+            std::lock_guard<std::recursive_mutex> lock(*_mm_mtx);
+            _agents.reset();
+        }catch(...){
+        }
+
         _master_run_flag = false;
         try{ 
             if(_waker_thread.joinable())
@@ -404,11 +457,9 @@ protected:
        
         for( ; beg <= end; ++beg ){
             c = _chain<InnerChainTy>::get(beg);
-            for(auto & e : *c){
-                if(e.first == id) 
-                    return std::pair<plevel,InnerChainTy*>(beg,c);                     
-            }
-        }      
+            if(!c->empty() && c->find(id) != c->end())
+                return std::pair<plevel,InnerChainTy*>(beg,c);
+        }
   
         return std::pair<typename SOB_CLASS::plevel,InnerChainTy*>(nullptr,nullptr);
     }
@@ -432,7 +483,7 @@ struct SOB_CLASS::_chain<typename SOB_CLASS::limit_chain_type, Dummy>
     { 
         size_type sz = 0;
         for(auto & e : *c)
-            sz += e.second.first;
+            sz += T_(e.second,0);
         return sz;
     }  
   
@@ -506,14 +557,21 @@ struct SOB_CLASS::_core_exec {
     static inline bool
     find_new_best_inside(My* sob) 
     {
+        SOB_TRACE_LOCAL(long, old_tick, 
+                        sob->_trace_tick(_core_exec<Redirect>::get_inside(sob)));
+
         /* if on an empty chain 'jump' to next that isn't, reset _ask as we go */ 
         _core_exec<Redirect>::_jump_to_nonempty_chain(sob);              
 
         /* reset size; if we run out of orders reset state/cache and return */        
-        if( !_core_exec<Redirect>::_check_and_reset_size(sob) )
+        if( !_core_exec<Redirect>::_check_and_reset_size(sob) ){
+            SOB_TRACE3(level__exhausted, Redirect, old_tick, -1L);
             return false;
+        }
                 
         _core_exec<Redirect>::_adjust_limit_cache(sob);
+        SOB_TRACE3(level__exhausted, Redirect, old_tick, 
+                   sob->_trace_tick(_core_exec<Redirect>::get_inside(sob)));
         return true;
     }
 
@@ -793,6 +851,10 @@ struct SOB_CLASS::_stop_exec<false,Redirect>
  *
  *  _hit_chain : handles all the trades at a particular plevel
  *               returns what it couldn't fill
+ *
+ *  self-trade prevention is checked in _hit_chain, against the owner of each
+ *  resting order; if it cancels the incoming order _trade cancels what's
+ *  left of it and returns 0(nothing left to fill or rest)
  *               
  */
 
@@ -802,21 +864,47 @@ size_type
 SOB_CLASS::_trade( plevel plev, 
                    id_type id, 
                    size_type size,
-                   order_exec_cb_type& exec_cb )
+                   order_exec_cb_type& exec_cb,
+                   owner_type owner )
 {
+    plevel inside = nullptr;
+    large_size_type vol = _total_volume;
+    bool stp_kill = false;
+
+    if(_stp == stp_policy::none)
+        owner = 0;
+
     while(size){
         /* can we trade at this price level? */
         if( !_core_exec<BidSide>::is_executable_chain(this, plev) )
             break;   
 
         /* trade at this price level */
-        size = _hit_chain(_core_exec<BidSide>::get_inside(this), id, size, exec_cb);      
+        inside = _core_exec<BidSide>::get_inside(this);
+        size = _hit_chain(inside, id, size, exec_cb, owner, stp_kill);      
                    
         /* reset the inside price level (if we can) OR stop */  
-        if( !_core_exec<BidSide>::find_new_best_inside(this) )
+        if( !_core_exec<BidSide>::find_new_best_inside(this) || stp_kill )
             break;
     }
 
+    if(stp_kill){
+        if(size && exec_cb){
+            /*** PROTECTED BY _master_mtx ***/
+            _deferred_callback_queue.push_back( /* callback with cancel msg */ 
+                dfrd_cb_elem_type(
+                    callback_msg::cancel, 
+                    exec_cb, id, _itop(inside), size
+                ) 
+            );
+            /*** PROTECTED BY _master_mtx ***/
+        }
+        /* like a pull: if any of it traded its group(if any) fires */
+        if( !_group_ids.empty() )
+            (_total_volume != vol) ? _fire_group(id) : _ungroup(id);
+        size = 0;
+    }
+
     return size; /* what we couldn't fill */
 }
 
@@ -826,38 +914,197 @@ size_type
 SOB_CLASS::_hit_chain( plevel plev,
                        id_type id,
                        size_type size,
-                       order_exec_cb_type& exec_cb )
+                       order_exec_cb_type& exec_cb,
+                       owner_type owner,
+                       bool& stp_kill )
 {
     size_type amount;
     long long rmndr;
+    id_type rid;
  
     auto del_iter = plev->first.begin();
+    auto ice = _iceberg_slices.end();
 
-    /* check each order, FIFO, for this plevel */
+    engine_counters::incr(_counters.levels_swept);
+
+    /* check each order, FIFO, for this plevel; a replenished iceberg is 
+       appended(new slice id) and comes around again in this same loop */
     for(auto & elem : plev->first)
     {        
-        amount = std::min(size, elem.second.first);
+        amount = std::min(size, T_(elem.second,0));
+
+        /* fill icebergs and pegs under the order's id */
+        rid = elem.first;
+        if( !_iceberg_slices.empty() ){
+            ice = _iceberg_slices.find(elem.first);
+            if(ice != _iceberg_slices.end())
+                rid = ice->second.id; 
+        }
+        if( !_peg_resting.empty() ){
+            auto pg = _peg_resting.find(elem.first);
+            if(pg != _peg_resting.end())
+                rid = pg->second.first;
+        }
+
+        /* self-trade prevention: the resting order, at least, doesn't trade */
+        if(owner && T_(elem.second,2) == owner){
+            engine_counters::incr(_counters.self_trades_prevented);
+            if(_stp == stp_policy::cancel_newest){
+                stp_kill = true;
+                break;
+            }
+            if(_stp == stp_policy::decrement){
+                size -= amount;
+                if( _stp_decrement(plev, elem, id, rid, amount, exec_cb, ice) )
+                    ++del_iter;
+                if(size <= 0){
+                    stp_kill = true; /* (nothing left to cancel) */
+                    break;
+                }
+                continue;
+            }
+            _stp_cancel_resting(plev, elem, rid, ice);
+            ++del_iter;
+            if(_stp == stp_policy::cancel_both){
+                stp_kill = true;
+                break;
+            }
+            continue;
+        }
 
         /* push callbacks into queue; update state */
-        _trade_has_occured(plev, amount, id, elem.first, exec_cb, elem.second.second, true);
+        _trade_has_occured(plev, amount, id, rid, exec_cb, T_(elem.second,1), true);
+
+        _publish_mbo(mbo_msg::execute, elem.first, id, amount, plev, nullptr, 
+                     plev <= _bid);
+
+        SOB_TRACE4(fill, id, elem.first, (long)(plev - _beg), amount);
 
         /* reduce the amount left to trade */ 
         size -= amount;    
-        rmndr = elem.second.first - amount;
+        rmndr = T_(elem.second,0) - amount;
+
+        /* (before del_iter moves past us; the rest of our group can be 
+           later in this chain) */
+        if( !_group_ids.empty() )
+            _group_fill(rid, rmndr <= 0);
+
         if(rmndr > 0) 
-            elem.second.first = rmndr; /* adjust outstanding order size */
-        else                    
+            T_(elem.second,0) = rmndr; /* adjust outstanding order size */
+        else{
+            /* (before del_iter moves past us, or it could pass the new slice) */
+            if(ice != _iceberg_slices.end()){
+                _replenish_iceberg(plev, ice, elem.second);
+                ice = _iceberg_slices.end();
+            }
+            _erase_peg(elem.first);
+            _erase_expiry(elem.first);
             ++del_iter; /* indicate removal if we cleared bid */   
+        }
      
         if(size <= 0) 
             break; /* if we have nothing left to trade*/
     }
     plev->first.erase(plev->first.begin(),del_iter);  
 
+    _publish_l2(plev, plev <= _bid);
+
     return size;
 }
 
 
+SOB_TEMPLATE
+void
+SOB_CLASS::_stp_cancel_resting( plevel plev,
+                                typename limit_chain_type::value_type& elem,
+                                id_type rid,
+                                typename iceberg_slices_type::iterator& ice )
+{  /* 
+    * PART OF THE ENCLOSING CRITICAL SECTION 
+    */
+    size_type sz = T_(elem.second,0);
+
+    if(ice != _iceberg_slices.end()){
+        sz += ice->second.reserve;
+        _erase_iceberg(elem.first);
+        ice = _iceberg_slices.end();
+    }
+    _erase_peg(elem.first);
+    _erase_expiry(elem.first);
+    _ungroup(rid);
+
+    _publish_mbo_cancel(elem.first, plev, elem.second);
+
+    if(T_(elem.second,1)){
+        /*** PROTECTED BY _master_mtx ***/
+        _deferred_callback_queue.push_back( /* callback with cancel msg */ 
+            dfrd_cb_elem_type(
+                callback_msg::cancel, 
+                T_(elem.second,1), rid, _itop(plev), sz
+            ) 
+        );
+        /*** PROTECTED BY _master_mtx ***/
+    }
+}
+
+
+SOB_TEMPLATE
+bool
+SOB_CLASS::_stp_decrement( plevel plev,
+                           typename limit_chain_type::value_type& elem,
+                           id_type id,
+                           id_type rid,
+                           size_type amount,
+                           order_exec_cb_type& exec_cb,
+                           typename iceberg_slices_type::iterator& ice )
+{  /* 
+    * PART OF THE ENCLOSING CRITICAL SECTION 
+    *
+    * both get a cancel callback for 'amount'; an iceberg's slice that's
+    * used up is replenished(as if it filled)
+    */
+    bool done = (T_(elem.second,0) <= amount);
+
+    /*** PROTECTED BY _master_mtx ***/
+    if(T_(elem.second,1)){
+        _deferred_callback_queue.push_back( 
+            dfrd_cb_elem_type(
+                callback_msg::cancel, 
+                T_(elem.second,1), rid, _itop(plev), amount
+            ) 
+        );
+    }
+    if(exec_cb){
+        _deferred_callback_queue.push_back( 
+            dfrd_cb_elem_type(
+                callback_msg::cancel, 
+                exec_cb, id, _itop(plev), amount
+            ) 
+        );
+    }
+    /*** PROTECTED BY _master_mtx ***/
+
+    if(!done){
+        T_(elem.second,0) -= amount;
+        _publish_mbo(mbo_msg::modify, elem.first, 0, T_(elem.second,0), plev, 
+                     nullptr, plev <= _bid);
+        return false;
+    }
+
+    _publish_mbo_cancel(elem.first, plev, elem.second);
+
+    /* (before del_iter moves past us, or it could pass the new slice) */
+    if(ice != _iceberg_slices.end()){
+        _replenish_iceberg(plev, ice, elem.second);
+        ice = _iceberg_slices.end();
+    }
+    _erase_peg(elem.first);
+    _erase_expiry(elem.first);
+    _ungroup(rid);
+    return true;
+}
+
+
 SOB_TEMPLATE
 void 
 SOB_CLASS::_trade_has_occured( plevel plev,
@@ -892,12 +1139,17 @@ SOB_CLASS::_trade_has_occured( plevel plev,
     else if( _t_and_s.size() >= (_t_and_s_max_sz - 1) )
         _t_and_s_full = true;
 
-    _t_and_s.push_back( t_and_s_type(clock_type::now(),p,size) );
+    _t_and_s.push_back( t_and_s_type(_now(),p,size) );
 
     _last = plev;
     _total_volume += size;
     _last_size = size;
     _need_check_for_stops = true;
+
+    if( !_trailing_ids.empty() )
+        _ratchet_trailing_stops(plev);
+
+    engine_counters::incr(_counters.fills);
 }
 
 
@@ -912,23 +1164,39 @@ SOB_CLASS::_threaded_waker(int sleep)
     
     while(_master_run_flag){ 
         std::this_thread::sleep_for(std::chrono::milliseconds(sleep));
-        std::lock_guard<std::recursive_mutex> lock(*_mm_mtx);
-        /* ---(OUTER) CRITICAL SECTION --- */ 
-        for(auto & mm : _market_makers)
+        /* don't hold _mm_mtx while we sleep(see set_agent_threads) */
+        for(size_t i = 0; _master_run_flag; ++i)
         {    
+            {   /* one sleep per market maker; none past the last */
+                std::lock_guard<std::recursive_mutex> lock(*_mm_mtx);
+                if(i >= _market_makers.size())
+                    break;
+            }
             std::this_thread::sleep_for(std::chrono::milliseconds(sleep));
-            std::lock_guard<std::mutex> lock(*_master_mtx);
-            /* ---(INNER) CRITICAL SECTION --- */                
-            _deferred_callback_queue.push_back( /* callback with wake msg */    
-                dfrd_cb_elem_type(
-                    callback_msg::wake, 
-                    mm->get_callback(), 
-                    0, _itop(_last), 0
-                ) 
-            ); 
-            /* ---(INNER) CRITICAL SECTION --- */
+            std::lock_guard<std::recursive_mutex> lock(*_mm_mtx);
+            /* ---(OUTER) CRITICAL SECTION --- */ 
+            if(i >= _market_makers.size())
+                break;
+            if(_sim)
+                continue; /* the virtual clock wakes them(see _sim_wake) */
+            {
+                counted_lock_guard lock(*_master_mtx, _counters);
+                /* ---(INNER) CRITICAL SECTION --- */                
+                _deferred_callback_queue.push_back( /* callback with wake msg */    
+                    dfrd_cb_elem_type(
+                        callback_msg::wake, 
+                        _market_makers[i]->get_callback(), 
+                        0, _itop(_last), 0
+                    ) 
+                ); 
+                /* ---(INNER) CRITICAL SECTION --- */
+            }
+            /* agents may be the only ones submitting orders; nothing else 
+               would deliver the wake */
+            if(_agents)
+                _clear_callback_queue();
+            /* ---(OUTER) CRITICAL SECTION --- */ 
         }
-        /* ---(OUTER) CRITICAL SECTION --- */ 
     }
 }
 
@@ -939,42 +1207,223 @@ SOB_CLASS::_threaded_order_dispatcher()
 {    
     order_queue_elem_type e;
     std::promise<id_type> p;    
+    std::shared_ptr<OrderJournal> journal;
+    std::exception_ptr eptr;
+    time_stamp_type tdeq, texp;
+    clock_type::rep nexp;
+    std::uint64_t seq = 0;
     id_type id;    
+    bool more, sweep;
+    bool no_sweep = false;
     
     for( ; ; ){
         {
             std::unique_lock<std::mutex> lock(*_order_queue_mtx);      
-            _order_queue_cond.wait( 
-                lock, 
-                [this]{ return !this->_order_queue.empty(); }
-            );
+            /* while idle wake up for the first GTT expiry(wall clock only; 
+               set_virtual_time sweeps for the virtual one); if there was 
+               nothing we could sweep(e.g. direct mode) wait to be woken */
+            sweep = false;
+            while( _order_queue.empty() && !sweep ){
+                nexp = _next_expiry.load(std::memory_order_acquire);
+                if(!nexp || _use_virtual_time || no_sweep){
+                    no_sweep = false;
+                    _order_queue_cond.wait(lock);
+                }else{
+                    texp = time_stamp_type(clock_type::duration(nexp));
+                    if(clock_type::now() >= texp)
+                        sweep = true;
+                    else
+                        _order_queue_cond.wait_until(lock, texp);
+                }
+            }
 
-            e = std::move(_order_queue.front());
-            _order_queue.pop();
+            if(!sweep){
+                e = std::move(_order_queue.front());
+                _order_queue.pop();
  
-            if(!_master_run_flag){
-                if(_noutstanding_orders)
-                    throw std::logic_error("!_master_run_flag && _noutstanding_orders != 0");
-                break;
+                if(!_master_run_flag){
+                    if(_noutstanding_orders != (long long)_journal_pending.size())
+                        throw std::logic_error("!_master_run_flag && _noutstanding_orders != 0");
+                    break;
+                }
             }
+
+            journal = _journal;
         }         
+
+        if(sweep){
+            no_sweep = !_route_expiry_sweep(journal.get(), false);
+            if(journal && !no_sweep)
+                _commit_journal(journal.get());
+            continue;
+        }
+        no_sweep = false;
+
+        /* GTT orders due go first, in a sweep of their own */
+        if( !T_(e,10).sweep )
+            _route_expiry_sweep(journal.get(), false);
         
         p = std::move( T_(e,8) );        
         id = T_(e,6);
-        if(!id) 
+        if(!id && !T_(e,10).is_command()) 
             id = _generate_id();
+
+        tdeq = _latency_stamp();
+        _record_latency(T_(e,0), latency_stage::queue, T_(e,9), tdeq);
+
+        if(journal) /* write-ahead */
+            seq = _journal_order(journal.get(), e, id);
         
         try{
             _route_order(e,id);
+        }catch(allocation_error&){
+            /* memory limit; not reproducible from the journal alone */
+            eptr = std::current_exception();
+            if(journal)
+                journal->reject(seq);
         }catch(...){          
-            --_noutstanding_orders;
-            p.set_exception( std::current_exception() );
+            eptr = std::current_exception();
+        }
+
+        _record_latency(T_(e,0), latency_stage::route, tdeq, _latency_stamp());
+
+        if(!journal){
+            {   /* producers(e.g agent workers) incr it concurrently */
+                std::lock_guard<std::mutex> lock(*_order_queue_mtx);
+                --_noutstanding_orders;
+            }
+            eptr ? p.set_exception(eptr) : p.set_value(id);
+            eptr = nullptr;
             continue;
         }
-     
-        --_noutstanding_orders;
-        p.set_value(id);    
+
+        /* group commit: hold the promise until its batch is in the journal */
+        _journal_pending.push_back( 
+            journal_pending_elem_type(std::move(p), id, eptr) 
+        );
+        eptr = nullptr;
+
+        {
+            std::lock_guard<std::mutex> lock(*_order_queue_mtx);
+            more = !_order_queue.empty();
+        }
+
+        if(!more || _journal_pending.size() >= _journal_batch_max)
+            _commit_journal(journal.get());
     }    
+
+    if(journal && !_journal_pending.empty())
+        _commit_journal(journal.get());
+}
+
+
+SOB_TEMPLATE
+std::uint64_t
+SOB_CLASS::_journal_order(OrderJournal* journal,
+                          const order_queue_elem_type& e,
+                          id_type id)
+{
+    journal_record r = journal_record();
+    std::uint64_t seq;
+
+    r.id = id;
+    r.size = T_(e,4);
+    r.limit = T_(e,2) ? (std::int32_t)(T_(e,2) - _beg) : -1;
+    r.stop = T_(e,3) ? (std::int32_t)(T_(e,3) - _beg) : -1;
+    r.type = (std::uint8_t)T_(e,0);
+    r.buy = T_(e,1);
+    r.display = (std::uint32_t)T_(e,10).display;
+    r.owner = T_(e,10).owner;
+    r.cancel = T_(e,10).cancel;
+    r.offset = (std::uint32_t)T_(e,10).offset;
+    if(T_(e,10).peg)
+        r.flags |= (T_(e,10).peg - 1 == (int)peg_type::primary) 
+                 ? JOURNAL_FLAG_PEG_PRIMARY 
+                 : JOURNAL_FLAG_PEG_MIDPOINT;
+    if(T_(e,10).trail){
+        r.flags |= JOURNAL_FLAG_TRAILING;
+        r.offset = (std::uint32_t)T_(e,10).trail;
+        r.display = (std::uint32_t)T_(e,10).limit_offset;
+    }
+    if(T_(e,10).expire != time_stamp_type()){
+        r.flags |= JOURNAL_FLAG_EXPIRY;
+        journal_record_set_expiry(r, T_(e,10).expire, journal->time_base());
+    }
+    /* orders from triggered stops come back through the queue w/ their id */
+    if(T_(e,6) && T_(e,0) != order_type::null)
+        r.flags |= JOURNAL_FLAG_TRIGGERED;
+
+    if( T_(e,10).group ){
+        /* group: header w/ the number of orders, then a record per order */
+        const group_cmd_type& g = *T_(e,10).group;
+        r.size = g.legs.size();
+        r.flags |= JOURNAL_FLAG_GROUP | (g.bracket ? JOURNAL_FLAG_BRACKET : 0);
+        seq = journal->append(r);
+
+        for(const auto & l : g.legs){
+            r.type = (std::uint8_t)l.type;
+            r.buy = l.buy;
+            r.limit = l.limit ? (std::int32_t)(l.limit - _beg) : -1;
+            r.stop = l.stop ? (std::int32_t)(l.stop - _beg) : -1;
+            r.size = l.size;
+            journal->append(r);
+        }
+        return seq;
+    }
+
+    if( !T_(e,10).quote )
+        return journal->append(r);
+
+    /* mass_quote: header w/ the number of levels, then a record per level */
+    const quote_bndl_type& q = *T_(e,10).quote;
+    r.size = q.bids.size() + q.asks.size();
+    r.flags |= JOURNAL_FLAG_QUOTE;
+    seq = journal->append(r);
+
+    r.type = (std::uint8_t)order_type::limit;
+    for(const auto & l : q.bids){
+        r.buy = true;
+        r.limit = (std::int32_t)(l.first - _beg);
+        r.size = l.second;
+        journal->append(r);
+    }
+    for(const auto & l : q.asks){
+        r.buy = false;
+        r.limit = (std::int32_t)(l.first - _beg);
+        r.size = l.second;
+        journal->append(r);
+    }
+    return seq;
+}
+
+
+SOB_TEMPLATE
+void
+SOB_CLASS::_commit_journal(OrderJournal* journal)
+{
+    std::exception_ptr jerr;
+
+    try{
+        journal->commit();
+    }catch(...){
+        /* the orders have been routed but aren't durable; tell the callers */
+        jerr = std::current_exception();
+    }
+
+    for(auto & e : _journal_pending){
+        {
+            std::lock_guard<std::mutex> lock(*_order_queue_mtx);
+            --_noutstanding_orders;
+        }
+        if(jerr)
+            T_(e,0).set_exception(jerr);
+        else if(T_(e,2))
+            T_(e,0).set_exception(T_(e,2));
+        else
+            T_(e,0).set_value(T_(e,1));
+    }
+
+    _journal_pending.clear();
 }
 
 
@@ -982,55 +1431,213 @@ SOB_TEMPLATE
 void 
 SOB_CLASS::_route_order(order_queue_elem_type& e, id_type& id)
 {
-    std::lock_guard<std::mutex> lock(*_master_mtx); 
+    counted_lock_guard lock(*_master_mtx, _counters); 
     /* --- CRITICAL SECTION --- */
+    SOB_TRACE4(route__start, id, (int)T_(e,0), T_(e,1), T_(e,4));
     try{
+        if(_memory_limit.load(std::memory_order_relaxed))
+            _check_memory_limit(e); /* throw */
+
         switch( T_(e,0) ){            
         case order_type::limit:         
-            T_(e,1)       
-                ? _insert_limit_order<true>(T_(e,2), T_(e,4), T_(e,5), id, T_(e,7))
-                : _insert_limit_order<false>(T_(e,2), T_(e,4), T_(e,5), id, T_(e,7));
+            if( T_(e,10).peg ){
+                T_(e,1)
+                    ? _insert_peg_order<true>((peg_type)(T_(e,10).peg - 1), T_(e,10).offset,
+                                              T_(e,4), T_(e,5), id, T_(e,7), T_(e,10).owner)
+                    : _insert_peg_order<false>((peg_type)(T_(e,10).peg - 1), T_(e,10).offset,
+                                               T_(e,4), T_(e,5), id, T_(e,7), T_(e,10).owner);
+            }else if( T_(e,10).display ){
+                T_(e,1)
+                    ? _insert_iceberg_order<true>(T_(e,2), T_(e,4), T_(e,10).display,
+                                                  T_(e,5), id, T_(e,7), T_(e,10).owner)
+                    : _insert_iceberg_order<false>(T_(e,2), T_(e,4), T_(e,10).display,
+                                                   T_(e,5), id, T_(e,7), T_(e,10).owner);
+            }else{
+                T_(e,1)       
+                    ? _insert_limit_order<true>(T_(e,2), T_(e,4), T_(e,5), id, T_(e,7),
+                                                T_(e,10).owner)
+                    : _insert_limit_order<false>(T_(e,2), T_(e,4), T_(e,5), id, T_(e,7),
+                                                 T_(e,10).owner);
+                if( T_(e,10).expire != time_stamp_type() && T_(e,2)->first.count(id) )
+                    _set_expiry(id, T_(e,10).expire, T_(e,2), false);
+            }
                          
             _look_for_triggered_stops(false); /* throw */      
             break;
        
         case order_type::market:                
             T_(e,1)
-                ? _insert_market_order<true>(T_(e,4), T_(e,5), id, T_(e,7))
-                : _insert_market_order<false>(T_(e,4), T_(e,5), id, T_(e,7));                                                        
+                ? _insert_market_order<true>(T_(e,4), T_(e,5), id, T_(e,7), 
+                                             T_(e,10).owner)
+                : _insert_market_order<false>(T_(e,4), T_(e,5), id, T_(e,7),
+                                              T_(e,10).owner);
 
             _look_for_triggered_stops(false); /* throw */               
             break;
-      
-        case order_type::stop:        
+
+        case order_type::immediate_or_cancel:
+        case order_type::fill_or_kill:
             T_(e,1)
-                ? _insert_stop_order<true>(T_(e,3), T_(e,4), T_(e,5), id, T_(e,7))
-                : _insert_stop_order<false>(T_(e,3), T_(e,4), T_(e,5), id, T_(e,7));
+                ? _insert_ioc_order<true>(T_(e,2), T_(e,4), T_(e,5), id, T_(e,7),
+                                          T_(e,0) == order_type::fill_or_kill,
+                                          T_(e,10).owner)
+                : _insert_ioc_order<false>(T_(e,2), T_(e,4), T_(e,5), id, T_(e,7),
+                                           T_(e,0) == order_type::fill_or_kill,
+                                           T_(e,10).owner);
+
+            _look_for_triggered_stops(false); /* throw */
             break;
-         
+      
+        case order_type::stop:        
         case order_type::stop_limit:        
-            T_(e,1)
-                ? _insert_stop_order<true>(T_(e,3), T_(e,2), T_(e,4), T_(e,5), id, T_(e,7))
-                : _insert_stop_order<false>(T_(e,3), T_(e,2), T_(e,4), T_(e,5), id, T_(e,7));
+            if( T_(e,10).trail ){
+                T_(e,1)
+                    ? _insert_trailing_stop_order<true>(
+                          T_(e,10).trail, T_(e,0) == order_type::stop_limit, 
+                          T_(e,10).limit_offset, T_(e,4), T_(e,5), id, T_(e,7), 
+                          T_(e,10).owner)
+                    : _insert_trailing_stop_order<false>(
+                          T_(e,10).trail, T_(e,0) == order_type::stop_limit, 
+                          T_(e,10).limit_offset, T_(e,4), T_(e,5), id, T_(e,7), 
+                          T_(e,10).owner);
+            }else if( T_(e,0) == order_type::stop ){
+                T_(e,1)
+                    ? _insert_stop_order<true>(T_(e,3), T_(e,4), T_(e,5), id, T_(e,7),
+                                               T_(e,10).owner)
+                    : _insert_stop_order<false>(T_(e,3), T_(e,4), T_(e,5), id, T_(e,7),
+                                                T_(e,10).owner);
+            }else{
+                T_(e,1)
+                    ? _insert_stop_order<true>(T_(e,3), T_(e,2), T_(e,4), T_(e,5), id, 
+                                               T_(e,7), T_(e,10).owner)
+                    : _insert_stop_order<false>(T_(e,3), T_(e,2), T_(e,4), T_(e,5), id, 
+                                                T_(e,7), T_(e,10).owner);
+            }
+            if( T_(e,10).expire != time_stamp_type() && T_(e,3)->second.count(id) )
+                _set_expiry(id, T_(e,10).expire, T_(e,3), true);
             break;
          
         case order_type::null: 
             /* not the cleanest but most effective/thread-safe 
-               e[1] indicates to check limits first (not buy/sell) */
-            id = (id_type)_pull_order(T_(e,1),id);
+               e[1] indicates to check limits first (not buy/sell);
+               a size in e[4] makes it a modify(e[2] = new price, or null);
+               CANCEL_ bits in the params make it a cancel_all(e[2], e[3] = 
+               the price band); 'id' returns the number cancelled; levels in
+               the params make it a mass_quote; 'id' returns the number of
+               orders in the quote; orders in the params make it a group; 
+               'id' returns the first one's id; 'sweep' in the params makes
+               it an expiry sweep; 'id' returns the number expired */
+            if( T_(e,10).cancel ){
+                id = _cancel_all(T_(e,2), T_(e,3), T_(e,10).owner, T_(e,10).cancel);
+            }else if( T_(e,10).quote ){
+                id = _mass_quote(*T_(e,10).quote, T_(e,5), T_(e,10).owner);
+                _look_for_triggered_stops(false); /* throw */
+            }else if( T_(e,10).group ){
+                id = _insert_group(*T_(e,10).group, T_(e,5), T_(e,10).owner);
+                _look_for_triggered_stops(false); /* throw */
+            }else if( T_(e,10).sweep ){
+                id = _expire_orders(T_(e,10).expire);
+            }else if( T_(e,4) ){
+                id = _modify_order(id, T_(e,2), T_(e,4));
+                _look_for_triggered_stops(false); /* throw */
+            }else{
+                id = (id_type)_pull_order(T_(e,1),id);
+            }
             break;
         
         default: 
             throw std::runtime_error("invalid order type in order_queue");
         }
+
+        if( !_brackets_filled.empty() ){
+            _place_brackets();
+            _look_for_triggered_stops(false); /* throw */
+        }
+
+        if( !_peg_resting.empty() ){
+            _reprice_pegs();
+            if( !_brackets_filled.empty() )
+                _place_brackets(); /* filled by a peg */
+            _look_for_triggered_stops(false); /* throw */
+        }
+
+        if(_l2_feed && _l2_refresh_every && _l2_since_refresh >= _l2_refresh_every)
+            _publish_l2_refresh();
     }catch(...){                
+        if( !_brackets_filled.empty() ){
+            /* e.g. a market order that ran out of liquidity filled them */
+            try{ 
+                _place_brackets(); 
+            }catch(...){
+            }
+        }
         _look_for_triggered_stops(true); /* no throw */
+        _count_routed(e, id, false);
+        SOB_TRACE3(route__end, id, (int)T_(e,0), 0);
         throw;
     }             
+    _count_routed(e, id, true);
+    SOB_TRACE3(route__end, id, (int)T_(e,0), 1);
     /* --- CRITICAL SECTION --- */
 }
 
 
+SOB_TEMPLATE
+void 
+SOB_CLASS::_check_memory_limit(const order_queue_elem_type& e)
+{  /* 
+    * PART OF THE ENCLOSING CRITICAL SECTION 
+    */
+    if(_memory_total() < _memory_limit.load(std::memory_order_relaxed))
+        return;
+
+    if(T_(e,6) && T_(e,0) != order_type::null)
+        return; /* from a triggered stop; already accepted */
+
+    switch( T_(e,0) ){
+    case order_type::limit:
+        if( T_(e,2) && (T_(e,1) ? (T_(e,2) >= _ask) : (T_(e,2) <= _bid)) )
+            return; /* marketable(pegs rest) */
+        break;
+    case order_type::stop:
+    case order_type::stop_limit:
+        break;
+    default:
+        return;
+    }
+
+    throw allocation_error("memory limit reached; order would rest");
+}
+
+
+SOB_TEMPLATE
+void 
+SOB_CLASS::_count_routed(const order_queue_elem_type& e, id_type id, bool ok)
+{  /* 
+    * PART OF THE ENCLOSING CRITICAL SECTION 
+    *
+    * a cascade is every stop triggered from the time one is triggered until
+    * no orders from triggered stops are left to route 
+    */
+    large_size_type n;
+
+    if(T_(e,0) == order_type::null && !id && !T_(e,10).is_command())
+        ok = false; /* pull of an unknown id */
+    engine_counters::incr(ok ? _counters.accepted[(int)T_(e,0)]
+                             : _counters.rejected[(int)T_(e,0)]);
+
+    if(T_(e,6) && T_(e,0) != order_type::null && _stops_pending)
+        --_stops_pending; /* routed an order from a triggered stop */
+
+    if(!_stops_pending && _stop_cascade_len){
+        n = _stop_cascade_len;
+        _stop_cascade_len = 0;
+        engine_counters::incr(_counters.stop_cascades);
+        engine_counters::set_max(_counters.stop_cascade_max, n);
+    }
+}
+
+
 SOB_TEMPLATE
 id_type 
 SOB_CLASS::_push_order_and_wait( order_type oty, 
@@ -1040,34 +1647,139 @@ SOB_CLASS::_push_order_and_wait( order_type oty,
                                  size_type size,
                                  order_exec_cb_type cb,                                              
                                  order_admin_cb_type admin_cb,
-                                 id_type id )
+                                 id_type id,
+                                 order_params_type params )
 {
-    id_type ret_id;
+    id_type ret_id = 0;
+    std::exception_ptr eptr;
+    time_stamp_type tenq, twake, tdone;
+
+    tenq = _latency_stamp();
+
+    if(_direct){
+        SOB_TRACE4(order__enqueue, (int)oty, buy, size, 0);
+        return _route_direct(
+            order_queue_elem_type(oty, buy, limit, stop, size, cb, id, 
+                                  admin_cb, std::promise<id_type>(), tenq, params) 
+        );
+    }
+
     std::promise<id_type> p;
     std::future<id_type> f(p.get_future());    
     {
          std::lock_guard<std::mutex> lock(*_order_queue_mtx);
          _order_queue.push(
              order_queue_elem_type(oty, buy, limit, stop, size, cb, id, 
-                                   admin_cb, std::move(p)) );
+                                   admin_cb, std::move(p), tenq, params) );
          ++_noutstanding_orders;
+         engine_counters::set_max(_counters.order_queue_peak, _order_queue.size());
+         SOB_TRACE4(order__enqueue, (int)oty, buy, size, _order_queue.size());
     }    
     _order_queue_cond.notify_one();
     
     try{         
         ret_id = f.get(); /* BLOCKING (on f)*/            
     }catch(...){
-        _block_on_outstanding_orders(); /* BLOCKING (on _noutstanding_orders) */         
-        _clear_callback_queue(); 
-        throw;
+        eptr = std::current_exception();
     }
-        
-    _block_on_outstanding_orders(); /* BLOCKING (on _noutstanding_orders) */         
+
+    twake = tenq != time_stamp_type() ? clock_type::now() : tenq;
+
+    /* an agent only waits for its own order(see set_agent_threads) */
+    if( !AgentRuntime::on_worker_thread() )
+        _block_on_outstanding_orders(); /* BLOCKING (on _noutstanding_orders) */         
     _clear_callback_queue(); 
+
+    if(tenq != time_stamp_type()){
+        tdone = clock_type::now();
+        _record_latency(oty, latency_stage::callback, twake, tdone);
+        _record_latency(oty, latency_stage::total, tenq, tdone);
+    }
+
+    if(eptr)
+        std::rethrow_exception(eptr);
+
     return ret_id;
 }
 
 
+SOB_TEMPLATE
+id_type
+SOB_CLASS::_route_direct(order_queue_elem_type&& e)
+{  /*
+    * do what the dispatcher does, from this thread; then route any orders
+    * from triggered stops, in the order they were triggered, before 
+    * delivering callbacks
+    */
+    order_queue_elem_type te;
+    std::exception_ptr eptr;
+    time_stamp_type tstart, twake;
+    std::uint64_t seq = 0;
+    id_type id, tid;
+
+    if( !T_(e,10).sweep )
+        _route_expiry_sweep(_journal.get(), true);
+
+    id = T_(e,6);
+    if(!id && !T_(e,10).is_command())
+        id = _generate_id();
+
+    if(_journal)
+        seq = _journal_order(_journal.get(), e, id);
+
+    try{
+        _route_order(e,id);
+    }catch(allocation_error&){
+        eptr = std::current_exception();
+        if(_journal)
+            _journal->reject(seq);
+    }catch(...){
+        eptr = std::current_exception();
+    }
+
+    _record_latency(T_(e,0), latency_stage::route, T_(e,9), _latency_stamp());
+
+    while( !_direct_orders.empty() ){
+        te = std::move(_direct_orders.front());
+        _direct_orders.pop_front();
+        tid = T_(te,6);
+
+        if(_journal)
+            _journal_order(_journal.get(), te, tid);
+
+        tstart = _latency_stamp();
+        try{
+            _route_order(te,tid);
+        }catch(...){ 
+            /* no one to report to (the dispatcher uses a dummy promise) */ 
+        }
+        _record_latency(T_(te,0), latency_stage::route, tstart, _latency_stamp());
+    }
+
+    try{
+        if(_journal)
+            _journal->commit();
+    }catch(...){
+        if(!eptr)
+            eptr = std::current_exception();
+    }
+
+    twake = _latency_stamp();
+    _clear_callback_queue();
+
+    if(T_(e,9) != time_stamp_type()){
+        tstart = clock_type::now();
+        _record_latency(T_(e,0), latency_stage::callback, twake, tstart);
+        _record_latency(T_(e,0), latency_stage::total, T_(e,9), tstart);
+    }
+
+    if(eptr)
+        std::rethrow_exception(eptr);
+
+    return id;
+}
+
+
 SOB_TEMPLATE
 void 
 SOB_CLASS::_push_order_no_wait( order_type oty, 
@@ -1077,18 +1789,33 @@ SOB_CLASS::_push_order_no_wait( order_type oty,
                                 size_type size,
                                 order_exec_cb_type cb,                                       
                                 order_admin_cb_type admin_cb,
-                                id_type id )
+                                id_type id,
+                                order_params_type params )
 { 
+    if(_direct){ 
+        /* we're routing from the calling thread; nothing consumes the queue */
+        _direct_orders.push_back(
+            order_queue_elem_type(oty, buy, limit, stop, size, cb, id, admin_cb,
+                                  std::promise<id_type>(), _latency_stamp(),
+                                  params)
+        );
+        SOB_TRACE4(order__enqueue, (int)oty, buy, size, _direct_orders.size());
+        return;
+    }
+
     {
         std::lock_guard<std::mutex> lock(*_order_queue_mtx);
         _order_queue.push(
             order_queue_elem_type(
                 oty, buy, limit, stop, 
                 size, cb, id, admin_cb,
-/* dummy --> */ std::move(std::promise<id_type>())
+/* dummy --> */ std::move(std::promise<id_type>()),
+                _latency_stamp(), params
             ) 
         );
         ++_noutstanding_orders;
+        engine_counters::set_max(_counters.order_queue_peak, _order_queue.size());
+        SOB_TRACE4(order__enqueue, (int)oty, buy, size, _order_queue.size());
     }    
     _order_queue_cond.notify_one();
 }
@@ -1117,33 +1844,56 @@ SOB_CLASS::_clear_callback_queue()
 {
     order_exec_cb_type cb;
     std::deque<dfrd_cb_elem_type> cb_elems;  
- 
-    bool busy = false; 
-    /* use _busy_with callbacks to abort recursive calls 
-           if false, set to true(atomically) 
-           if true leave it alone and return */  
-    _busy_with_callbacks.compare_exchange_strong(busy,true);
-    if(busy) 
-        return;    
-
-    {     
-        std::lock_guard<std::mutex> lock(*_master_mtx); 
-        /* --- CRITICAL SECTION --- */    
-        std::move( _deferred_callback_queue.begin(),
-                   _deferred_callback_queue.end(), 
-                   back_inserter(cb_elems) );    
-     
-        _deferred_callback_queue.clear(); 
-        /* --- CRITICAL SECTION --- */
-    }    
+    bool busy, more;
+
+    do{
+        busy = false; 
+        /* use _busy_with callbacks to abort recursive calls 
+               if false, set to true(atomically) 
+               if true leave it alone and return */  
+        _busy_with_callbacks.compare_exchange_strong(busy,true);
+        if(busy){
+            engine_counters::incr(_counters.callback_skips);
+            return;    
+        }
 
-    for(auto & e : cb_elems){     
-        cb = T_(e,1);
-        if(cb) 
-            cb(T_(e,0), T_(e,2), T_(e,3), T_(e,4));                
-    }      
-  
-    _busy_with_callbacks.store(false);
+        {     
+            counted_lock_guard lock(*_master_mtx, _counters); 
+            /* --- CRITICAL SECTION --- */    
+            engine_counters::set_max(_counters.callback_queue_peak, 
+                                     _deferred_callback_queue.size());
+            std::move( _deferred_callback_queue.begin(),
+                       _deferred_callback_queue.end(), 
+                       back_inserter(cb_elems) );    
+         
+            _deferred_callback_queue.clear(); 
+            /* --- CRITICAL SECTION --- */
+        }    
+
+        SOB_TRACE1(callback__drain, cb_elems.size());
+
+        for(auto & e : cb_elems){     
+            cb = T_(e,1);
+            if(cb) 
+                cb(T_(e,0), T_(e,2), T_(e,3), T_(e,4));                
+        }      
+        cb_elems.clear();
+      
+        _busy_with_callbacks.store(false);
+
+        /* 
+         * an agent(see set_agent_threads) doesn't wait for the rest of the
+         * order queue; if another agent's callbacks were queued while we 
+         * were busy don't leave them for a caller that may never come
+         */
+        more = false;
+        if( AgentRuntime::on_worker_thread() ){
+            counted_lock_guard lock(*_master_mtx, _counters); 
+            /* --- CRITICAL SECTION --- */  
+            more = !_deferred_callback_queue.empty();
+            /* --- CRITICAL SECTION --- */  
+        }
+    }while(more);
 }
 
 
@@ -1192,6 +1942,8 @@ SOB_CLASS::_handle_triggered_stop_chain(plevel plev)
     */
     stop_chain_type cchain;
     order_exec_cb_type cb;
+    order_params_type params;
+    time_stamp_type expire;
     plevel limit;         
     size_type sz;
     /*
@@ -1208,6 +1960,23 @@ SOB_CLASS::_handle_triggered_stop_chain(plevel plev)
         limit = (plevel)T_(e.second,1);
         cb = T_(e.second,3);
         sz = T_(e.second,2);
+        _erase_trailing(e.first);
+        /* a GTT stop-limit's limit keeps the expiry(set if it rests) */
+        expire = _erase_expiry(e.first);
+
+        /* the rest of its group can be later in cchain */
+        if( !_group_ids.empty() )
+            _fire_group(e.first, plev, &cchain);
+
+        _publish_mbo(mbo_msg::trigger, e.first, 0, sz, limit, plev, 
+                     T_(e.second,0), MBO_FLAG_STOP);
+
+        SOB_TRACE5(stop__trigger, e.first, T_(e.second,0), _trace_tick(plev), 
+                   _trace_tick(limit), sz);
+
+        engine_counters::incr(_counters.stops_triggered);
+        ++_stops_pending;
+        ++_stop_cascade_len;
        /*
         * note we are keeping the old id
         * 
@@ -1226,11 +1995,14 @@ SOB_CLASS::_handle_triggered_stop_chain(plevel plev)
                 );  
                 /*** PROTECTED BY _master_mtx ***/          
             }
+            params = order_params_type(0, T_(e.second,4));
+            params.expire = expire;
             _push_order_no_wait(order_type::limit, T_(e.second,0), limit, 
-                                nullptr, sz, cb, nullptr, e.first);     
+                                nullptr, sz, cb, nullptr, e.first, params);     
         }else{ /* stop to market */
             _push_order_no_wait(order_type::market, T_(e.second,0), nullptr, 
-                                nullptr, sz, cb, nullptr, e.first);
+                                nullptr, sz, cb, nullptr, e.first,
+                                order_params_type(0, T_(e.second,4)));
         }
     }
 }
@@ -1243,7 +2015,8 @@ SOB_CLASS::_insert_limit_order( plevel limit,
                                 size_type size,
                                 order_exec_cb_type exec_cb,
                                 id_type id,
-                                order_admin_cb_type admin_cb )
+                                order_admin_cb_type admin_cb,
+                                owner_type owner )
 {
     size_type rmndr = size; 
 
@@ -1251,7 +2024,7 @@ SOB_CLASS::_insert_limit_order( plevel limit,
         /* If there are matching orders on the other side fill @ market
                - pass ref to callback functor, we'll copy later if necessary 
                - return what we couldn't fill @ market */
-        rmndr = _trade<!BuyLimit>(limit,id,size,exec_cb);
+        rmndr = _trade<!BuyLimit>(limit,id,size,exec_cb,owner);
     }
  
     if(rmndr > 0){
@@ -1262,11 +2035,14 @@ SOB_CLASS::_insert_limit_order( plevel limit,
         orders->insert( 
             limit_chain_type::value_type(
                 id, 
-                limit_bndl_type(rmndr, exec_cb)
+                limit_bndl_type(rmndr, exec_cb, owner)
             ) 
         );
         
         _limit_exec<BuyLimit>::adjust_state_after_insert(this, limit, orders);         
+
+        _publish_mbo(mbo_msg::add, id, 0, rmndr, limit, nullptr, BuyLimit);
+        _publish_l2(limit, BuyLimit);
     }
     
     if(admin_cb)
@@ -1275,16 +2051,244 @@ SOB_CLASS::_insert_limit_order( plevel limit,
 
 
 SOB_TEMPLATE
-template<bool BuyMarket>
+template<bool BuyLimit>
 void 
-SOB_CLASS::_insert_market_order( size_type size,
-                                 order_exec_cb_type exec_cb,
-                                 id_type id,
-                                 order_admin_cb_type admin_cb )
+SOB_CLASS::_insert_iceberg_order( plevel limit,
+                                  size_type size,
+                                  size_type display,
+                                  order_exec_cb_type exec_cb,
+                                  id_type id,
+                                  order_admin_cb_type admin_cb,
+                                  owner_type owner )
 {
-    size_type rmndr = _trade<BuyMarket>(nullptr, id, size, exec_cb);
+    size_type rmndr = size; 
 
-    if(rmndr > 0){
+    /* the whole order can take liquidity, only the slice rests */
+    if( (BuyLimit && limit >= _ask) || (!BuyLimit && limit <= _bid) )
+        rmndr = _trade<!BuyLimit>(limit,id,size,exec_cb,owner);
+
+    if(rmndr > display){
+        _iceberg_slices[id] = iceberg_bndl_type{id, display, rmndr - display};
+        _iceberg_orders[id] = id;
+        rmndr = display;
+    }
+
+    /* won't cross, we took all we could */
+    if(rmndr > 0)
+        _insert_limit_order<BuyLimit>(limit, rmndr, exec_cb, id, nullptr, owner);
+
+    if(admin_cb)
+        admin_cb(id);
+}
+
+
+SOB_TEMPLATE
+void
+SOB_CLASS::_replenish_iceberg( plevel plev, 
+                               typename iceberg_slices_type::iterator i,
+                               const limit_bndl_type& bndl )
+{  /* 
+    * PART OF THE ENCLOSING CRITICAL SECTION 
+    */
+    iceberg_bndl_type ib = i->second;
+    size_type slice;
+    id_type slice_id;
+
+    _iceberg_slices.erase(i);
+    if(!ib.reserve){
+        _iceberg_orders.erase(ib.id);
+        return;
+    }
+
+    slice = std::min(ib.display, ib.reserve);
+    ib.reserve -= slice;
+    slice_id = _generate_id(); /* back of the line */
+
+    plev->first.emplace_hint(plev->first.end(), slice_id, 
+                             limit_bndl_type(slice, T_(bndl,1), T_(bndl,2)));
+    _iceberg_slices[slice_id] = ib;
+    _iceberg_orders[ib.id] = slice_id;
+
+    _publish_mbo(mbo_msg::add, slice_id, 0, slice, plev, nullptr, plev <= _bid);
+}
+
+
+SOB_TEMPLATE
+template<bool BuyLimit>
+void 
+SOB_CLASS::_insert_peg_order( peg_type peg,
+                              size_type offset,
+                              size_type size,
+                              order_exec_cb_type exec_cb,
+                              id_type id,
+                              order_admin_cb_type admin_cb,
+                              owner_type owner )
+{
+    plevel limit;
+
+    /* (if other pegs are resting these haven't moved since the last command) */
+    _peg_references(&_peg_bid, &_peg_ask);
+
+    limit = _peg_price<BuyLimit>(peg, offset);
+    if(!limit)
+        throw invalid_order("nothing to peg to");
+
+    /* only another peg can be crossed(at the midpoint) */
+    _insert_limit_order<BuyLimit>(limit, size, exec_cb, id, nullptr, owner);
+
+    if(limit->first.count(id)){
+        peg_chain_type& pc = _peg_chains[BuyLimit][(int)peg];
+        pc[id] = peg_bndl_type{id, limit, offset};
+        _peg_resting[id] = std::make_pair(id, &pc);
+        _peg_orders[id] = &pc;
+    }
+
+    if(admin_cb)
+        admin_cb(id);
+}
+
+
+SOB_TEMPLATE
+void
+SOB_CLASS::_peg_references(plevel* bid, plevel* ask) const
+{  /* 
+    * PART OF THE ENCLOSING CRITICAL SECTION 
+    *
+    * skip levels at the inside w/ nothing but pegs; almost always none
+    */
+    auto unpegged = [this](plevel p){
+        for(const auto & e : p->first){
+            if( !_peg_resting.count(e.first) )
+                return true;
+        }
+        return false;
+    };
+
+    plevel p = _bid;
+    for( ; p >= _beg && p >= _low_buy_limit && !unpegged(p); --p)
+        {
+        }
+    *bid = (p >= _beg && p >= _low_buy_limit) ? p : (_beg - 1);
+
+    p = _ask;
+    for( ; p < _end && p <= _high_sell_limit && !unpegged(p); ++p)
+        {
+        }
+    *ask = (p < _end && p <= _high_sell_limit) ? p : _end;
+}
+
+
+SOB_TEMPLATE
+template<bool BuyLimit>
+typename SOB_CLASS::plevel
+SOB_CLASS::_peg_price(peg_type peg, size_type offset) const
+{
+    long long t;
+
+    if(peg == peg_type::primary){
+        if( BuyLimit ? (_peg_bid < _beg) : (_peg_ask >= _end) )
+            return nullptr;
+        t = BuyLimit ? (_peg_bid - _beg) - (long long)offset
+                     : (_peg_ask - _beg) + (long long)offset;
+    }else{
+        if(_peg_bid < _beg || _peg_ask >= _end)
+            return nullptr;
+        t = (_peg_bid - _beg) + (_peg_ask - _beg); /* twice the midpoint */
+        t = BuyLimit ? (t / 2) - (long long)offset
+                     : ((t + 1) / 2) + (long long)offset;
+    }
+
+    /* an offset past the end of the book rests at the end */
+    t = std::max(t, 0LL);
+    t = std::min(t, (long long)_total_incr - 1);
+    return _beg + t;
+}
+
+
+SOB_TEMPLATE
+void
+SOB_CLASS::_reprice_pegs()
+{  /* 
+    * PART OF THE ENCLOSING CRITICAL SECTION 
+    *
+    * the pegs that have to move all come out first(so none trades against
+    * a peg that's about to move) then go back in, in the order they were
+    * entered, at the back of the line at their new price
+    */
+    std::vector<peg_move_type> moves;
+    plevel bid = _peg_bid;
+    plevel ask = _peg_ask;
+    id_type rid;
+
+    _peg_references(&_peg_bid, &_peg_ask);
+    if(bid == _peg_bid && ask == _peg_ask)
+        return;
+
+    if(bid != _peg_bid)
+        _unlink_pegs<true>(peg_type::primary, moves);
+    if(ask != _peg_ask)
+        _unlink_pegs<false>(peg_type::primary, moves);
+    _unlink_pegs<true>(peg_type::midpoint, moves);
+    _unlink_pegs<false>(peg_type::midpoint, moves);
+
+    for(auto & m : moves){
+        rid = m.buy
+            ? _relink_limit_order<true>(m.rid, m.limit, T_(m.bndl,0), T_(m.bndl,1), 
+                                        T_(m.bndl,2), m.id)
+            : _relink_limit_order<false>(m.rid, m.limit, T_(m.bndl,0), T_(m.bndl,1), 
+                                         T_(m.bndl,2), m.id);
+
+        if(m.limit->first.count(rid)){
+            peg_bndl_type& pb = m.chain->at(m.id);
+            pb.rid = rid;
+            pb.limit = m.limit;
+            _peg_resting[rid] = std::make_pair(m.id, m.chain);
+        }else{
+            m.chain->erase(m.id); /* filled */
+            _peg_orders.erase(m.id);
+        }
+    }
+}
+
+
+SOB_TEMPLATE
+template<bool BuyLimit>
+void
+SOB_CLASS::_unlink_pegs(peg_type peg, std::vector<peg_move_type>& moves)
+{  /* 
+    * PART OF THE ENCLOSING CRITICAL SECTION 
+    */
+    peg_chain_type& pc = _peg_chains[BuyLimit][(int)peg];
+    plevel limit;
+
+    for(auto & e : pc){
+        limit = _peg_price<BuyLimit>(peg, e.second.offset);
+        if(!limit || limit == e.second.limit)
+            continue; /* nothing to peg to(stays put), or no change */
+
+        limit_chain_type* c = &e.second.limit->first;
+        moves.push_back( 
+            peg_move_type{e.first, e.second.rid, BuyLimit, limit, 
+                          c->at(e.second.rid), &pc} 
+        );
+        _peg_resting.erase(e.second.rid);
+        _unlink_limit_order<BuyLimit>(e.second.rid, e.second.limit, c);
+    }
+}
+
+
+SOB_TEMPLATE
+template<bool BuyMarket>
+void 
+SOB_CLASS::_insert_market_order( size_type size,
+                                 order_exec_cb_type exec_cb,
+                                 id_type id,
+                                 order_admin_cb_type admin_cb,
+                                 owner_type owner )
+{
+    size_type rmndr = _trade<!BuyMarket>(nullptr, id, size, exec_cb, owner);
+
+    if(rmndr > 0){
         std::string msg;
         msg.append("market order couldn't fill: (")
            .append( std::to_string(size-rmndr) ).append("/")
@@ -1297,6 +2301,85 @@ SOB_CLASS::_insert_market_order( size_type size,
 }
 
 
+SOB_TEMPLATE
+template<bool BuyLimit>
+void 
+SOB_CLASS::_insert_ioc_order( plevel limit,
+                              size_type size,
+                              order_exec_cb_type exec_cb,
+                              id_type id,
+                              order_admin_cb_type admin_cb,
+                              bool all_or_none,
+                              owner_type owner )
+{
+    size_type rmndr = size; 
+
+    if( ((BuyLimit && limit >= _ask) || (!BuyLimit && limit <= _bid))
+        && (!all_or_none || _can_fill<BuyLimit>(limit, size, owner)) )
+    {
+        rmndr = _trade<!BuyLimit>(limit,id,size,exec_cb,owner);
+    }
+
+    if(rmndr > 0 && exec_cb){
+        /*** PROTECTED BY _master_mtx ***/
+        _deferred_callback_queue.push_back( /* callback with cancel msg */ 
+            dfrd_cb_elem_type(
+                callback_msg::cancel, 
+                exec_cb, id, _itop(limit), rmndr
+            ) 
+        );
+        /*** PROTECTED BY _master_mtx ***/
+    }
+
+    if(admin_cb)
+        admin_cb(id);
+}
+
+
+SOB_TEMPLATE
+template<bool BuyLimit>
+bool
+SOB_CLASS::_can_fill(plevel limit, size_type size, owner_type owner)
+{  /* 
+    * PART OF THE ENCLOSING CRITICAL SECTION 
+    *
+    * walk the other side from the inside, stopping as soon as there's enough;
+    * w/ self-trade prevention on, 'owner's orders are walked in line(as 
+    * _hit_chain would) and don't count: cancel_oldest skips them, the other
+    * policies stop the incoming order at the first one
+    */
+    size_type avail = 0;
+    const int step = BuyLimit ? 1 : -1;
+    plevel p = BuyLimit ? _ask : _bid;
+
+    if(_stp == stp_policy::none)
+        owner = 0;
+
+    for( ; BuyLimit ? (p <= limit && p < _end) : (p >= limit && p >= _beg); 
+         p += step )
+    {
+        if(!owner){
+            avail += _chain<limit_chain_type>::size(&p->first);
+        }else{
+            for(const auto & elem : p->first){
+                if(T_(elem.second,2) == owner){
+                    if(_stp != stp_policy::cancel_oldest)
+                        return false;
+                    continue;
+                }
+                avail += T_(elem.second,0);
+                if(avail >= size)
+                    return true;
+            }
+        }
+        if(avail >= size)
+            return true;
+    }
+
+    return false;
+}
+
+
 SOB_TEMPLATE
 template<bool BuyStop>
 void 
@@ -1304,10 +2387,12 @@ SOB_CLASS::_insert_stop_order( plevel stop,
                                size_type size,
                                order_exec_cb_type exec_cb,
                                id_type id,
-                               order_admin_cb_type admin_cb)
+                               order_admin_cb_type admin_cb,
+                               owner_type owner )
 {
     /* use stop_limit overload; nullptr as limit */
-    _insert_stop_order<BuyStop>(stop, nullptr, size, std::move(exec_cb), id, admin_cb);
+    _insert_stop_order<BuyStop>(stop, nullptr, size, std::move(exec_cb), id, 
+                                admin_cb, owner);
 }
 
 
@@ -1319,7 +2404,8 @@ SOB_CLASS::_insert_stop_order( plevel stop,
                                size_type size,
                                order_exec_cb_type exec_cb,
                                id_type id,
-                               order_admin_cb_type admin_cb )
+                               order_admin_cb_type admin_cb,
+                               owner_type owner )
 {  
    /*  we need an actual trade @/through the stop, i.e can't assume
        it's already been triggered by where last/bid/ask is...
@@ -1332,17 +2418,141 @@ SOB_CLASS::_insert_stop_order( plevel stop,
     orders->insert( 
         stop_chain_type::value_type(
             id, 
-            stop_bndl_type(BuyStop, (void*)limit, size, exec_cb)
+            stop_bndl_type(BuyStop, (void*)limit, size, exec_cb, owner)
         ) 
     );
    
     _stop_exec<BuyStop>::adjust_state_after_insert(this, stop);
+
+    _publish_mbo(mbo_msg::add, id, 0, size, limit, stop, BuyStop, MBO_FLAG_STOP);
     
     if(admin_cb) 
         admin_cb(id);
 }
 
 
+SOB_TEMPLATE
+template<bool BuyStop>
+void 
+SOB_CLASS::_insert_trailing_stop_order( size_type trail,
+                                        bool stop_limit,
+                                        size_type limit_offset,
+                                        size_type size,
+                                        order_exec_cb_type exec_cb,
+                                        id_type id,
+                                        order_admin_cb_type admin_cb,
+                                        owner_type owner )
+{
+    plevel stop = _trailing_stop_price<BuyStop>(_last, trail);
+    plevel limit = stop_limit ? _trailing_limit_price<BuyStop>(stop, limit_offset) 
+                              : nullptr;
+
+    _insert_stop_order<BuyStop>(stop, limit, size, exec_cb, id, nullptr, owner);
+
+    _trailing_ids[id] = _trailing_stops[BuyStop].insert( 
+        std::make_pair(_last, trailing_bndl_type{id, BuyStop, stop_limit, trail, 
+                                                 limit_offset, stop}) 
+    );
+
+    if(admin_cb) 
+        admin_cb(id);
+}
+
+
+SOB_TEMPLATE
+template<bool BuyStop>
+typename SOB_CLASS::plevel
+SOB_CLASS::_trailing_stop_price(plevel mark, size_type trail) const
+{
+    /* a trail past the end of the book stops at the end */
+    long long t = (mark - _beg) + (BuyStop ? (long long)trail : -(long long)trail);
+    t = std::max(t, 0LL);
+    t = std::min(t, (long long)_total_incr - 1);
+    return _beg + t;
+}
+
+
+SOB_TEMPLATE
+template<bool BuyStop>
+typename SOB_CLASS::plevel
+SOB_CLASS::_trailing_limit_price(plevel stop, size_type limit_offset) const
+{
+    return _trailing_stop_price<BuyStop>(stop, limit_offset);
+}
+
+
+SOB_TEMPLATE
+void
+SOB_CLASS::_ratchet_trailing_stops(plevel last)
+{  /* 
+    * PART OF THE ENCLOSING CRITICAL SECTION 
+    *
+    * sells trail the high: those w/ a high below 'last' are at the front; 
+    * buys trail the low: those w/ a low above it are at the back. Moved ones
+    * go back in w/ 'last' as their mark so each loop ends at the first one
+    * that didn't have to move
+    */
+    trailing_stops_type& sells = _trailing_stops[false];
+    trailing_stops_type& buys = _trailing_stops[true];
+    plevel stop, limit;
+
+    while( !sells.empty() && sells.begin()->first < last ){
+        trailing_bndl_type tb = sells.begin()->second;
+        sells.erase(sells.begin());
+
+        stop = _trailing_stop_price<false>(last, tb.trail);
+        if(stop != tb.stop){
+            limit = tb.stop_limit ? _trailing_limit_price<false>(stop, tb.limit_offset)
+                                  : nullptr;
+            _move_stop_order<false>(tb.id, tb.stop, stop, limit);
+            tb.stop = stop;
+        }
+        _trailing_ids[tb.id] = sells.insert(std::make_pair(last, tb));
+    }
+
+    while( !buys.empty() && std::prev(buys.end())->first > last ){
+        auto i = std::prev(buys.end());
+        trailing_bndl_type tb = i->second;
+        buys.erase(i);
+
+        stop = _trailing_stop_price<true>(last, tb.trail);
+        if(stop != tb.stop){
+            limit = tb.stop_limit ? _trailing_limit_price<true>(stop, tb.limit_offset)
+                                  : nullptr;
+            _move_stop_order<true>(tb.id, tb.stop, stop, limit);
+            tb.stop = stop;
+        }
+        _trailing_ids[tb.id] = buys.insert(std::make_pair(last, tb));
+    }
+}
+
+
+SOB_TEMPLATE
+template<bool BuyStop>
+void
+SOB_CLASS::_move_stop_order(id_type id, plevel from, plevel to, plevel limit)
+{  /* 
+    * PART OF THE ENCLOSING CRITICAL SECTION 
+    *
+    * stops have no priority to lose; it keeps its id
+    */
+    stop_chain_type* c = &from->second;
+    auto iter = c->find(id);
+    stop_bndl_type bndl = iter->second;
+
+    c->erase(iter);
+    if( _stop_exec<BuyStop>::stop_chain_is_empty(this, c) )
+        _stop_exec<BuyStop>::adjust_state_after_pull(this, from);
+
+    T_(bndl,1) = (void*)limit;
+    to->second.insert( stop_chain_type::value_type(id, std::move(bndl)) );
+    _stop_exec<BuyStop>::adjust_state_after_insert(this, to);
+
+    _publish_mbo(mbo_msg::modify, id, 0, T_(to->second.at(id),2), limit, to, 
+                 BuyStop, MBO_FLAG_STOP);
+}
+
+
 SOB_TEMPLATE
 template<side_of_market Side, typename ChainTy> 
 typename SOB_CLASS::market_depth_type 
@@ -1352,7 +2562,7 @@ SOB_CLASS::_market_depth(size_type depth) const
     market_depth_type md;
     size_type d;
     
-    std::lock_guard<std::mutex> lock(*_master_mtx);
+    counted_lock_guard lock(*_master_mtx, _counters);
     /* --- CRITICAL SECTION --- */ 
     _high_low<Side>::template set_using_depth<ChainTy>(this,&h,&l,depth);    
     for( ; h >= l; --h){
@@ -1374,7 +2584,7 @@ SOB_CLASS::_total_depth() const
     plevel h,l;
     size_type tot;
     
-    std::lock_guard<std::mutex> lock(*_master_mtx);
+    counted_lock_guard lock(*_master_mtx, _counters);
     /* --- CRITICAL SECTION --- */    
     _high_low<Side>::template set_using_cached<ChainTy>(this,&h,&l);    
     tot = 0;
@@ -1398,22 +2608,26 @@ SOB_CLASS::_get_order_info(id_type id)
     ASSERT_VALID_CHAIN(FirstChainTy);
     ASSERT_VALID_CHAIN(SecondChainTy);
     
-    std::lock_guard<std::mutex> lock(*_master_mtx); 
+    counted_lock_guard lock(*_master_mtx, _counters); 
     /* --- CRITICAL SECTION --- */    
-    auto pc1 = _chain<FirstChainTy>::find(this,id);
+    /* icebergs: the resting slice */
+    id_type id1 = SAME_(FirstChainTy,limit_chain_type) ? _resting_id(id) : id;
+    id_type id2 = SAME_(SecondChainTy,limit_chain_type) ? _resting_id(id) : id;
+
+    auto pc1 = _chain<FirstChainTy>::find(this,id1);
     p = T_(pc1,0);
     fc = T_(pc1,1);
 
     if(!p || !fc){
-        auto pc2 = _chain<SecondChainTy>::find(this,id);
+        auto pc2 = _chain<SecondChainTy>::find(this,id2);
         p = T_(pc2,0);
         sc = T_(pc2,1);
         return (!p || !sc)
             ? _order_info<void>::generate() /* null version */
-            : _order_info<SecondChainTy>::generate(this, id, p, sc); 
+            : _order_info<SecondChainTy>::generate(this, id2, p, sc); 
     }
 
-    return _order_info<FirstChainTy>::generate(this, id, p, fc);         
+    return _order_info<FirstChainTy>::generate(this, id1, p, fc);         
     /* --- CRITICAL SECTION --- */ 
 }
 
@@ -1429,11 +2643,16 @@ SOB_CLASS::_pull_order(id_type id)
     order_exec_cb_type cb;
     ChainTy* c;    
     bool is_buystop;
+    bool is_buylimit;
     bool is_empty;
 
     constexpr bool IsLimit = SAME_(ChainTy,limit_chain_type);
 
-    auto cp = _chain<ChainTy>::find(this,id);
+    /* an iceberg rests as its current slice, a peg under the id it was last
+       repriced under; the callback gets the order's id */
+    id_type rid = IsLimit ? _resting_id(id) : id;
+
+    auto cp = _chain<ChainTy>::find(this,rid);
     p = T_(cp,0);
     c = T_(cp,1);
 
@@ -1441,13 +2660,25 @@ SOB_CLASS::_pull_order(id_type id)
         return false;   
 
     /* get the callback and, if stop order, its direction... before erasing */
-    auto bndl = c->at(id);
+    auto bndl = c->at(rid);
     cb = _get_cb_from_bndl(bndl); 
 
     if(!IsLimit) 
         is_buystop = T_(bndl,0); 
+    else
+        is_buylimit = (p <= _bid);
 
-    c->erase(id);
+    _publish_mbo_cancel(rid, p, bndl);
+
+    c->erase(rid);
+    if(IsLimit){
+        _erase_iceberg(rid);
+        _erase_peg(rid);
+    }else{
+        _erase_trailing(rid);
+    }
+    _erase_expiry(rid);
+    _ungroup(id);
 
     /* adjust cache vals as necessary */
     if(IsLimit && c->empty()){
@@ -1459,6 +2690,10 @@ SOB_CLASS::_pull_order(id_type id)
             ? _limit_exec<true>::adjust_state_after_pull(this, p)
             : _limit_exec<false>::adjust_state_after_pull(this, p);
 
+    }else if(IsLimit){
+
+        _refresh_inside_size(p);
+
     }else if(!IsLimit && is_buystop){
 
         is_empty = _stop_exec<true>::stop_chain_is_empty(this, (stop_chain_type*)c);
@@ -1472,6 +2707,9 @@ SOB_CLASS::_pull_order(id_type id)
             _stop_exec<false>::adjust_state_after_pull(this, p);       
 
     }
+
+    if(IsLimit)
+        _publish_l2(p, is_buylimit);
        
     /*** PROTECTED BY _master_mtx ***/    
     _deferred_callback_queue.push_back( /* callback with cancel msg */ 
@@ -1487,393 +2725,2902 @@ SOB_CLASS::_pull_order(id_type id)
 
 
 SOB_TEMPLATE
-template<bool BuyNotSell>
-void 
-SOB_CLASS::_dump_limits() const
+id_type 
+SOB_CLASS::_modify_order(id_type id, plevel limit, size_type size)
 { 
-    plevel h,l;
+    /*** CALLER MUST HOLD LOCK ON _master_mtx OR RACE CONDTION WITH CALLBACK QUEUE ***/
 
-    std::lock_guard<std::mutex> lock(*_master_mtx); 
-    /* --- CRITICAL SECTION --- */
-    
-    /* from high to low */
-    h = BuyNotSell ? _bid : _high_sell_limit;
-    l = BuyNotSell ? _low_buy_limit : _ask;
+    plevel p;
+    limit_chain_type* c;
+    time_stamp_type expire;
+    id_type id_new;
 
-    _high_low<>::range_check(this,&h,&l);
-    for( ; h >= l; --h){    
-        if( !h->first.empty() ){
-            std::cout<< _itop(h);
-            for(const limit_chain_type::value_type& e : h->first)
-                std::cout<< " <" << e.second.first << " #" << e.first << "> ";
-            std::cout<< std::endl;
-        } 
-    }
-    /* --- CRITICAL SECTION --- */
-}
+    if(_iceberg_orders.count(id) || _iceberg_slices.count(id))
+        throw invalid_order("can't modify an iceberg order");
 
-SOB_TEMPLATE
-template< bool BuyNotSell >
-void SOB_CLASS::_dump_stops() const
-{ 
-    plevel h, l, plim;
+    if( !_peg_resting.empty() && _peg_resting.count(_resting_id(id)) )
+        throw invalid_order("can't modify a pegged order");
 
-    std::lock_guard<std::mutex> lock(*_master_mtx); 
-    /* --- CRITICAL SECTION --- */
-    
-    /* from high to low */
-    h = BuyNotSell ? _high_buy_stop : _high_sell_stop;
-    l = BuyNotSell ? _low_buy_stop : _low_sell_stop;
+    if( !_group_ids.empty() && _group_ids.count(id) )
+        throw invalid_order("can't modify an order in a group");
 
-    _high_low<>::range_check(this,&h,&l);    
-    for( ; h >= l; --h){ 
-        if( !h->second.empty() ){
-            std::cout<< _itop(h);
-            for(const auto & e : h->second){
-                plim = (plevel)T_(e.second,1);
-                std::cout<< " <" << (T_(e.second,0) ? "B " : "S ")
-                                 << std::to_string( T_(e.second,2) ) << " @ "
-                                 << (plim ? std::to_string(_itop(plim)) : "MKT")
-                                 << " #" << std::to_string(e.first) << "> ";
-            }
-            std::cout<< std::endl;
-        } 
+    auto cp = _chain<limit_chain_type>::find(this,id);
+    p = T_(cp,0);
+    c = T_(cp,1);
+
+    if(!c || !p)
+        return 0;
+
+    if(!limit)
+        limit = p;
+
+    /* (see _pull_order) a resting buy must be <= the best bid */
+    id_new = (p <= _bid)
+        ? _modify_limit_order<true>(id, p, c, limit, size)
+        : _modify_limit_order<false>(id, p, c, limit, size);
+
+    /* a GTT order that moved takes its expiry w/ it(if it rests) */
+    if(id_new != id && !_expiries.empty()){
+        expire = _erase_expiry(id);
+        if(expire != time_stamp_type() && limit->first.count(id_new))
+            _set_expiry(id_new, expire, limit, false);
     }
-    /* --- CRITICAL SECTION --- */
+
+    return id_new;
 }
 
 
 SOB_TEMPLATE
-typename SOB_CLASS::plevel 
-SOB_CLASS::_ptoi(my_price_type price) const
-{  /* 
-    * the range checks in here are 1 position more restrictive to catch
-    * bad user price data passed but allow internal index conversions(_itop)
-    * 
-    * this means that internally we should not convert to a price when
-    * a pointer is past beg / at end, signaling a null value
+template<bool BuyLimit>
+id_type 
+SOB_CLASS::_modify_limit_order( id_type id,
+                                plevel p,
+                                limit_chain_type* c,
+                                plevel limit,
+                                size_type size )
+{
+    /*** CALLER MUST HOLD LOCK ON _master_mtx OR RACE CONDTION WITH CALLBACK QUEUE ***/
+
+    limit_bndl_type& bndl = c->at(id);
+    order_exec_cb_type cb;
+    owner_type owner;
+
+    if(limit == p && size <= T_(bndl,0)){
+        /* reduce in place; keeps id and priority */
+        if(size < T_(bndl,0)){
+            T_(bndl,0) = size;
+            _refresh_inside_size(p);
+            _publish_mbo(mbo_msg::modify, id, 0, size, p, nullptr, BuyLimit);
+            _publish_l2(p, BuyLimit);
+        }
+        return id;
+    }
+
+    /* to the back of the line: take it out(quietly) and route it again, 
+       w/ the same callback, under a new id */
+    cb = T_(bndl,1);
+    owner = T_(bndl,2);
+    _unlink_limit_order<BuyLimit>(id, p, c);
+
+    return _relink_limit_order<BuyLimit>(id, limit, size, cb, owner);
+}
+
+
+SOB_TEMPLATE
+template<bool BuyLimit>
+void
+SOB_CLASS::_unlink_limit_order(id_type id, plevel p, limit_chain_type* c)
+{
+    /*** CALLER MUST HOLD LOCK ON _master_mtx OR RACE CONDTION WITH CALLBACK QUEUE ***/
+
+    c->erase(id);
+
+    if(c->empty())
+        _limit_exec<BuyLimit>::adjust_state_after_pull(this, p);
+    else
+        _refresh_inside_size(p);
+    _publish_l2(p, BuyLimit);
+}
+
+
+SOB_TEMPLATE
+template<bool BuyLimit>
+id_type
+SOB_CLASS::_relink_limit_order( id_type id,
+                                plevel limit,
+                                size_type size,
+                                order_exec_cb_type cb,
+                                owner_type owner,
+                                id_type exec_id )
+{
+    /*** CALLER MUST HOLD LOCK ON _master_mtx OR RACE CONDTION WITH CALLBACK QUEUE ***/
+
+    size_type rmndr = size;
+    id_type id_new = _generate_id();
+
+    if( (BuyLimit && limit >= _ask) || (!BuyLimit && limit <= _bid) )
+        rmndr = _trade<!BuyLimit>(limit, exec_id ? exec_id : id_new, size, cb, owner);
+
+    if(rmndr > 0){
+        limit_chain_type *orders = &limit->first;
+
+        orders->insert( 
+            limit_chain_type::value_type(
+                id_new, 
+                limit_bndl_type(rmndr, cb, owner)
+            ) 
+        );
+
+        _limit_exec<BuyLimit>::adjust_state_after_insert(this, limit, orders);
+        _publish_l2(limit, BuyLimit);
+    }
+
+    /* size 0 if it filled completely */
+    _publish_mbo(mbo_msg::modify, id_new, id, rmndr, limit, nullptr, BuyLimit);
+
+    return id_new;
+}
+
+
+SOB_TEMPLATE
+size_type
+SOB_CLASS::_cancel_all(plevel low, plevel high, owner_type owner, std::uint8_t what)
+{  /* 
+    * PART OF THE ENCLOSING CRITICAL SECTION 
+    *
+    * each side/chain type only walks the levels between its cached extremes
+    * that are inside the band
+    */
+    size_type n = 0;
+
+    if(what & CANCEL_LIMITS){
+        if(what & CANCEL_BUYS)
+            n += _cancel_limits<true>(std::max(low, _low_buy_limit), 
+                                      std::min(high, _bid), owner);
+        if(what & CANCEL_SELLS)
+            n += _cancel_limits<false>(std::max(low, _ask), 
+                                       std::min(high, _high_sell_limit), owner);
+    }
+
+    if(what & (CANCEL_STOPS | CANCEL_STOP_LIMITS)){
+        if(what & CANCEL_BUYS)
+            n += _cancel_stops<true>(std::max(low, _low_buy_stop), 
+                                     std::min(high, _high_buy_stop), owner, what);
+        if(what & CANCEL_SELLS)
+            n += _cancel_stops<false>(std::max(low, _low_sell_stop), 
+                                      std::min(high, _high_sell_stop), owner, what);
+    }
+
+    return n;
+}
+
+
+SOB_TEMPLATE
+template<bool BuyLimit>
+size_type
+SOB_CLASS::_cancel_limits(plevel low, plevel high, owner_type owner)
+{  /* 
+    * PART OF THE ENCLOSING CRITICAL SECTION 
+    */
+    size_type n = 0;
+    bool hit;
+
+    for(plevel p = low; p <= high; ++p){
+        limit_chain_type& c = p->first;
+        hit = false;
+        for(auto iter = c.begin(); iter != c.end(); ){
+            if(owner && T_(iter->second,2) != owner){
+                ++iter;
+                continue;
+            }
+
+            /* an iceberg's(peg's) callback is under the order's id, not the 
+               id it rests under */
+            id_type id = iter->first;
+            if( !_iceberg_slices.empty() ){
+                auto ice = _iceberg_slices.find(id);
+                if(ice != _iceberg_slices.end())
+                    id = ice->second.id;
+                _erase_iceberg(iter->first);
+            }
+            if( !_peg_resting.empty() ){
+                auto pg = _peg_resting.find(iter->first);
+                if(pg != _peg_resting.end())
+                    id = pg->second.first;
+                _erase_peg(iter->first);
+            }
+            _erase_expiry(iter->first);
+            _ungroup(iter->first);
+
+            _publish_mbo_cancel(iter->first, p, iter->second);
+
+            /*** PROTECTED BY _master_mtx ***/
+            _deferred_callback_queue.push_back( 
+                dfrd_cb_elem_type(
+                    callback_msg::cancel, 
+                    T_(iter->second,1), id, 0, 0
+                ) 
+            );
+            /*** PROTECTED BY _master_mtx ***/
+
+            iter = c.erase(iter);
+            hit = true;
+            ++n;
+        }
+        if(hit)
+            _publish_l2(p, BuyLimit);
+    }
+
+    if(n)
+        _fix_limit_extremes<BuyLimit>();
+
+    return n;
+}
+
+
+SOB_TEMPLATE
+template<bool BuyLimit>
+void
+SOB_CLASS::_fix_limit_extremes()
+{  /* 
+    * PART OF THE ENCLOSING CRITICAL SECTION 
+    *
+    * once, after pulling/reducing orders: the inside(and its size) then the
+    * far end, skipping the levels that were emptied
+    */
+    if(BuyLimit){
+        if(_bid >= _beg && _bid->first.empty())
+            _core_exec<true>::find_new_best_inside(this);
+        else
+            _refresh_inside_size(_bid);
+
+        if(_bid < _beg){
+            _low_buy_limit = _end;
+        }else{
+            for( ; _low_buy_limit < _bid && _low_buy_limit->first.empty(); 
+                 ++_low_buy_limit)
+                {
+                }
+        }
+    }else{
+        if(_ask < _end && _ask->first.empty())
+            _core_exec<false>::find_new_best_inside(this);
+        else
+            _refresh_inside_size(_ask);
+
+        if(_ask >= _end){
+            _high_sell_limit = _beg - 1;
+        }else{
+            for( ; _high_sell_limit > _ask && _high_sell_limit->first.empty(); 
+                 --_high_sell_limit)
+                {
+                }
+        }
+    }
+}
+
+
+SOB_TEMPLATE
+template<bool BuyStop>
+size_type
+SOB_CLASS::_cancel_stops(plevel low, plevel high, owner_type owner, std::uint8_t what)
+{  /* 
+    * PART OF THE ENCLOSING CRITICAL SECTION 
+    */
+    size_type n = 0;
+
+    for(plevel p = low; p <= high; ++p){
+        stop_chain_type& c = p->second;
+        for(auto iter = c.begin(); iter != c.end(); ){
+            const stop_bndl_type& b = iter->second;
+            if( T_(b,0) != BuyStop
+                || !(T_(b,1) ? (what & CANCEL_STOP_LIMITS) : (what & CANCEL_STOPS))
+                || (owner && T_(b,4) != owner) )
+            {
+                ++iter;
+                continue;
+            }
+
+            _publish_mbo_cancel(iter->first, p, iter->second);
+
+            /*** PROTECTED BY _master_mtx ***/
+            _deferred_callback_queue.push_back( 
+                dfrd_cb_elem_type(
+                    callback_msg::cancel, 
+                    T_(b,3), iter->first, 0, 0
+                ) 
+            );
+            /*** PROTECTED BY _master_mtx ***/
+
+            _erase_trailing(iter->first);
+            _erase_expiry(iter->first);
+            _ungroup(iter->first);
+            iter = c.erase(iter);
+            ++n;
+        }
+    }
+
+    if(n)
+        _fix_stop_extremes<BuyStop>();
+
+    return n;
+}
+
+
+SOB_TEMPLATE
+template<bool BuyStop>
+void
+SOB_CLASS::_fix_stop_extremes()
+{  /* 
+    * PART OF THE ENCLOSING CRITICAL SECTION 
+    *
+    * once, after pulling stops: both ends, skipping levels w/o stops on this
+    * side(the chains are shared by buy and sell stops)
+    */
+    plevel& lo = BuyStop ? _low_buy_stop : _low_sell_stop;
+    plevel& hi = BuyStop ? _high_buy_stop : _high_sell_stop;
+
+    for( ; lo <= hi && _stop_exec<BuyStop>::stop_chain_is_empty(this, &lo->second); ++lo)
+        {
+        }
+    for( ; hi >= lo && _stop_exec<BuyStop>::stop_chain_is_empty(this, &hi->second); --hi)
+        {
+        }
+    if(lo > hi){
+        lo = _end;
+        hi = _beg - 1;
+    }
+}
+
+
+SOB_TEMPLATE
+size_type
+SOB_CLASS::_mass_quote(quote_bndl_type& q, 
+                       order_exec_cb_type& exec_cb, 
+                       owner_type session)
+{  /* 
+    * PART OF THE ENCLOSING CRITICAL SECTION 
+    *
+    * both sides of the old quote are pulled/reduced before anything is 
+    * inserted so the new quote never trades against the old one(and it 
+    * isn't crossed so it can't trade against itself)
+    */
+    quote_side_type bid_adds, ask_adds;
+    id_type id;
+
+    _requote_limits<true>(q.bids, session, q.ack, bid_adds);
+    _requote_limits<false>(q.asks, session, q.ack, ask_adds);
+
+    for(const auto & l : bid_adds){
+        id = _generate_id();
+        _insert_limit_order<true>(l.first, l.second, exec_cb, id, nullptr, session);
+        q.ack.orders.push_back( quote_order_type(id, true, _itop(l.first), l.second) );
+        ++q.ack.inserted;
+    }
+    for(const auto & l : ask_adds){
+        id = _generate_id();
+        _insert_limit_order<false>(l.first, l.second, exec_cb, id, nullptr, session);
+        q.ack.orders.push_back( quote_order_type(id, false, _itop(l.first), l.second) );
+        ++q.ack.inserted;
+    }
+
+    /* callbacks are deferred; the ack gets there first */
+    if(q.admin_cb)
+        q.admin_cb(q.ack);
+
+    return q.ack.orders.size();
+}
+
+
+SOB_TEMPLATE
+template<bool BuyLimit>
+void
+SOB_CLASS::_requote_limits(const quote_side_type& levels, 
+                           owner_type session,
+                           quote_ack& ack,
+                           quote_side_type& adds)
+{  /* 
+    * PART OF THE ENCLOSING CRITICAL SECTION 
+    *
+    * one walk of the side between its cached extremes, merged w/ the 
+    * (sorted) levels: at each level the session's orders, in line, are kept
+    * until they add up to the new size, the one that goes over is cut down 
+    * in place and the rest are pulled; what's left of the new size is added
+    */
+    plevel low = BuyLimit ? _low_buy_limit : _ask;
+    plevel high = BuyLimit ? _bid : _high_sell_limit;
+    auto lev = levels.cbegin();
+    size_type want;
+    bool hit, fix = false;
+
+    for(plevel p = low; p <= high; ++p){
+        for( ; lev != levels.cend() && lev->first < p; ++lev)
+            adds.push_back(*lev); /* nothing of ours below p */
+
+        want = (lev != levels.cend() && lev->first == p) ? lev->second : 0;
+        limit_chain_type& c = p->first;
+        hit = false;
+
+        for(auto iter = c.begin(); iter != c.end(); ){
+            limit_bndl_type& b = iter->second;
+            if( T_(b,2) != session 
+                || (!_iceberg_slices.empty() && _iceberg_slices.count(iter->first)) 
+                || (!_peg_resting.empty() && _peg_resting.count(iter->first))
+                || (!_group_ids.empty() && _group_ids.count(iter->first)) )
+            {
+                ++iter;
+                continue;
+            }
+
+            if(!want){
+                _publish_mbo_cancel(iter->first, p, b);
+                /*** PROTECTED BY _master_mtx ***/
+                _deferred_callback_queue.push_back( 
+                    dfrd_cb_elem_type(
+                        callback_msg::cancel, 
+                        T_(b,1), iter->first, 0, 0
+                    ) 
+                );
+                /*** PROTECTED BY _master_mtx ***/
+                _erase_expiry(iter->first);
+                iter = c.erase(iter);
+                ++ack.cancelled;
+                hit = true;
+                continue;
+            }
+
+            if(T_(b,0) > want){
+                T_(b,0) = want;
+                _publish_mbo(mbo_msg::modify, iter->first, 0, want, p, nullptr, 
+                             BuyLimit);
+                ++ack.reduced;
+                hit = true;
+            }else{
+                ++ack.kept;
+            }
+            want -= T_(b,0);
+            ack.orders.push_back( 
+                quote_order_type(iter->first, BuyLimit, _itop(p), T_(b,0)) 
+            );
+            ++iter;
+        }
+
+        if(want)
+            adds.push_back( std::make_pair(p, want) );
+        if(lev != levels.cend() && lev->first == p)
+            ++lev;
+        if(hit){
+            _publish_l2(p, BuyLimit);
+            fix = true;
+        }
+    }
+
+    for( ; lev != levels.cend(); ++lev)
+        adds.push_back(*lev);
+
+    if(fix)
+        _fix_limit_extremes<BuyLimit>();
+}
+
+
+SOB_TEMPLATE
+id_type
+SOB_CLASS::_insert_group(group_cmd_type& g, 
+                         order_exec_cb_type& exec_cb, 
+                         owner_type owner)
+{  /* 
+    * PART OF THE ENCLOSING CRITICAL SECTION 
+    *
+    * the orders are linked before they're inserted, so one that trades as
+    * it goes in cancels those before it(and those after it, not inserted 
+    * yet, just get their cancel callback); a bracket links and inserts its
+    * entry, the ids of what it places are handed out now
+    */
+    group_bndl_type grp = group_bndl_type();
+    large_size_type vol;
+    size_t n;
+
+    for(size_t i = 0; i < g.legs.size(); ++i)
+        g.ids.push_back( _generate_id() );
+
+    grp.exec_cb = exec_cb;
+    grp.owner = owner;
+    if(g.bracket){
+        grp.orders.push_back( std::make_pair(g.ids[0], false) );
+        grp.buy = g.legs[0].buy;
+        grp.size = g.legs[0].size;
+        grp.profit = g.legs[1].limit;
+        grp.loss = g.legs[2].stop;
+        grp.profit_id = g.ids[1];
+        grp.loss_id = g.ids[2];
+        n = 1;
+    }else{
+        for(size_t i = 0; i < g.legs.size(); ++i){
+            grp.orders.push_back( 
+                std::make_pair(g.ids[i], g.legs[i].type != order_type::limit) 
+            );
+        }
+        n = g.legs.size();
+    }
+
+    for(const auto & o : grp.orders)
+        _group_ids[o.first] = g.ids[0];
+    _groups[g.ids[0]] = std::move(grp);
+
+    /* callbacks are deferred; the ids get there first */
+    if(g.admin_cb)
+        g.admin_cb(g.ids);
+
+    for(size_t i = 0; i < n; ++i){
+        vol = _total_volume;
+        _insert_group_order(g.legs[i], g.ids[i], exec_cb, owner);
+        if(_total_volume == vol)
+            continue;
+        /* it traded going in */
+        if(g.bracket){
+            if( !g.legs[0].limit->first.count(g.ids[0]) )
+                _group_fill(g.ids[0], true);
+        }else{
+            _fire_group(g.ids[i]);
+            break;
+        }
+    }
+
+    return g.ids[0];
+}
+
+
+SOB_TEMPLATE
+void
+SOB_CLASS::_insert_group_order(const group_leg_type& leg, 
+                               id_type id,
+                               order_exec_cb_type& exec_cb, 
+                               owner_type owner)
+{
+    switch(leg.type){
+    case order_type::limit:
+        leg.buy 
+            ? _insert_limit_order<true>(leg.limit, leg.size, exec_cb, id, nullptr, owner)
+            : _insert_limit_order<false>(leg.limit, leg.size, exec_cb, id, nullptr, owner);
+        break;
+    case order_type::stop:
+        leg.buy 
+            ? _insert_stop_order<true>(leg.stop, leg.size, exec_cb, id, nullptr, owner)
+            : _insert_stop_order<false>(leg.stop, leg.size, exec_cb, id, nullptr, owner);
+        break;
+    case order_type::stop_limit:
+        leg.buy 
+            ? _insert_stop_order<true>(leg.stop, leg.limit, leg.size, exec_cb, id, 
+                                       nullptr, owner)
+            : _insert_stop_order<false>(leg.stop, leg.limit, leg.size, exec_cb, id, 
+                                        nullptr, owner);
+        break;
+    default:
+        throw std::runtime_error("invalid order type in group");
+    }
+}
+
+
+SOB_TEMPLATE
+void
+SOB_CLASS::_group_fill(id_type id, bool done)
+{  /* 
+    * PART OF THE ENCLOSING CRITICAL SECTION 
+    *
+    * any fill fires an OCO group; a bracket waits for all of its entry 
+    */
+    auto gi = _group_ids.find(id);
+    if(gi == _group_ids.end())
+        return;
+
+    auto g = _groups.find(gi->second);
+    if( !g->second.profit_id ){
+        _fire_group(id);
+        return;
+    }
+
+    if(done){
+        _brackets_filled.push_back( std::move(g->second) );
+        _groups.erase(g);
+        _group_ids.erase(gi);
+    }
+}
+
+
+SOB_TEMPLATE
+void
+SOB_CLASS::_fire_group(id_type id, plevel plev, stop_chain_type* triggered)
+{  /* 
+    * PART OF THE ENCLOSING CRITICAL SECTION 
+    *
+    * the group is unlinked first so the pulls don't come back to it. An
+    * order that can't be pulled is either in 'triggered'(the copy of the
+    * chain being triggered; erasing from it, or from the chain _hit_chain 
+    * is sweeping, doesn't touch the element being iterated) or wasn't 
+    * inserted yet(see _insert_group); either way it gets its cancel callback
+    */
+    auto gi = _group_ids.find(id);
+    if(gi == _group_ids.end())
+        return;
+
+    auto g = _groups.find(gi->second);
+    group_bndl_type grp = std::move(g->second);
+    _groups.erase(g);
+    for(const auto & o : grp.orders)
+        _group_ids.erase(o.first);
+
+    for(const auto & o : grp.orders){
+        if(o.first == id)
+            continue;
+
+        if( o.second ? _pull_order<stop_chain_type>(o.first) 
+                     : _pull_order<limit_chain_type>(o.first) )
+        {
+            continue;
+        }
+
+        if(triggered){
+            auto s = triggered->find(o.first);
+            if(s != triggered->end()){
+                _publish_mbo_cancel(s->first, plev, s->second);
+                triggered->erase(s);
+            }
+        }
+
+        /*** PROTECTED BY _master_mtx ***/
+        _deferred_callback_queue.push_back( 
+            dfrd_cb_elem_type(
+                callback_msg::cancel, 
+                grp.exec_cb, o.first, 0, 0
+            ) 
+        );
+        /*** PROTECTED BY _master_mtx ***/
+    }
+}
+
+
+SOB_TEMPLATE
+void
+SOB_CLASS::_place_brackets()
+{  /* 
+    * PART OF THE ENCLOSING CRITICAL SECTION 
+    *
+    * link the take-profit and stop-loss as an OCO group and insert them, 
+    * the stop first so a take-profit that trades going in cancels it; that
+    * can fill another entry so keep going until there are none
+    */
+    std::vector<group_bndl_type> filled;
+    large_size_type vol;
+
+    while( !_brackets_filled.empty() ){
+        filled.clear();
+        filled.swap(_brackets_filled);
+
+        for(const auto & b : filled){
+            group_bndl_type oco = group_bndl_type();
+            oco.orders.push_back( std::make_pair(b.profit_id, false) );
+            oco.orders.push_back( std::make_pair(b.loss_id, true) );
+            oco.exec_cb = b.exec_cb;
+            oco.owner = b.owner;
+            _group_ids[b.profit_id] = b.profit_id;
+            _group_ids[b.loss_id] = b.profit_id;
+            _groups[b.profit_id] = std::move(oco);
+
+            b.buy 
+                ? _insert_stop_order<false>(b.loss, b.size, b.exec_cb, b.loss_id, 
+                                            nullptr, b.owner)
+                : _insert_stop_order<true>(b.loss, b.size, b.exec_cb, b.loss_id, 
+                                           nullptr, b.owner);
+
+            vol = _total_volume;
+            b.buy
+                ? _insert_limit_order<false>(b.profit, b.size, b.exec_cb, b.profit_id, 
+                                             nullptr, b.owner)
+                : _insert_limit_order<true>(b.profit, b.size, b.exec_cb, b.profit_id, 
+                                            nullptr, b.owner);
+            if(_total_volume != vol)
+                _fire_group(b.profit_id);
+        }
+    }
+}
+
+
+SOB_TEMPLATE
+void
+SOB_CLASS::_ungroup(id_type id)
+{  /* 
+    * PART OF THE ENCLOSING CRITICAL SECTION 
+    */
+    if(_group_ids.empty())
+        return;
+
+    auto gi = _group_ids.find(id);
+    if(gi == _group_ids.end())
+        return;
+
+    auto g = _groups.find(gi->second);
+    _group_ids.erase(gi);
+
+    auto& orders = g->second.orders;
+    orders.erase( 
+        std::find_if(orders.begin(), orders.end(),
+                     [=](const std::pair<id_type,bool>& o){ return o.first == id; })
+    );
+
+    if(orders.size() < 2){
+        for(const auto & o : orders)
+            _group_ids.erase(o.first);
+        _groups.erase(g);
+    }
+}
+
+
+SOB_TEMPLATE
+void
+SOB_CLASS::_set_expiry(id_type id, time_stamp_type expire, plevel where, bool stop)
+{  /* 
+    * PART OF THE ENCLOSING CRITICAL SECTION 
+    */
+    _expiries[id] = expiry_bndl_type{expire, where, stop};
+    _expiry_heap.push( expiry_elem_type(expire, id) );
+    _next_expiry.store(_expiry_heap.top().first.time_since_epoch().count(),
+                       std::memory_order_release);
+}
+
+
+SOB_TEMPLATE
+void
+SOB_CLASS::_prune_expiries()
+{  /* 
+    * PART OF THE ENCLOSING CRITICAL SECTION 
+    *
+    * keeps the top current so the dispatcher doesn't wake up for nothing
+    */
+    while( !_expiry_heap.empty() ){
+        const expiry_elem_type& t = _expiry_heap.top();
+        auto x = _expiries.find(t.second);
+        if(x != _expiries.end() && x->second.expire == t.first)
+            break;
+        _expiry_heap.pop();
+    }
+
+    _next_expiry.store( _expiry_heap.empty() 
+                            ? 0 
+                            : _expiry_heap.top().first.time_since_epoch().count(),
+                        std::memory_order_release );
+}
+
+
+SOB_TEMPLATE
+size_type
+SOB_CLASS::_expire_orders(time_stamp_type now)
+{  /* 
+    * PART OF THE ENCLOSING CRITICAL SECTION 
+    *
+    * pop everything due off the heap and pull it where it rests(no search),
+    * then fix up the cached extremes of the sides touched once(like 
+    * _cancel_all). Until then _bid still separates the sides: it can only 
+    * be left on a level that was emptied
+    */
+    bool fix_limits[2] = {false, false};
+    bool fix_stops[2] = {false, false};
+    size_type n = 0;
+    expiry_elem_type t;
+    plevel p;
+    bool buy, stop;
+
+    while( !_expiry_heap.empty() && _expiry_heap.top().first <= now ){
+        t = _expiry_heap.top();
+        _expiry_heap.pop();
+
+        auto x = _expiries.find(t.second);
+        if(x == _expiries.end() || x->second.expire != t.first)
+            continue; /* stale */
+
+        p = x->second.where;
+        stop = x->second.stop;
+        _expiries.erase(x);
+
+        if(stop){
+            auto o = p->second.find(t.second);
+            if(o == p->second.end())
+                continue;
+            buy = T_(o->second,0);
+            _publish_mbo_cancel(o->first, p, o->second);
+            /*** PROTECTED BY _master_mtx ***/
+            _deferred_callback_queue.push_back( 
+                dfrd_cb_elem_type(
+                    callback_msg::cancel, 
+                    T_(o->second,3), o->first, 0, 0
+                ) 
+            );
+            /*** PROTECTED BY _master_mtx ***/
+            p->second.erase(o);
+            fix_stops[buy] = true;
+        }else{
+            auto o = p->first.find(t.second);
+            if(o == p->first.end())
+                continue;
+            buy = (p <= _bid);
+            _publish_mbo_cancel(o->first, p, o->second);
+            /*** PROTECTED BY _master_mtx ***/
+            _deferred_callback_queue.push_back( 
+                dfrd_cb_elem_type(
+                    callback_msg::cancel, 
+                    T_(o->second,1), o->first, 0, 0
+                ) 
+            );
+            /*** PROTECTED BY _master_mtx ***/
+            p->first.erase(o);
+            _publish_l2(p, buy);
+            fix_limits[buy] = true;
+        }
+        _ungroup(t.second);
+        ++n;
+    }
+
+    if(fix_limits[1])
+        _fix_limit_extremes<true>();
+    if(fix_limits[0])
+        _fix_limit_extremes<false>();
+    if(fix_stops[1])
+        _fix_stop_extremes<true>();
+    if(fix_stops[0])
+        _fix_stop_extremes<false>();
+
+    _prune_expiries();
+    return n;
+}
+
+
+SOB_TEMPLATE
+bool
+SOB_CLASS::_route_expiry_sweep(OrderJournal* journal, bool direct)
+{  /*
+    * the sweep is journaled and routed like any other command, w/ the time 
+    * it sweeps up to, so a replay expires the same orders at the same point
+    */
+    order_params_type params;
+    order_queue_elem_type e;
+    id_type n = 0;
+
+    if( !_next_expiry.load(std::memory_order_acquire) )
+        return false;
+
+    {
+        counted_lock_guard lock(*_master_mtx, _counters);
+        /* --- CRITICAL SECTION --- */
+        params.expire = _now();
+        if(_direct != direct || _expiry_heap.empty() 
+           || _expiry_heap.top().first > params.expire)
+        {
+            return false;
+        }
+        /* --- CRITICAL SECTION --- */
+    }
+
+    params.sweep = true;
+    e = order_queue_elem_type(order_type::null, false, nullptr, nullptr, 0, 
+                              nullptr, 0, nullptr, std::promise<id_type>(), 
+                              time_stamp_type(), params);
+    if(journal)
+        _journal_order(journal, e, 0);
+
+    try{
+        _route_order(e, n);
+    }catch(...){
+    }
+
+    return true;
+}
+
+
+SOB_TEMPLATE
+template<bool BuyNotSell>
+void 
+SOB_CLASS::_dump_limits() const
+{ 
+    plevel h,l;
+
+    counted_lock_guard lock(*_master_mtx, _counters); 
+    /* --- CRITICAL SECTION --- */
+    
+    /* from high to low */
+    h = BuyNotSell ? _bid : _high_sell_limit;
+    l = BuyNotSell ? _low_buy_limit : _ask;
+
+    _high_low<>::range_check(this,&h,&l);
+    for( ; h >= l; --h){    
+        if( !h->first.empty() ){
+            std::cout<< _itop(h);
+            for(const limit_chain_type::value_type& e : h->first)
+                std::cout<< " <" << T_(e.second,0) << " #" << e.first << "> ";
+            std::cout<< std::endl;
+        } 
+    }
+    /* --- CRITICAL SECTION --- */
+}
+
+SOB_TEMPLATE
+template< bool BuyNotSell >
+void SOB_CLASS::_dump_stops() const
+{ 
+    plevel h, l, plim;
+
+    counted_lock_guard lock(*_master_mtx, _counters); 
+    /* --- CRITICAL SECTION --- */
+    
+    /* from high to low */
+    h = BuyNotSell ? _high_buy_stop : _high_sell_stop;
+    l = BuyNotSell ? _low_buy_stop : _low_sell_stop;
+
+    _high_low<>::range_check(this,&h,&l);    
+    for( ; h >= l; --h){ 
+        if( !h->second.empty() ){
+            std::cout<< _itop(h);
+            for(const auto & e : h->second){
+                plim = (plevel)T_(e.second,1);
+                std::cout<< " <" << (T_(e.second,0) ? "B " : "S ")
+                                 << std::to_string( T_(e.second,2) ) << " @ "
+                                 << (plim ? std::to_string(_itop(plim)) : "MKT")
+                                 << " #" << std::to_string(e.first) << "> ";
+            }
+            std::cout<< std::endl;
+        } 
+    }
+    /* --- CRITICAL SECTION --- */
+}
+
+
+SOB_TEMPLATE
+typename SOB_CLASS::plevel 
+SOB_CLASS::_ptoi(my_price_type price) const
+{  /* 
+    * the range checks in here are 1 position more restrictive to catch
+    * bad user price data passed but allow internal index conversions(_itop)
+    * 
+    * this means that internally we should not convert to a price when
+    * a pointer is past beg / at end, signaling a null value
     * 
     * if this causes trouble just create a seperate user input check
     */
-    plevel plev;
-    size_type incr_offset;
+    plevel plev;
+    size_type incr_offset;
+
+    incr_offset = round((price - _base) * tick_ratio::den/tick_ratio::num);
+    plev = _beg + incr_offset;
+
+    if(plev < _beg)
+        throw std::range_error( "chain_pair_type* < _beg" );
+
+    if(plev >= _end)
+        throw std::range_error( "plevel >= _end" );
+
+    return plev;
+}
+
+
+SOB_TEMPLATE 
+typename SOB_CLASS::my_price_type 
+SOB_CLASS::_itop(plevel plev) const
+{
+    price_type incr_offset;
+    long long offset;
+
+    if(plev < _beg - 1)
+        throw std::range_error( "plevel < _beg - 1" );
+
+    if(plev > _end )
+        throw std::range_error( "plevel > _end" );
+
+    offset = plev - _beg;
+    incr_offset = (double)offset * tick_ratio::num / tick_ratio::den;
+
+    return _base + my_price_type(incr_offset);
+}
+
+
+SOB_TEMPLATE
+size_type 
+SOB_CLASS::_incrs_in_range(my_price_type lprice, my_price_type hprice)
+{
+    my_price_type h( _round_to_incr(hprice) );
+    my_price_type l( _round_to_incr(lprice) );
+    size_type i = round((double)(h-l)*tick_ratio::den/tick_ratio::num);
+    
+    if(lprice < 0 || hprice < 0)
+        throw invalid_parameters("price/min/max values can not be < 0"); 
+    
+    if(i < 0)
+        throw invalid_parameters("invalid price/min/max price value(s)");
+        
+    return (size_type)i;
+}
+
+
+SOB_TEMPLATE
+size_type 
+SOB_CLASS::_generate_and_check_total_incr()
+{
+    size_type i;
+    
+    if(_lower_incr < 1 || _upper_incr < 1)    
+        throw invalid_parameters("parameters don't generate enough increments"); 
+    
+    i = _lower_incr + _upper_incr + 1;
+    
+    if(i > max_ticks)
+        throw allocation_error("tick range requested would exceed MaxMemory");
+    
+    return i;
+}
+
+
+SOB_TEMPLATE
+void 
+SOB_CLASS::add_market_makers(market_makers_type&& mms)
+{
+    std::lock_guard<std::recursive_mutex> lock(*_mm_mtx);
+    /* --- CRITICAL SECTION --- */                
+    for(auto & mm : mms){     
+        if(_sim)
+            _sim_seed_market_maker(*mm);
+        mm->start(this, _itop(_last), tick_size);        
+        if(_agents)
+            _agents->attach(mm->_callback);
+        _market_makers.push_back(std::move(mm));        
+    }
+    /* --- CRITICAL SECTION --- */ 
+}
+
+
+SOB_TEMPLATE
+void 
+SOB_CLASS::add_market_maker(MarketMaker&& mm)
+{
+    std::lock_guard<std::recursive_mutex> lock(*_mm_mtx);
+    /* --- CRITICAL SECTION --- */ 
+    pMarketMaker pmm = mm._move_to_new();
+    add_market_maker(std::move(pmm));
+    /* --- CRITICAL SECTION --- */ 
+}
+
+
+SOB_TEMPLATE
+void 
+SOB_CLASS::add_market_maker(pMarketMaker&& mm)
+{
+    std::lock_guard<std::recursive_mutex> lock(*_mm_mtx);
+    /* --- CRITICAL SECTION --- */ 
+    if(_sim)
+        _sim_seed_market_maker(*mm);
+    mm->start(this, _itop(_last), tick_size);
+    if(_agents)
+        _agents->attach(mm->_callback);
+    _market_makers.push_back(std::move(mm)); 
+    /* --- CRITICAL SECTION --- */ 
+}
+
+
+SOB_TEMPLATE
+id_type 
+SOB_CLASS::insert_limit_order( bool buy,
+                               price_type limit,
+                               size_type size,
+                               order_exec_cb_type exec_cb,
+                               order_admin_cb_type admin_cb,
+                               owner_type owner ) 
+{
+    plevel plev;
+    
+    if(size <= 0)
+        throw invalid_order("invalid order size");    
+ 
+    try{
+        plev = _ptoi(limit);    
+    }catch(std::range_error){
+        throw invalid_order("invalid limit price");
+    }        
+ 
+    return _push_order_and_wait(order_type::limit, buy, plev, nullptr, size, 
+                                exec_cb, admin_cb, 0, order_params_type(0, owner));    
+}
+
+
+SOB_TEMPLATE
+id_type 
+SOB_CLASS::insert_market_order( bool buy,
+                                size_type size,
+                                order_exec_cb_type exec_cb,
+                                order_admin_cb_type admin_cb,
+                                owner_type owner )
+{    
+    if(size <= 0)
+        throw invalid_order("invalid order size");
+
+    return _push_order_and_wait(order_type::market, buy, nullptr, nullptr, 
+                                size, exec_cb, admin_cb, 0, 
+                                order_params_type(0, owner)); 
+}
+
+
+SOB_TEMPLATE
+id_type 
+SOB_CLASS::insert_iceberg_order( bool buy,
+                                 price_type limit,
+                                 size_type display,
+                                 size_type size,
+                                 order_exec_cb_type exec_cb,
+                                 order_admin_cb_type admin_cb,
+                                 owner_type owner ) 
+{
+    plevel plev;
+    
+    if(size <= 0)
+        throw invalid_order("invalid order size");    
+
+    /* (the journal keeps display in 32 bits) */
+    if(display <= 0 || display > std::numeric_limits<std::uint32_t>::max())
+        throw invalid_order("invalid display size");
+ 
+    try{
+        plev = _ptoi(limit);    
+    }catch(std::range_error){
+        throw invalid_order("invalid limit price");
+    }        
+ 
+    return _push_order_and_wait(order_type::limit, buy, plev, nullptr, size, 
+                                exec_cb, admin_cb, 0, order_params_type(display, owner));    
+}
+
+
+SOB_TEMPLATE
+id_type 
+SOB_CLASS::insert_peg_order( bool buy,
+                             peg_type peg,
+                             size_type size,
+                             order_exec_cb_type exec_cb,
+                             size_type offset,
+                             order_admin_cb_type admin_cb,
+                             owner_type owner ) 
+{
+    order_params_type params(0, owner);
+
+    if(size <= 0)
+        throw invalid_order("invalid order size");    
+
+    /* (the journal keeps the offset in 32 bits) */
+    if(offset > std::numeric_limits<std::uint32_t>::max())
+        throw invalid_order("invalid peg offset");
+
+    if(peg != peg_type::primary && peg != peg_type::midpoint)
+        throw invalid_order("invalid peg type");
+
+    params.peg = (int)peg + 1;
+    params.offset = offset;
+
+    /* priced when it's routed; see _insert_peg_order */
+    return _push_order_and_wait(order_type::limit, buy, nullptr, nullptr, size, 
+                                exec_cb, admin_cb, 0, params);    
+}
+
+
+SOB_TEMPLATE
+id_type 
+SOB_CLASS::insert_gtt_order( bool buy,
+                             price_type limit,
+                             size_type size,
+                             time_stamp_type expire,
+                             order_exec_cb_type exec_cb,
+                             order_admin_cb_type admin_cb,
+                             owner_type owner ) 
+{
+    plevel plev;
+    order_params_type params(0, owner);
+    
+    if(size <= 0)
+        throw invalid_order("invalid order size");    
+
+    if(expire == time_stamp_type())
+        throw invalid_order("invalid expiry");
+ 
+    try{
+        plev = _ptoi(limit);    
+    }catch(std::range_error){
+        throw invalid_order("invalid limit price");
+    }        
+
+    params.expire = expire;
+    return _push_order_and_wait(order_type::limit, buy, plev, nullptr, size, 
+                                exec_cb, admin_cb, 0, params);    
+}
+
+
+SOB_TEMPLATE
+id_type 
+SOB_CLASS::insert_ioc_order( bool buy,
+                             price_type limit,
+                             size_type size,
+                             order_exec_cb_type exec_cb,
+                             order_admin_cb_type admin_cb,
+                             owner_type owner ) 
+{
+    plevel plev;
+    
+    if(size <= 0)
+        throw invalid_order("invalid order size");    
+ 
+    try{
+        plev = _ptoi(limit);    
+    }catch(std::range_error){
+        throw invalid_order("invalid limit price");
+    }        
+ 
+    return _push_order_and_wait(order_type::immediate_or_cancel, buy, plev, 
+                                nullptr, size, exec_cb, admin_cb, 0,
+                                order_params_type(0, owner));    
+}
+
+
+SOB_TEMPLATE
+id_type 
+SOB_CLASS::insert_fok_order( bool buy,
+                             price_type limit,
+                             size_type size,
+                             order_exec_cb_type exec_cb,
+                             order_admin_cb_type admin_cb,
+                             owner_type owner ) 
+{
+    plevel plev;
+    
+    if(size <= 0)
+        throw invalid_order("invalid order size");    
+ 
+    try{
+        plev = _ptoi(limit);    
+    }catch(std::range_error){
+        throw invalid_order("invalid limit price");
+    }        
+ 
+    return _push_order_and_wait(order_type::fill_or_kill, buy, plev, 
+                                nullptr, size, exec_cb, admin_cb, 0,
+                                order_params_type(0, owner));    
+}
+
+
+SOB_TEMPLATE
+id_type 
+SOB_CLASS::insert_stop_order( bool buy,
+                              price_type stop,
+                              size_type size,
+                              order_exec_cb_type exec_cb,
+                              order_admin_cb_type admin_cb,
+                              owner_type owner )
+{
+    return insert_stop_order(buy,stop,0,size,exec_cb,admin_cb,owner);
+}
+
+
+SOB_TEMPLATE
+id_type 
+SOB_CLASS::insert_stop_order( bool buy,
+                              price_type stop,
+                              price_type limit,
+                              size_type size,
+                              order_exec_cb_type exec_cb,
+                              order_admin_cb_type admin_cb,
+                              owner_type owner )
+{
+    plevel plimit, pstop;
+    order_type oty;
+
+    if(size <= 0)
+        throw invalid_order("invalid order size");
+
+    try{
+        plimit = limit ? _ptoi(limit) : nullptr;
+        pstop = _ptoi(stop);         
+    }catch(std::range_error){
+        throw invalid_order("invalid price");
+    }    
+    oty = limit ? order_type::stop_limit : order_type::stop;
+
+    return _push_order_and_wait(oty, buy, plimit, pstop, size, exec_cb, admin_cb, 
+                                0, order_params_type(0, owner));    
+}
+
+
+SOB_TEMPLATE
+id_type 
+SOB_CLASS::insert_gtt_stop_order( bool buy,
+                                  price_type stop,
+                                  size_type size,
+                                  time_stamp_type expire,
+                                  order_exec_cb_type exec_cb,
+                                  order_admin_cb_type admin_cb,
+                                  owner_type owner )
+{
+    return insert_gtt_stop_order(buy,stop,0,size,expire,exec_cb,admin_cb,owner);
+}
+
+
+SOB_TEMPLATE
+id_type 
+SOB_CLASS::insert_gtt_stop_order( bool buy,
+                                  price_type stop,
+                                  price_type limit,
+                                  size_type size,
+                                  time_stamp_type expire,
+                                  order_exec_cb_type exec_cb,
+                                  order_admin_cb_type admin_cb,
+                                  owner_type owner )
+{
+    plevel plimit, pstop;
+    order_type oty;
+    order_params_type params(0, owner);
+
+    if(size <= 0)
+        throw invalid_order("invalid order size");
+
+    if(expire == time_stamp_type())
+        throw invalid_order("invalid expiry");
+
+    try{
+        plimit = limit ? _ptoi(limit) : nullptr;
+        pstop = _ptoi(stop);         
+    }catch(std::range_error){
+        throw invalid_order("invalid price");
+    }    
+    oty = limit ? order_type::stop_limit : order_type::stop;
+
+    params.expire = expire;
+    return _push_order_and_wait(oty, buy, plimit, pstop, size, exec_cb, admin_cb, 
+                                0, params);    
+}
+
+
+SOB_TEMPLATE
+id_type 
+SOB_CLASS::insert_trailing_stop_order( bool buy,
+                                       size_type trail,
+                                       size_type size,
+                                       order_exec_cb_type exec_cb,
+                                       order_admin_cb_type admin_cb,
+                                       owner_type owner )
+{
+    order_params_type params(0, owner);
+
+    if(size <= 0)
+        throw invalid_order("invalid order size");
+
+    /* (the journal keeps the trail in 32 bits) */
+    if(trail <= 0 || trail > std::numeric_limits<std::uint32_t>::max())
+        throw invalid_order("invalid trail");
+
+    params.trail = trail;
+
+    /* priced off the last when it's routed; see _insert_trailing_stop_order */
+    return _push_order_and_wait(order_type::stop, buy, nullptr, nullptr, size, 
+                                exec_cb, admin_cb, 0, params);    
+}
+
+
+SOB_TEMPLATE
+id_type 
+SOB_CLASS::insert_trailing_stop_limit_order( bool buy,
+                                             size_type trail,
+                                             size_type limit_offset,
+                                             size_type size,
+                                             order_exec_cb_type exec_cb,
+                                             order_admin_cb_type admin_cb,
+                                             owner_type owner )
+{
+    order_params_type params(0, owner);
+
+    if(size <= 0)
+        throw invalid_order("invalid order size");
+
+    if(trail <= 0 || trail > std::numeric_limits<std::uint32_t>::max())
+        throw invalid_order("invalid trail");
+
+    if(limit_offset > std::numeric_limits<std::uint32_t>::max())
+        throw invalid_order("invalid limit offset");
+
+    params.trail = trail;
+    params.limit_offset = limit_offset;
+
+    return _push_order_and_wait(order_type::stop_limit, buy, nullptr, nullptr, size, 
+                                exec_cb, admin_cb, 0, params);    
+}
+
+
+SOB_TEMPLATE
+bool 
+SOB_CLASS::pull_order(id_type id, bool search_limits_first)
+{
+    return _push_order_and_wait(order_type::null, search_limits_first, 
+                                nullptr, nullptr, 0, nullptr, nullptr,id); 
+}
+
+
+SOB_TEMPLATE
+id_type
+SOB_CLASS::modify_order(id_type id, size_type size)
+{
+    if(size <= 0)
+        throw invalid_order("invalid order size");
+
+    return _push_order_and_wait(order_type::null, true, nullptr, nullptr, 
+                                size, nullptr, nullptr, id);
+}
+
+
+SOB_TEMPLATE
+id_type
+SOB_CLASS::modify_order(id_type id, price_type limit, size_type size)
+{
+    plevel plev;
+
+    if(size <= 0)
+        throw invalid_order("invalid order size");
+
+    try{
+        plev = _ptoi(limit);    
+    }catch(std::range_error){
+        throw invalid_order("invalid limit price");
+    }        
+
+    return _push_order_and_wait(order_type::null, true, plev, nullptr, 
+                                size, nullptr, nullptr, id);
+}
+
+
+SOB_TEMPLATE
+size_type
+SOB_CLASS::cancel_all(const cancel_filter& filter)
+{
+    plevel low, high;
+    std::uint8_t what = 0;
+
+    if(filter.side != side_of_market::ask)
+        what |= CANCEL_BUYS;
+    if(filter.side != side_of_market::bid)
+        what |= CANCEL_SELLS;
+
+    switch(filter.type){
+    case order_type::null:
+        what |= CANCEL_LIMITS | CANCEL_STOPS | CANCEL_STOP_LIMITS;
+        break;
+    case order_type::limit:
+        what |= CANCEL_LIMITS;
+        break;
+    case order_type::stop:
+        what |= CANCEL_STOPS;
+        break;
+    case order_type::stop_limit:
+        what |= CANCEL_STOP_LIMITS;
+        break;
+    default:
+        throw invalid_order("only resting order types can be cancelled");
+    }
+
+    try{
+        low = filter.min_price ? _ptoi(filter.min_price) : _beg;
+        high = filter.max_price ? _ptoi(filter.max_price) : _end - 1;
+    }catch(std::range_error){
+        throw invalid_order("invalid price band");
+    }
+
+    if(low > high)
+        throw invalid_order("invalid price band");
+
+    return (size_type)_push_order_and_wait(order_type::null, false, low, high, 0, 
+                                           nullptr, nullptr, 0, 
+                                           order_params_type(0, filter.owner, what));
+}
+
+
+SOB_TEMPLATE
+quote_ack
+SOB_CLASS::mass_quote(owner_type session,
+                      const quote_levels_type& bids,
+                      const quote_levels_type& asks,
+                      order_exec_cb_type exec_cb,
+                      quote_admin_cb_type admin_cb)
+{
+    std::shared_ptr<quote_bndl_type> q = std::make_shared<quote_bndl_type>();
+
+    if(!session)
+        throw invalid_order("mass quote needs a session(owner tag)");
+
+    _quote_levels_to_side(bids, q->bids);
+    _quote_levels_to_side(asks, q->asks);
+
+    if( !q->bids.empty() && !q->asks.empty() 
+        && q->bids.back().first >= q->asks.front().first )
+    {
+        throw invalid_order("crossed quote");
+    }
+
+    q->admin_cb = admin_cb;
+
+    _push_order_and_wait(order_type::null, false, nullptr, nullptr, 0, exec_cb,
+                         nullptr, 0, order_params_type(0, session, 0, q));
+
+    /* the dispatcher is done w/ it */
+    return std::move(q->ack);
+}
+
+
+SOB_TEMPLATE
+void
+SOB_CLASS::_quote_levels_to_side(const quote_levels_type& levels, 
+                                 quote_side_type& side)
+{
+    for(const quote_level_type& l : levels){
+        if(!l.second)
+            continue; /* nothing at this price */
+        try{
+            side.push_back( std::make_pair(_ptoi(l.first), l.second) );
+        }catch(std::range_error){
+            throw invalid_order("invalid quote price");
+        }
+    }
+
+    std::sort(side.begin(), side.end());
+    for(size_t i = 1; i < side.size(); ++i){
+        if(side[i].first == side[i-1].first)
+            throw invalid_order("more than one quote at a price");
+    }
+}
+
+
+SOB_TEMPLATE
+std::vector<id_type>
+SOB_CLASS::insert_oco_order(const order_legs_type& legs,
+                            order_exec_cb_type exec_cb,
+                            group_admin_cb_type admin_cb,
+                            owner_type owner)
+{
+    std::shared_ptr<group_cmd_type> g = std::make_shared<group_cmd_type>();
+    order_params_type params(0, owner);
+    plevel high_buy = nullptr, low_sell = nullptr;
+
+    if(legs.size() < 2)
+        throw invalid_order("an OCO group needs at least two orders");
+
+    for(const order_leg& l : legs){
+        group_leg_type gl = {l.type, l.buy, nullptr, nullptr, l.size};
+
+        if(l.size <= 0)
+            throw invalid_order("invalid order size");
+
+        try{
+            switch(l.type){
+            case order_type::limit:
+                gl.limit = _ptoi(l.limit);
+                if(l.buy && (!high_buy || gl.limit > high_buy))
+                    high_buy = gl.limit;
+                else if(!l.buy && (!low_sell || gl.limit < low_sell))
+                    low_sell = gl.limit;
+                break;
+            case order_type::stop_limit:
+                gl.limit = _ptoi(l.limit); 
+                /* no break */
+            case order_type::stop:
+                gl.stop = _ptoi(l.stop);
+                break;
+            default:
+                throw invalid_order("only limit, stop and stop-limit orders can be grouped");
+            }
+        }catch(std::range_error){
+            throw invalid_order("invalid price");
+        }
+
+        g->legs.push_back(gl);
+    }
+
+    /* (they'd trade w/ each other) */
+    if(high_buy && low_sell && high_buy >= low_sell)
+        throw invalid_order("crossed OCO group");
+
+    g->bracket = false;
+    g->admin_cb = admin_cb;
+    params.group = g;
+
+    _push_order_and_wait(order_type::null, false, nullptr, nullptr, 0, exec_cb,
+                         nullptr, 0, params);
+
+    /* the dispatcher is done w/ it */
+    return std::move(g->ids);
+}
+
+
+SOB_TEMPLATE
+std::vector<id_type>
+SOB_CLASS::insert_bracket_order(bool buy,
+                                price_type limit,
+                                size_type size,
+                                price_type profit,
+                                price_type loss,
+                                order_exec_cb_type exec_cb,
+                                group_admin_cb_type admin_cb,
+                                owner_type owner)
+{
+    std::shared_ptr<group_cmd_type> g = std::make_shared<group_cmd_type>();
+    order_params_type params(0, owner);
+    plevel plimit, pprofit, ploss;
+
+    if(size <= 0)
+        throw invalid_order("invalid order size");
+
+    try{
+        plimit = _ptoi(limit);
+        pprofit = _ptoi(profit);
+        ploss = _ptoi(loss);
+    }catch(std::range_error){
+        throw invalid_order("invalid price");
+    }
+
+    /* take profit past the entry, stop loss short of it */
+    if( buy ? (pprofit <= plimit || ploss >= plimit)
+            : (pprofit >= plimit || ploss <= plimit) )
+    {
+        throw invalid_order("invalid bracket prices");
+    }
+
+    g->legs.push_back( group_leg_type{order_type::limit, buy, plimit, nullptr, size} );
+    g->legs.push_back( group_leg_type{order_type::limit, !buy, pprofit, nullptr, size} );
+    g->legs.push_back( group_leg_type{order_type::stop, !buy, nullptr, ploss, size} );
+    g->bracket = true;
+    g->admin_cb = admin_cb;
+    params.group = g;
+
+    _push_order_and_wait(order_type::null, false, nullptr, nullptr, 0, exec_cb,
+                         nullptr, 0, params);
+
+    return std::move(g->ids);
+}
+
+
+SOB_TEMPLATE
+order_info_type 
+SOB_CLASS::get_order_info(id_type id, bool search_limits_first) 
+{   /* _get_order_info locks _master_mtx */
+    return search_limits_first
+        ? _get_order_info<limit_chain_type, stop_chain_type>(id)        
+        : _get_order_info<stop_chain_type, limit_chain_type>(id);
+}
+
+
+SOB_TEMPLATE
+size_type
+SOB_CLASS::_memory_total() const
+{
+    size_type n = _book.size() * sizeof(chain_pair_type)
+                + _t_and_s_max_sz * sizeof(t_and_s_type);
+
+    for(const allocation_counter& ac : _alloc_counters)
+        n += ac.bytes.load(std::memory_order_relaxed);
+
+    return n;
+}
+
+
+SOB_TEMPLATE
+void
+SOB_CLASS::set_memory_limit(size_type bytes)
+{
+    std::lock_guard<std::mutex> lock(*_order_queue_mtx);
+    /* --- CRITICAL SECTION --- */
+    _memory_limit.store(bytes);
+    if(_journal)
+        _journal->set_memory_limit(bytes); /* restored by replay_journal */
+    /* --- CRITICAL SECTION --- */
+}
+
+
+SOB_TEMPLATE
+memory_usage_type
+SOB_CLASS::memory_usage() const
+{
+    memory_usage_type mu = memory_usage_type();
+    size_type nqueued;
+
+    for(int i = 0; i < memory_usage_type::ncomponents; ++i){
+        mu.bytes[i] = _alloc_counters[i].bytes.load(std::memory_order_relaxed);
+        mu.objects[i] = _alloc_counters[i].allocations.load(std::memory_order_relaxed);
+    }
+
+    mu.bytes[(int)memory_component::ladder] = _book.size() * sizeof(chain_pair_type);
+    mu.objects[(int)memory_component::ladder] = _book.size();
+    mu.bytes[(int)memory_component::time_and_sales] = 
+        _t_and_s_max_sz * sizeof(t_and_s_type);
+    mu.limit = _memory_limit.load();
+
+    {
+        counted_lock_guard lock(*_master_mtx, _counters); 
+        /* --- CRITICAL SECTION --- */
+        mu.objects[(int)memory_component::callback_queue] = 
+            _deferred_callback_queue.size();
+        mu.objects[(int)memory_component::time_and_sales] = _t_and_s.size();
+        nqueued = _direct_orders.size();
+        {
+            std::lock_guard<std::mutex> qlock(*_order_queue_mtx);
+            nqueued += _order_queue.size();
+        }
+        mu.objects[(int)memory_component::order_queue] = nqueued;
+        /* --- CRITICAL SECTION --- */
+    }
+
+    return mu;
+}
+
+
+SOB_TEMPLATE
+id_type 
+SOB_CLASS::replace_with_limit_order( id_type id,
+                                     bool buy,
+                                     price_type limit,
+                                     size_type size,
+                                     order_exec_cb_type exec_cb,
+                                     order_admin_cb_type admin_cb,
+                                     owner_type owner )
+{
+    id_type id_new = 0;
+    
+    if(pull_order(id))
+        id_new = insert_limit_order(buy,limit,size,exec_cb,admin_cb,owner);
+    
+    return id_new;
+}
+
+
+SOB_TEMPLATE
+id_type 
+SOB_CLASS::replace_with_market_order( id_type id,
+                                      bool buy,
+                                      size_type size,
+                                      order_exec_cb_type exec_cb,
+                                      order_admin_cb_type admin_cb,
+                                      owner_type owner )
+{
+    id_type id_new = 0;
+    
+    if(pull_order(id))
+        id_new = insert_market_order(buy,size,exec_cb,admin_cb,owner);
+    
+    return id_new;
+}
+
+
+SOB_TEMPLATE
+id_type 
+SOB_CLASS::replace_with_stop_order( id_type id,
+                                    bool buy,
+                                    price_type stop,
+                                    size_type size,
+                                    order_exec_cb_type exec_cb,
+                                    order_admin_cb_type admin_cb,
+                                    owner_type owner )
+{
+    id_type id_new = 0;
+    
+    if(pull_order(id))
+        id_new = insert_stop_order(buy,stop,size,exec_cb,admin_cb,owner);
+    
+    return id_new;
+}
+
+
+SOB_TEMPLATE
+id_type 
+SOB_CLASS::replace_with_stop_order( id_type id,
+                                    bool buy,
+                                    price_type stop,
+                                    price_type limit,
+                                    size_type size,
+                                    order_exec_cb_type exec_cb,
+                                    order_admin_cb_type admin_cb,
+                                    owner_type owner )
+{
+    id_type id_new = 0;
+    
+    if(pull_order(id))
+        id_new = insert_stop_order(buy,stop,limit,size,exec_cb,admin_cb,owner);
+    
+    return id_new;
+}
+
+
+SOB_TEMPLATE
+void 
+SOB_CLASS::dump_cached_plevels() const
+{
+    counted_lock_guard lock(*_master_mtx, _counters);
+    /* --- CRITICAL SECTION --- */
+    std::cout<< "CACHED PLEVELS" << std::endl;       
+
+    std::cout<< "_high_sell_limit: "
+             << std::to_string(_itop(_high_sell_limit)) 
+             << std::endl;
+
+    std::cout<< "_high_buy_stop: "
+             << std::to_string(_itop(_low_buy_stop)) 
+             << std::endl;
+
+    std::cout<< "_low_buy_stop: "
+             << std::to_string(_itop(_low_buy_stop)) 
+             << std::endl;
+
+    std::cout<< "LAST: "
+             << std::to_string(_itop(_last)) 
+             << std::endl;
+
+    std::cout<< "_high_sell_stop: "
+             << std::to_string(_itop(_high_sell_stop)) 
+             << std::endl;
+
+    std::cout<< "_low_sell_stop: "
+             << std::to_string(_itop(_low_sell_stop)) 
+             << std::endl;
+
+    std::cout<< "_low_buy_limit: "
+             << std::to_string(_itop(_low_buy_limit)) 
+             << std::endl;
+    /* --- CRITICAL SECTION --- */
+}
+
+
+SOB_TEMPLATE
+void
+SOB_CLASS::enable_latency_stats(bool on)
+{
+    counted_lock_guard lock(*_master_mtx, _counters);
+    /* --- CRITICAL SECTION --- */
+    if(on && !_latency)
+        _latency.reset(new LatencyStats());
+    _latency_on.store(on, std::memory_order_release);
+    /* --- CRITICAL SECTION --- */
+}
+
+
+SOB_TEMPLATE
+void
+SOB_CLASS::reset_latency_stats()
+{
+    if(_latency)
+        _latency->reset();
+}
+
+
+SOB_TEMPLATE
+void
+SOB_CLASS::set_direct_mode(bool on)
+{
+    if(on && get_agent_threads())
+        throw invalid_state("direct mode can't be used w/ agent threads");
+
+    _block_on_outstanding_orders(); /* BLOCKING (on _noutstanding_orders) */
+    _clear_callback_queue();
+
+    {
+        counted_lock_guard lock(*_master_mtx, _counters);
+        /* --- CRITICAL SECTION --- */
+        _direct = on;
+        /* --- CRITICAL SECTION --- */
+    }
+    _order_queue_cond.notify_one(); /* sweep GTT expiries again */
+}
+
+
+SOB_TEMPLATE
+void
+SOB_CLASS::set_agent_threads(unsigned int nthreads)
+{
+    if(nthreads && (_direct || _sim))
+        throw invalid_state("agent threads can't be used in direct mode");
+
+    std::lock_guard<std::recursive_mutex> lock(*_mm_mtx);
+    /* --- CRITICAL SECTION --- */ 
+    _agents.reset(); /* detach, deliver what's queued, join */
+    if(nthreads){
+        _agents.reset( new AgentRuntime(nthreads) );
+        for(auto & mm : _market_makers)
+            _agents->attach(mm->_callback);
+    }
+    /* --- CRITICAL SECTION --- */ 
+}
+
+
+SOB_TEMPLATE
+unsigned int
+SOB_CLASS::get_agent_threads()
+{
+    std::lock_guard<std::recursive_mutex> lock(*_mm_mtx);
+    /* --- CRITICAL SECTION --- */ 
+    return _agents ? _agents->nthreads() : 0;
+    /* --- CRITICAL SECTION --- */ 
+}
+
+
+SOB_TEMPLATE
+void
+SOB_CLASS::wait_for_agents()
+{
+    std::lock_guard<std::recursive_mutex> lock(*_mm_mtx);
+    /* --- CRITICAL SECTION --- */ 
+    if(!_agents)
+        return;
+    for( ; ; ){
+        _agents->wait_idle(); /* BLOCKING (on the workers) */
+        _block_on_outstanding_orders(); /* BLOCKING (on _noutstanding_orders) */
+        _clear_callback_queue(); /* (into the agents' inboxes) */
+        _agents->wait_idle();
+        {
+            std::lock_guard<std::mutex> lock(*_order_queue_mtx);
+            if(_noutstanding_orders)
+                continue;
+        }
+        counted_lock_guard lock(*_master_mtx, _counters);
+        /* --- (INNER) CRITICAL SECTION --- */
+        if( _deferred_callback_queue.empty() )
+            break;
+        /* --- (INNER) CRITICAL SECTION --- */
+    }
+    /* --- CRITICAL SECTION --- */ 
+}
+
+
+SOB_TEMPLATE
+void
+SOB_CLASS::set_stp_policy(stp_policy policy)
+{
+    counted_lock_guard lock(*_master_mtx, _counters);
+    /* --- CRITICAL SECTION --- */
+    _stp = policy;
+    /* --- CRITICAL SECTION --- */
+}
+
+
+SOB_TEMPLATE
+stp_policy
+SOB_CLASS::get_stp_policy()
+{
+    counted_lock_guard lock(*_master_mtx, _counters);
+    /* --- CRITICAL SECTION --- */
+    return _stp;
+    /* --- CRITICAL SECTION --- */
+}
+
+
+SOB_TEMPLATE
+void
+SOB_CLASS::set_virtual_time(time_stamp_type tp)
+{
+    order_params_type params;
+    bool due;
+    {
+        counted_lock_guard lock(*_master_mtx, _counters);
+        /* --- CRITICAL SECTION --- */
+        _virtual_time = tp;
+        _use_virtual_time = true;
+        due = !_expiry_heap.empty() && _expiry_heap.top().first <= tp;
+        /* --- CRITICAL SECTION --- */
+    }
+
+    if(due){ /* sweep the GTT orders tp reached */
+        params.expire = tp;
+        params.sweep = true;
+        _push_order_and_wait(order_type::null, false, nullptr, nullptr, 0, 
+                             nullptr, nullptr, 0, params);
+    }
+
+    if(_sim)
+        _sim_wake(tp);
+}
+
+
+SOB_TEMPLATE
+void
+SOB_CLASS::start_simulation(unsigned long long seed, time_stamp_type start)
+{
+    if(get_agent_threads())
+        throw invalid_state("simulation can't be run w/ agent threads");
+
+    set_direct_mode(true);
+    {
+        std::lock_guard<std::recursive_mutex> lock(*_mm_mtx);
+        /* --- CRITICAL SECTION --- */ 
+        _sim_seed = seed;
+        _sim_nseeded = 0;
+        for(auto & mm : _market_makers)
+            _sim_seed_market_maker(*mm);
+        _next_wake = start + _wake_interval;
+        _sim = true;
+        /* --- CRITICAL SECTION --- */ 
+    }
+    set_virtual_time(start);
+}
+
+
+SOB_TEMPLATE
+void
+SOB_CLASS::stop_simulation()
+{
+    {
+        std::lock_guard<std::recursive_mutex> lock(*_mm_mtx);
+        /* --- CRITICAL SECTION --- */ 
+        _sim = false;
+        /* --- CRITICAL SECTION --- */ 
+    }
+    set_direct_mode(false);
+    use_wall_clock();
+}
+
+
+SOB_TEMPLATE
+void
+SOB_CLASS::_sim_seed_market_maker(MarketMaker& mm)
+{  /* 
+    * PART OF THE _mm_mtx CRITICAL SECTION 
+    *
+    * a Weyl sequence off the master seed; the market maker mixes it
+    */
+    mm.seed( _sim_seed + 0x9E3779B97F4A7C15ULL * (++_sim_nseeded) );
+}
 
-    incr_offset = round((price - _base) * tick_ratio::den/tick_ratio::num);
-    plev = _beg + incr_offset;
 
-    if(plev < _beg)
-        throw std::range_error( "chain_pair_type* < _beg" );
+SOB_TEMPLATE
+void
+SOB_CLASS::_sim_wake(time_stamp_type tp)
+{
+    std::lock_guard<std::recursive_mutex> lock(*_mm_mtx);
+    /* --- CRITICAL SECTION --- */ 
+    if(_wake_interval == clock_type::duration::zero())
+        return; /* constructed w/o a waker */
 
-    if(plev >= _end)
-        throw std::range_error( "plevel >= _end" );
+    while(_sim && _next_wake <= tp){
+        {
+            counted_lock_guard lock(*_master_mtx, _counters);
+            /* --- (INNER) CRITICAL SECTION --- */
+            for(auto & mm : _market_makers){
+                _deferred_callback_queue.push_back( /* callback with wake msg */
+                    dfrd_cb_elem_type(
+                        callback_msg::wake, 
+                        mm->get_callback(), 
+                        0, _itop(_last), 0
+                    ) 
+                ); 
+            }
+            /* --- (INNER) CRITICAL SECTION --- */
+        }
+        _next_wake += _wake_interval;
+        _clear_callback_queue();
+    }
+    /* --- CRITICAL SECTION --- */ 
+}
 
-    return plev;
+
+SOB_TEMPLATE
+void
+SOB_CLASS::use_wall_clock()
+{
+    {
+        counted_lock_guard lock(*_master_mtx, _counters);
+        /* --- CRITICAL SECTION --- */
+        _use_virtual_time = false;
+        /* --- CRITICAL SECTION --- */
+    }
+    _order_queue_cond.notify_one(); /* wait on GTT expiries again */
 }
 
 
-SOB_TEMPLATE 
-typename SOB_CLASS::my_price_type 
-SOB_CLASS::_itop(plevel plev) const
+SOB_TEMPLATE
+journal_header
+SOB_CLASS::_journal_header() const
 {
-    price_type incr_offset;
-    long long offset;
+    return OrderJournal::MakeHeader(tick_ratio::num, tick_ratio::den,
+                                    _base.to_incr(), _total_incr,
+                                    _memory_limit.load());
+}
 
-    if(plev < _beg - 1)
-        throw std::range_error( "plevel < _beg - 1" );
 
-    if(plev > _end )
-        throw std::range_error( "plevel > _end" );
+SOB_TEMPLATE
+typename SOB_CLASS::order_queue_elem_type
+SOB_CLASS::_journal_record_to_order(const journal_record& r,
+                                    time_stamp_type time_base) const
+{
+    if(r.limit >= (std::int32_t)_total_incr || r.limit < -1
+       || r.stop >= (std::int32_t)_total_incr || r.stop < -1)
+    {
+        throw journal_error("journal record price out of range");
+    }
 
-    offset = plev - _beg;
-    incr_offset = (double)offset * tick_ratio::num / tick_ratio::den;
+    if(r.type >= (std::uint8_t)norder_types)
+        throw journal_error("journal record has invalid order type");
+
+    order_params_type params((size_type)r.display, r.owner, r.cancel);
+    if(r.flags & (JOURNAL_FLAG_PEG_PRIMARY | JOURNAL_FLAG_PEG_MIDPOINT)){
+        params.peg = (r.flags & JOURNAL_FLAG_PEG_PRIMARY) 
+                   ? (int)peg_type::primary + 1 
+                   : (int)peg_type::midpoint + 1;
+        params.offset = r.offset;
+    }else if(r.flags & JOURNAL_FLAG_TRAILING){
+        params.display = 0;
+        params.trail = r.offset;
+        params.limit_offset = r.display;
+    }else if(r.flags & JOURNAL_FLAG_EXPIRY){
+        params.display = 0;
+        params.expire = journal_record_expiry(r, time_base);
+        params.sweep = (r.type == (std::uint8_t)order_type::null);
+    }
 
-    return _base + my_price_type(incr_offset);
+    return order_queue_elem_type( 
+        (order_type)r.type, (bool)r.buy,
+        (r.limit >= 0 ? _beg + r.limit : nullptr),
+        (r.stop >= 0 ? _beg + r.stop : nullptr),
+        (size_type)r.size, nullptr, (id_type)r.id, nullptr, 
+        std::promise<id_type>(), time_stamp_type(), params
+    );
 }
 
 
 SOB_TEMPLATE
-size_type 
-SOB_CLASS::_incrs_in_range(my_price_type lprice, my_price_type hprice)
+typename SOB_CLASS::order_queue_elem_type
+SOB_CLASS::_journal_records_to_quote(const std::vector<journal_record>& recs,
+                                     size_t& i) const
 {
-    my_price_type h( _round_to_incr(hprice) );
-    my_price_type l( _round_to_incr(lprice) );
-    size_type i = round((double)(h-l)*tick_ratio::den/tick_ratio::num);
-    
-    if(lprice < 0 || hprice < 0)
-        throw invalid_parameters("price/min/max values can not be < 0"); 
-    
-    if(i < 0)
-        throw invalid_parameters("invalid price/min/max price value(s)");
-        
-    return (size_type)i;
+    std::shared_ptr<quote_bndl_type> q = std::make_shared<quote_bndl_type>();
+    const journal_record& h = recs[i];
+
+    if(h.size > recs.size() - i - 1)
+        throw journal_error("journal mass quote is missing levels");
+
+    for(size_t n = h.size; n; --n){
+        const journal_record& r = recs[++i];
+        if( !(r.flags & JOURNAL_FLAG_QUOTE) || r.limit < 0
+            || r.limit >= (std::int32_t)_total_incr )
+        {
+            throw journal_error("journal mass quote has an invalid level");
+        }
+        (r.buy ? q->bids : q->asks).push_back( 
+            std::make_pair(_beg + r.limit, (size_type)r.size) 
+        );
+    }
+
+    return order_queue_elem_type( 
+        order_type::null, false, nullptr, nullptr, 0, nullptr, 0, nullptr, 
+        std::promise<id_type>(), time_stamp_type(), 
+        order_params_type(0, h.owner, 0, q)
+    );
 }
 
 
 SOB_TEMPLATE
-size_type 
-SOB_CLASS::_generate_and_check_total_incr()
+typename SOB_CLASS::order_queue_elem_type
+SOB_CLASS::_journal_records_to_group(const std::vector<journal_record>& recs,
+                                     size_t& i) const
 {
-    size_type i;
-    
-    if(_lower_incr < 1 || _upper_incr < 1)    
-        throw invalid_parameters("parameters don't generate enough increments"); 
-    
-    i = _lower_incr + _upper_incr + 1;
-    
-    if(i > max_ticks)
-        throw allocation_error("tick range requested would exceed MaxMemory");
-    
-    return i;
+    std::shared_ptr<group_cmd_type> g = std::make_shared<group_cmd_type>();
+    const journal_record& h = recs[i];
+
+    if(h.size > recs.size() - i - 1)
+        throw journal_error("journal group is missing orders");
+
+    g->bracket = (h.flags & JOURNAL_FLAG_BRACKET);
+    if(h.size < 2 || (g->bracket && h.size != 3))
+        throw journal_error("journal group has the wrong number of orders");
+
+    for(size_t n = h.size; n; --n){
+        const journal_record& r = recs[++i];
+        if( !(r.flags & JOURNAL_FLAG_GROUP) 
+            || (r.type != (std::uint8_t)order_type::limit
+                && r.type != (std::uint8_t)order_type::stop
+                && r.type != (std::uint8_t)order_type::stop_limit)
+            || r.limit >= (std::int32_t)_total_incr || r.limit < -1
+            || r.stop >= (std::int32_t)_total_incr || r.stop < -1 )
+        {
+            throw journal_error("journal group has an invalid order");
+        }
+        g->legs.push_back( 
+            group_leg_type{(order_type)r.type, (bool)r.buy, 
+                           (r.limit >= 0 ? _beg + r.limit : nullptr),
+                           (r.stop >= 0 ? _beg + r.stop : nullptr),
+                           (size_type)r.size} 
+        );
+    }
+
+    order_params_type params(0, h.owner);
+    params.group = g;
+
+    return order_queue_elem_type( 
+        order_type::null, false, nullptr, nullptr, 0, nullptr, 0, nullptr, 
+        std::promise<id_type>(), time_stamp_type(), params
+    );
+}
+
+
+SOB_TEMPLATE
+void
+SOB_CLASS::open_journal(const std::string& path,
+                        journal_sync sync,
+                        size_type batch_max,
+                        int sync_interval)
+{
+    std::shared_ptr<OrderJournal> j = 
+        std::make_shared<OrderJournal>(path, _journal_header(), sync, sync_interval);
+
+    _block_on_outstanding_orders(); /* BLOCKING (on _noutstanding_orders) */ 
+    {
+        std::lock_guard<std::mutex> lock(*_order_queue_mtx);
+        _journal = j;
+        _journal_batch_max = std::max(batch_max, (size_type)1);
+    }
+}
+
+
+SOB_TEMPLATE
+void
+SOB_CLASS::close_journal()
+{
+    std::shared_ptr<OrderJournal> j;
+
+    _block_on_outstanding_orders(); /* BLOCKING (on _noutstanding_orders) */ 
+    {
+        std::lock_guard<std::mutex> lock(*_order_queue_mtx);
+        j = std::move(_journal);
+    }
+    /* j commits and closes on destruction */
 }
 
 
-SOB_TEMPLATE
-void 
-SOB_CLASS::add_market_makers(market_makers_type&& mms)
-{
-    std::lock_guard<std::recursive_mutex> lock(*_mm_mtx);
-    /* --- CRITICAL SECTION --- */                
-    for(auto & mm : mms){     
-        mm->start(this, _itop(_last), tick_size);        
-        _market_makers.push_back(std::move(mm));        
+SOB_TEMPLATE
+void
+SOB_CLASS::replay_journal(const std::string& path)
+{  /*
+    * route each record directly(from this thread), in journal order, with
+    * null callbacks; the dispatcher sits idle as nothing is pushed to the 
+    * order queue. Stops triggered during replay are held in _direct_orders
+    * and matched against their journal records so they execute in the same
+    * position they did originally; any left over (crash before their records
+    * were committed) are routed at the end.
+    *
+    * _last_id follows the records so ids generated while routing(modifies
+    * that move an order) come out the same as they did originally
+    *
+    * the memory limit is off while routing: a command it rejected is 
+    * followed by a reject record and skipped; the book is left w/ the 
+    * journal's limit
+    */
+    journal_header hdr;
+    order_queue_elem_type e;
+    id_type id;
+    bool was_direct, rejected;
+
+    std::vector<journal_record> recs = OrderJournal::Read(path, &hdr);
+    if(!OrderJournal::Compatible(hdr, _journal_header()))
+        throw journal_error("journal header doesn't match this orderbook");
+
+    /* GTT expiries are relative to it(wall clock GTT orders left expire 
+       when they would have) */
+    time_stamp_type time_base = journal_time_base(hdr);
+
+    _block_on_outstanding_orders(); /* BLOCKING (on _noutstanding_orders) */
+    {
+        counted_lock_guard lock(*_master_mtx, _counters);
+        /* --- CRITICAL SECTION --- */
+        if(_last_id)
+            throw invalid_state("can only replay a journal into a new orderbook");
+        was_direct = _direct;
+        _direct = true;
+        _memory_limit.store(0);
+        /* --- CRITICAL SECTION --- */
+    }
+
+    try{
+        for(size_t i = 0; i < recs.size(); ++i){
+            const journal_record& r = recs[i];
+            if(r.type == JOURNAL_REJECT)
+                continue; /* its command was skipped(below) */
+
+            if(r.flags & JOURNAL_FLAG_QUOTE)
+                e = _journal_records_to_quote(recs, i);
+            else if(r.flags & JOURNAL_FLAG_GROUP)
+                e = _journal_records_to_group(recs, i);
+            else
+                e = _journal_record_to_order(r, time_base);
+
+            if(r.flags & JOURNAL_FLAG_TRIGGERED){
+                auto riter = std::find_if( 
+                    _direct_orders.begin(), _direct_orders.end(),
+                    [&](const order_queue_elem_type& o){ return T_(o,6) == r.id; } 
+                );
+                if(riter != _direct_orders.end())
+                    _direct_orders.erase(riter);
+            }
+
+            id = (id_type)r.id;
+            _last_id = std::max(_last_id, (large_size_type)r.id);
+
+            rejected = (i + 1 < recs.size() && recs[i+1].type == JOURNAL_REJECT 
+                        && recs[i+1].id == r.seq);
+            if(rejected)
+                continue;
+
+            try{
+                _route_order(e, id);
+            }catch(...){ 
+                /* failed the same way originally (e.g liquidity_exception) */
+            }
+        }
+
+        while( !_direct_orders.empty() ){
+            e = std::move(_direct_orders.front());
+            _direct_orders.pop_front();
+            id = T_(e,6);
+            try{
+                _route_order(e, id);
+            }catch(...){ 
+            }
+        }
+    }catch(...){
+        counted_lock_guard lock(*_master_mtx, _counters);
+        _direct_orders.clear();
+        _direct = was_direct;
+        _memory_limit.store(hdr.memory_limit);
+        throw;
+    }
+
+    {
+        counted_lock_guard lock(*_master_mtx, _counters);
+        /* --- CRITICAL SECTION --- */
+        _deferred_callback_queue.clear(); /* null callbacks */
+        _direct = was_direct;
+        _memory_limit.store(hdr.memory_limit);
+        /* --- CRITICAL SECTION --- */
     }
-    /* --- CRITICAL SECTION --- */ 
+    _order_queue_cond.notify_one(); /* (GTT orders it left) */
 }
 
 
 SOB_TEMPLATE
-void 
-SOB_CLASS::add_market_maker(MarketMaker&& mm)
+typename SOB_CLASS::plevel
+SOB_CLASS::_tick_to_plevel(std::int32_t tick, bool allow_null) const
 {
-    std::lock_guard<std::recursive_mutex> lock(*_mm_mtx);
-    /* --- CRITICAL SECTION --- */ 
-    pMarketMaker pmm = mm._move_to_new();
-    add_market_maker(std::move(pmm));
-    /* --- CRITICAL SECTION --- */ 
-}
+    std::int32_t lo = allow_null ? -1 : 0;
+    std::int32_t hi = allow_null ? (std::int32_t)_total_incr : (std::int32_t)_total_incr - 1;
 
+    if(tick < lo || tick > hi)
+        throw snapshot_error("snapshot price out of range");
 
-SOB_TEMPLATE
-void 
-SOB_CLASS::add_market_maker(pMarketMaker&& mm)
-{
-    std::lock_guard<std::recursive_mutex> lock(*_mm_mtx);
-    /* --- CRITICAL SECTION --- */ 
-    mm->start(this, _itop(_last), tick_size);
-    _market_makers.push_back(std::move(mm)); 
-    /* --- CRITICAL SECTION --- */ 
+    return _beg + tick;
 }
 
 
 SOB_TEMPLATE
-id_type 
-SOB_CLASS::insert_limit_order( bool buy,
-                               price_type limit,
-                               size_type size,
-                               order_exec_cb_type exec_cb,
-                               order_admin_cb_type admin_cb ) 
+void
+SOB_CLASS::snapshot(const std::string& path)
 {
-    plevel plev;
-    
-    if(size <= 0)
-        throw invalid_order("invalid order size");    
- 
-    try{
-        plev = _ptoi(limit);    
-    }catch(std::range_error){
-        throw invalid_order("invalid limit price");
-    }        
- 
-    return _push_order_and_wait(order_type::limit, buy, plev, nullptr, 
-                                size, exec_cb, admin_cb);    
-}
+    plevel h, l;
+    snapshot_header hdr = snapshot_header();
+    std::vector<snapshot_limit> limits;
+    std::vector<snapshot_stop> stops;
+    std::vector<snapshot_tands> tands;
+    std::vector<snapshot_iceberg> icebergs;
+    std::vector<snapshot_peg> pegs;
+    std::vector<snapshot_trailing> trailing;
+    std::vector<snapshot_group> groups;
+    std::vector<snapshot_expiry> expiries;
+    std::string tmp_path = path + ".tmp";
+
+    /* T&S uses the steady clock; store as system time so it means something later */
+    auto sys_now = std::chrono::system_clock::now();
+    auto steady_now = clock_type::now();
+
+    _block_on_outstanding_orders(); /* BLOCKING (on _noutstanding_orders) */ 
+    {
+        counted_lock_guard lock(*_master_mtx, _counters);
+        /* --- CRITICAL SECTION --- */
+        _high_low<>::template set_using_cached<limit_chain_type>(this,&h,&l);
+        for( ; l <= h; ++l){
+            for(const auto & e : l->first){
+                snapshot_limit r = snapshot_limit();
+                r.id = e.first;
+                r.size = T_(e.second,0);
+                r.tick = _plevel_to_tick(l);
+                r.owner = T_(e.second,2);
+                r.buy = (l <= _bid);
+                limits.push_back(r);
+            }
+        }
 
+        _high_low<>::template set_using_cached<stop_chain_type>(this,&h,&l);
+        for( ; l <= h; ++l){
+            for(const auto & e : l->second){
+                snapshot_stop r = snapshot_stop();
+                r.id = e.first;
+                r.size = T_(e.second,2);
+                r.tick = _plevel_to_tick(l);
+                r.limit = T_(e.second,1) ? _plevel_to_tick((plevel)T_(e.second,1)) : -1;
+                r.buy = T_(e.second,0);
+                r.owner = T_(e.second,4);
+                stops.push_back(r);
+            }
+        }
 
-SOB_TEMPLATE
-id_type 
-SOB_CLASS::insert_market_order( bool buy,
-                                size_type size,
-                                order_exec_cb_type exec_cb,
-                                order_admin_cb_type admin_cb )
-{    
-    if(size <= 0)
-        throw invalid_order("invalid order size");
+        for(const auto & e : _t_and_s){
+            snapshot_tands r = snapshot_tands();
+            r.time = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                         (sys_now + std::chrono::duration_cast<
+                             std::chrono::system_clock::duration>(T_(e,0) - steady_now))
+                         .time_since_epoch()
+                     ).count();
+            r.tick = _plevel_to_tick(_ptoi(T_(e,1)));
+            r.size = T_(e,2);
+            tands.push_back(r);
+        }
 
-    return _push_order_and_wait(order_type::market, buy, nullptr, nullptr, 
-                                size, exec_cb, admin_cb); 
-}
+        for(const auto & e : _iceberg_slices){
+            snapshot_iceberg r = snapshot_iceberg();
+            r.slice_id = e.first;
+            r.id = e.second.id;
+            r.display = e.second.display;
+            r.reserve = e.second.reserve;
+            icebergs.push_back(r);
+        }
 
+        for(int buy = 0; buy < 2; ++buy){
+            for(int peg = 0; peg < 2; ++peg){
+                for(const auto & e : _peg_chains[buy][peg]){
+                    snapshot_peg r = snapshot_peg();
+                    r.rid = e.second.rid;
+                    r.id = e.first;
+                    r.offset = e.second.offset;
+                    r.tick = _plevel_to_tick(e.second.limit);
+                    r.buy = buy;
+                    r.peg = peg;
+                    pegs.push_back(r);
+                }
+            }
+        }
 
-SOB_TEMPLATE
-id_type 
-SOB_CLASS::insert_stop_order( bool buy,
-                              price_type stop,
-                              size_type size,
-                              order_exec_cb_type exec_cb,
-                              order_admin_cb_type admin_cb )
-{
-    return insert_stop_order(buy,stop,0,size,exec_cb,admin_cb);
-}
+        for(const auto & side : _trailing_stops){
+            for(const auto & e : side){
+                snapshot_trailing r = snapshot_trailing();
+                r.id = e.second.id;
+                r.trail = e.second.trail;
+                r.mark = _plevel_to_tick(e.first);
+                r.tick = _plevel_to_tick(e.second.stop);
+                r.limit_offset = (std::uint32_t)e.second.limit_offset;
+                r.buy = e.second.buy;
+                r.stop_limit = e.second.stop_limit;
+                trailing.push_back(r);
+            }
+        }
 
+        for(const auto & e : _groups){
+            for(const auto & o : e.second.orders){
+                snapshot_group r = snapshot_group();
+                r.group = e.first;
+                r.id = o.first;
+                r.owner = e.second.owner;
+                r.stop = o.second;
+                if(e.second.profit_id){
+                    r.profit_id = e.second.profit_id;
+                    r.loss_id = e.second.loss_id;
+                    r.size = e.second.size;
+                    r.profit = _plevel_to_tick(e.second.profit);
+                    r.loss = _plevel_to_tick(e.second.loss);
+                    r.buy = e.second.buy;
+                }
+                groups.push_back(r);
+            }
+        }
 
-SOB_TEMPLATE
-id_type 
-SOB_CLASS::insert_stop_order( bool buy,
-                              price_type stop,
-                              price_type limit,
-                              size_type size,
-                              order_exec_cb_type exec_cb,
-                              order_admin_cb_type admin_cb )
-{
-    plevel plimit, pstop;
-    order_type oty;
+        for(const auto & e : _expiries){
+            snapshot_expiry r = snapshot_expiry();
+            r.id = e.first;
+            r.wall = !_use_virtual_time;
+            r.expire = r.wall
+                ? std::chrono::duration_cast<std::chrono::nanoseconds>(
+                      (sys_now + std::chrono::duration_cast<
+                          std::chrono::system_clock::duration>(e.second.expire - steady_now))
+                      .time_since_epoch()
+                  ).count()
+                : e.second.expire.time_since_epoch().count();
+            r.tick = _plevel_to_tick(e.second.where);
+            r.stop = e.second.stop;
+            expiries.push_back(r);
+        }
 
-    if(size <= 0)
-        throw invalid_order("invalid order size");
+        memcpy(hdr.magic, "SOBS", sizeof(hdr.magic));
+        hdr.version = snapshot_version;
+        hdr.tick_num = tick_ratio::num;
+        hdr.tick_den = tick_ratio::den;
+        hdr.min_incr = _base.to_incr();
+        hdr.total_incr = _total_incr;
+        hdr.last_id = _last_id;
+        hdr.volume = _total_volume;
+        hdr.last_size = _last_size;
+        hdr.last = _plevel_to_tick(_last);
+        hdr.bid = _plevel_to_tick(_bid);
+        hdr.ask = _plevel_to_tick(_ask);
+        hdr.low_buy_limit = _plevel_to_tick(_low_buy_limit);
+        hdr.high_sell_limit = _plevel_to_tick(_high_sell_limit);
+        hdr.low_buy_stop = _plevel_to_tick(_low_buy_stop);
+        hdr.high_buy_stop = _plevel_to_tick(_high_buy_stop);
+        hdr.low_sell_stop = _plevel_to_tick(_low_sell_stop);
+        hdr.high_sell_stop = _plevel_to_tick(_high_sell_stop);
+        hdr.nlimits = limits.size();
+        hdr.nstops = stops.size();
+        hdr.ntands = tands.size();
+        hdr.nicebergs = icebergs.size();
+        hdr.npegs = pegs.size();
+        hdr.ntrailing = trailing.size();
+        hdr.ngroups = groups.size();
+        hdr.nexpiries = expiries.size();
+        /* --- CRITICAL SECTION --- */
+    }
 
-    try{
-        plimit = limit ? _ptoi(limit) : nullptr;
-        pstop = _ptoi(stop);         
-    }catch(std::range_error){
-        throw invalid_order("invalid price");
-    }    
-    oty = limit ? order_type::stop_limit : order_type::stop;
+    {   /* write to a temp file and rename so we never leave a partial snapshot */
+        std::ofstream out(tmp_path, std::ios::binary | std::ios::trunc);
+        if(!out)
+            throw snapshot_error(cat("could not open snapshot: ", tmp_path.c_str()).c_str());
+
+        out.write((const char*)&hdr, sizeof(hdr));
+        out.write((const char*)limits.data(), limits.size() * sizeof(snapshot_limit));
+        out.write((const char*)stops.data(), stops.size() * sizeof(snapshot_stop));
+        out.write((const char*)tands.data(), tands.size() * sizeof(snapshot_tands));
+        out.write((const char*)icebergs.data(), icebergs.size() * sizeof(snapshot_iceberg));
+        out.write((const char*)pegs.data(), pegs.size() * sizeof(snapshot_peg));
+        out.write((const char*)trailing.data(), trailing.size() * sizeof(snapshot_trailing));
+        out.write((const char*)groups.data(), groups.size() * sizeof(snapshot_group));
+        out.write((const char*)expiries.data(), expiries.size() * sizeof(snapshot_expiry));
+        out.flush();
+        if(!out)
+            throw snapshot_error("snapshot write failed");
+    }
 
-    return _push_order_and_wait(oty,buy,plimit,pstop,size,exec_cb,admin_cb);    
+    if(std::rename(tmp_path.c_str(), path.c_str()))
+        throw snapshot_error(cat("could not rename snapshot: ", path.c_str()).c_str());
 }
 
 
 SOB_TEMPLATE
-bool 
-SOB_CLASS::pull_order(id_type id, bool search_limits_first)
+void
+SOB_CLASS::restore(const std::string& path)
 {
-    return _push_order_and_wait(order_type::null, search_limits_first, 
-                                nullptr, nullptr, 0, nullptr, nullptr,id); 
-}
+    plevel p;
+    snapshot_header hdr;
+    std::vector<snapshot_limit> limits;
+    std::vector<snapshot_stop> stops;
+    std::vector<snapshot_tands> tands;
+    std::vector<snapshot_iceberg> icebergs;
+    std::vector<snapshot_peg> pegs;
+    std::vector<snapshot_trailing> trailing;
+    std::vector<snapshot_group> groups;
+    std::vector<snapshot_expiry> expiries;
+
+    auto sys_now = std::chrono::system_clock::now();
+    auto steady_now = clock_type::now();
 
+    {
+        std::ifstream in(path, std::ios::binary);
+        if(!in)
+            throw snapshot_error(cat("could not open snapshot: ", path.c_str()).c_str());
 
-SOB_TEMPLATE
-order_info_type 
-SOB_CLASS::get_order_info(id_type id, bool search_limits_first) 
-{     
+        in.read((char*)&hdr, sizeof(hdr));
+        if(!in || memcmp(hdr.magic, "SOBS", sizeof(hdr.magic)))
+            throw snapshot_error("invalid snapshot header");
+
+        if(hdr.version != snapshot_version)
+            throw snapshot_error("unsupported snapshot version");
+
+        if(hdr.tick_num != tick_ratio::num 
+           || hdr.tick_den != tick_ratio::den
+           || hdr.min_incr != _base.to_incr() 
+           || hdr.total_incr != _total_incr)
+        {
+            throw snapshot_error("snapshot doesn't match this orderbook");
+        }
+
+        limits.resize(hdr.nlimits);
+        stops.resize(hdr.nstops);
+        tands.resize(hdr.ntands);
+        icebergs.resize(hdr.nicebergs);
+        pegs.resize(hdr.npegs);
+        trailing.resize(hdr.ntrailing);
+        groups.resize(hdr.ngroups);
+        expiries.resize(hdr.nexpiries);
+        in.read((char*)limits.data(), limits.size() * sizeof(snapshot_limit));
+        in.read((char*)stops.data(), stops.size() * sizeof(snapshot_stop));
+        in.read((char*)tands.data(), tands.size() * sizeof(snapshot_tands));
+        in.read((char*)icebergs.data(), icebergs.size() * sizeof(snapshot_iceberg));
+        in.read((char*)pegs.data(), pegs.size() * sizeof(snapshot_peg));
+        in.read((char*)trailing.data(), trailing.size() * sizeof(snapshot_trailing));
+        in.read((char*)groups.data(), groups.size() * sizeof(snapshot_group));
+        in.read((char*)expiries.data(), expiries.size() * sizeof(snapshot_expiry));
+        if(!in)
+            throw snapshot_error("truncated snapshot");
+    }
+
+    /* validate everything before we touch the book */
+    for(const auto & r : limits)
+        _tick_to_plevel(r.tick, false);
+    for(const auto & r : stops){
+        _tick_to_plevel(r.tick, false);
+        _tick_to_plevel(r.limit, true);
+    }
+    for(const auto & r : tands)
+        _tick_to_plevel(r.tick, false);
+    for(const auto & r : pegs){
+        _tick_to_plevel(r.tick, false);
+        if(r.peg > (std::uint8_t)peg_type::midpoint)
+            throw snapshot_error("snapshot has an invalid peg type");
+    }
+    for(const auto & r : trailing){
+        _tick_to_plevel(r.tick, false);
+        _tick_to_plevel(r.mark, false);
+    }
+    for(const auto & r : groups){
+        if(r.profit_id){
+            _tick_to_plevel(r.profit, false);
+            _tick_to_plevel(r.loss, false);
+        }
+    }
+    for(const auto & r : expiries)
+        _tick_to_plevel(r.tick, false);
+    _tick_to_plevel(hdr.last, false);
+    for(std::int32_t t : {hdr.bid, hdr.ask, hdr.low_buy_limit, hdr.high_sell_limit,
+                          hdr.low_buy_stop, hdr.high_buy_stop, hdr.low_sell_stop,
+                          hdr.high_sell_stop})
+    {
+        _tick_to_plevel(t, true);
+    }
+
+    _block_on_outstanding_orders(); /* BLOCKING (on _noutstanding_orders) */ 
     {
-        std::lock_guard<std::mutex> lock(*_master_mtx); 
+        counted_lock_guard lock(*_master_mtx, _counters);
         /* --- CRITICAL SECTION --- */
-        return search_limits_first
-            ? _get_order_info<limit_chain_type, stop_chain_type>(id)        
-            : _get_order_info<stop_chain_type, limit_chain_type>(id);
+        if(_last_id)
+            throw invalid_state("can only restore a snapshot into a new orderbook");
+
+        /* chains were written in id order; hint at the end of each */
+        for(const auto & r : limits){
+            p = _beg + r.tick;
+            p->first.emplace_hint(p->first.end(), r.id, limit_bndl_type(r.size, nullptr, r.owner));
+        }
+
+        for(const auto & r : stops){
+            p = _beg + r.tick;
+            p->second.emplace_hint(
+                p->second.end(), r.id,
+                stop_bndl_type((bool)r.buy, (void*)(r.limit >= 0 ? _beg + r.limit : nullptr),
+                               r.size, nullptr, r.owner)
+            );
+        }
+
+        _bid = _beg + hdr.bid;
+        _ask = _beg + hdr.ask;
+        _low_buy_limit = _beg + hdr.low_buy_limit;
+        _high_sell_limit = _beg + hdr.high_sell_limit;
+        _low_buy_stop = _beg + hdr.low_buy_stop;
+        _high_buy_stop = _beg + hdr.high_buy_stop;
+        _low_sell_stop = _beg + hdr.low_sell_stop;
+        _high_sell_stop = _beg + hdr.high_sell_stop;
+
+        _bid_size = (_bid >= _beg) ? _chain<limit_chain_type>::size(&_bid->first) : 0;
+        _ask_size = (_ask < _end) ? _chain<limit_chain_type>::size(&_ask->first) : 0;
+
+        _last = _beg + hdr.last;
+        _last_id = hdr.last_id;
+        _total_volume = hdr.volume;
+        _last_size = hdr.last_size;
+
+        _t_and_s.clear();
+        auto titer = tands.cbegin();
+        if(tands.size() > _t_and_s_max_sz)
+            titer += tands.size() - _t_and_s_max_sz;
+        for( ; titer != tands.cend(); ++titer){
+            auto since = std::chrono::nanoseconds(titer->time) - sys_now.time_since_epoch();
+            _t_and_s.push_back(
+                t_and_s_type(steady_now + std::chrono::duration_cast<clock_type::duration>(since),
+                             _itop(_beg + titer->tick), titer->size)
+            );
+        }
+        _t_and_s_full = (_t_and_s.size() >= _t_and_s_max_sz);
+
+        for(const auto & r : icebergs){
+            _iceberg_slices[r.slice_id] = iceberg_bndl_type{r.id, r.display, r.reserve};
+            _iceberg_orders[r.id] = r.slice_id;
+        }
+
+        for(const auto & r : pegs){
+            peg_chain_type& pc = _peg_chains[r.buy ? 1 : 0][r.peg];
+            pc[r.id] = peg_bndl_type{r.rid, _beg + r.tick, r.offset};
+            _peg_resting[r.rid] = std::make_pair(r.id, &pc);
+            _peg_orders[r.id] = &pc;
+        }
+        _peg_references(&_peg_bid, &_peg_ask);
+
+        for(const auto & r : trailing){
+            _trailing_ids[r.id] = _trailing_stops[r.buy ? 1 : 0].insert(
+                std::make_pair(_beg + r.mark, 
+                               trailing_bndl_type{r.id, (bool)r.buy, (bool)r.stop_limit, 
+                                                  r.trail, r.limit_offset, _beg + r.tick})
+            );
+        }
+
+        /* a group's orders were written in order, w/ its callback(null) */
+        for(const auto & r : groups){
+            group_bndl_type& g = _groups[r.group];
+            g.orders.push_back( std::make_pair(r.id, (bool)r.stop) );
+            g.owner = r.owner;
+            if(r.profit_id){
+                g.buy = r.buy;
+                g.size = r.size;
+                g.profit = _beg + r.profit;
+                g.loss = _beg + r.loss;
+                g.profit_id = r.profit_id;
+                g.loss_id = r.loss_id;
+            }
+            _group_ids[r.id] = r.group;
+        }
+
+        for(const auto & r : expiries){
+            time_stamp_type expire = r.wall
+                ? steady_now + std::chrono::duration_cast<clock_type::duration>(
+                      std::chrono::nanoseconds(r.expire) - sys_now.time_since_epoch())
+                : time_stamp_type(clock_type::duration(r.expire));
+            _set_expiry(r.id, expire, _beg + r.tick, r.stop);
+        }
+
+        if(_mbo_feed)
+            _publish_mbo_image();
+        if(_l2_feed)
+            _publish_l2_refresh();
         /* --- CRITICAL SECTION --- */
-    }     
+    }
+    _order_queue_cond.notify_one(); /* (GTT orders it restored) */
 }
 
 
 SOB_TEMPLATE
-id_type 
-SOB_CLASS::replace_with_limit_order( id_type id,
-                                     bool buy,
-                                     price_type limit,
-                                     size_type size,
-                                     order_exec_cb_type exec_cb,
-                                     order_admin_cb_type admin_cb )
-{
-    id_type id_new = 0;
-    
-    if(pull_order(id))
-        id_new = insert_limit_order(buy,limit,size,exec_cb,admin_cb);
-    
-    return id_new;
+void
+SOB_CLASS::_publish_mbo_event(mbo_msg msg, 
+                              id_type id, 
+                              id_type ref, 
+                              size_type size, 
+                              plevel limit, 
+                              plevel stop, 
+                              bool buy, 
+                              std::uint8_t flags)
+{  /* 
+    * PART OF THE ENCLOSING CRITICAL SECTION (we're the only producer)
+    */
+    mbo_event e = mbo_event();
+
+    e.id = id;
+    e.ref = ref;
+    e.size = size;
+    e.time = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                 _now().time_since_epoch()
+             ).count();
+    e.tick = limit ? _plevel_to_tick(limit) : -1;
+    e.stop = stop ? _plevel_to_tick(stop) : -1;
+    e.msg = (std::uint8_t)msg;
+    e.buy = buy;
+    e.flags = flags;
+
+    _mbo_feed->publish(e);
 }
 
 
 SOB_TEMPLATE
-id_type 
-SOB_CLASS::replace_with_market_order( id_type id,
-                                      bool buy,
-                                      size_type size,
-                                      order_exec_cb_type exec_cb,
-                                      order_admin_cb_type admin_cb )
-{
-    id_type id_new = 0;
-    
-    if(pull_order(id))
-        id_new = insert_market_order(buy,size,exec_cb,admin_cb);
-    
-    return id_new;
+void
+SOB_CLASS::_publish_mbo_image()
+{  /* 
+    * PART OF THE ENCLOSING CRITICAL SECTION 
+    */
+    plevel h, l;
+
+    _publish_mbo_event(mbo_msg::clear, 0, 0, 0, nullptr, nullptr, false, 0);
+
+    _high_low<>::template set_using_cached<limit_chain_type>(this,&h,&l);
+    for( ; l <= h; ++l){
+        for(const auto & e : l->first)
+            _publish_mbo_event(mbo_msg::add, e.first, 0, T_(e.second,0), l, 
+                               nullptr, l <= _bid, 0);
+    }
+
+    _high_low<>::template set_using_cached<stop_chain_type>(this,&h,&l);
+    for( ; l <= h; ++l){
+        for(const auto & e : l->second)
+            _publish_mbo_event(mbo_msg::add, e.first, 0, T_(e.second,2), 
+                               (plevel)T_(e.second,1), l, T_(e.second,0), 
+                               MBO_FLAG_STOP);
+    }
 }
 
 
 SOB_TEMPLATE
-id_type 
-SOB_CLASS::replace_with_stop_order( id_type id,
-                                    bool buy,
-                                    price_type stop,
-                                    size_type size,
-                                    order_exec_cb_type exec_cb,
-                                    order_admin_cb_type admin_cb )
+void
+SOB_CLASS::set_mbo_feed(std::shared_ptr<MBOFeed> feed)
 {
-    id_type id_new = 0;
-    
-    if(pull_order(id))
-        id_new = insert_stop_order(buy,stop,size,exec_cb,admin_cb);
-    
-    return id_new;
+    counted_lock_guard lock(*_master_mtx, _counters);
+    /* --- CRITICAL SECTION --- */
+    _mbo_feed = feed;
+    if(_mbo_feed)
+        _publish_mbo_image();
+    /* --- CRITICAL SECTION --- */
 }
 
-
 SOB_TEMPLATE
-id_type 
-SOB_CLASS::replace_with_stop_order( id_type id,
-                                    bool buy,
-                                    price_type stop,
-                                    price_type limit,
-                                    size_type size,
-                                    order_exec_cb_type exec_cb,
-                                    order_admin_cb_type admin_cb)
-{
-    id_type id_new = 0;
-    
-    if(pull_order(id))
-        id_new = insert_stop_order(buy,stop,limit,size,exec_cb,admin_cb);
-    
-    return id_new;
+void
+SOB_CLASS::_publish_l2_event(l2_msg msg, plevel p, size_type size, bool buy)
+{  /* 
+    * PART OF THE ENCLOSING CRITICAL SECTION (we're the only producer)
+    */
+    l2_event e = l2_event();
+
+    e.size = size;
+    e.time = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                 _now().time_since_epoch()
+             ).count();
+    e.tick = p ? _plevel_to_tick(p) : -1;
+    e.msg = (std::uint8_t)msg;
+    e.buy = buy;
+
+    _l2_feed->publish(e);
 }
 
 
 SOB_TEMPLATE
-void 
-SOB_CLASS::dump_cached_plevels() const
-{
-    std::lock_guard<std::mutex> lock(*_master_mtx);
-    /* --- CRITICAL SECTION --- */
-    std::cout<< "CACHED PLEVELS" << std::endl;       
+void
+SOB_CLASS::_publish_l2_update(plevel p, bool buy)
+{  /* 
+    * PART OF THE ENCLOSING CRITICAL SECTION 
+    */
+    _publish_l2_event(l2_msg::update, p, _chain<limit_chain_type>::size(&p->first), buy);
+    ++_l2_since_refresh;
+}
 
-    std::cout<< "_high_sell_limit: "
-             << std::to_string(_itop(_high_sell_limit)) 
-             << std::endl;
 
-    std::cout<< "_high_buy_stop: "
-             << std::to_string(_itop(_low_buy_stop)) 
-             << std::endl;
+SOB_TEMPLATE
+void
+SOB_CLASS::_publish_l2_refresh()
+{  /* 
+    * PART OF THE ENCLOSING CRITICAL SECTION 
+    */
+    plevel h, l;
+    size_type sz;
 
-    std::cout<< "_low_buy_stop: "
-             << std::to_string(_itop(_low_buy_stop)) 
-             << std::endl;
+    _publish_l2_event(l2_msg::refresh_begin, nullptr, 0, false);
 
-    std::cout<< "LAST: "
-             << std::to_string(_itop(_last)) 
-             << std::endl;
+    _high_low<>::template set_using_cached<limit_chain_type>(this,&h,&l);
+    for( ; l <= h; ++l){
+        if(l->first.empty())
+            continue;
+        sz = _chain<limit_chain_type>::size(&l->first);
+        _publish_l2_event(l2_msg::refresh_level, l, sz, l <= _bid);
+    }
 
-    std::cout<< "_high_sell_stop: "
-             << std::to_string(_itop(_high_sell_stop)) 
-             << std::endl;
+    _publish_l2_event(l2_msg::refresh_end, nullptr, 0, false);
+    _l2_since_refresh = 0;
+}
 
-    std::cout<< "_low_sell_stop: "
-             << std::to_string(_itop(_low_sell_stop)) 
-             << std::endl;
 
-    std::cout<< "_low_buy_limit: "
-             << std::to_string(_itop(_low_buy_limit)) 
-             << std::endl;
+SOB_TEMPLATE
+void
+SOB_CLASS::set_l2_feed(std::shared_ptr<L2Feed> feed, size_type refresh_every)
+{
+    counted_lock_guard lock(*_master_mtx, _counters);
+    /* --- CRITICAL SECTION --- */
+    _l2_feed = feed;
+    _l2_refresh_every = refresh_every;
+    if(_l2_feed)
+        _publish_l2_refresh();
     /* --- CRITICAL SECTION --- */
 }
 
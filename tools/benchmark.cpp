@@ -0,0 +1,350 @@
+/*
+Copyright (C) 2015 Jonathon Ogden     < jeog.dev@gmail.com >
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see http://www.gnu.org/licenses.
+*/
+
+/*
+ *   benchmark [iterations] [--threaded] [--filter <substr>]
+ *
+ *   Times the hot operations of the matching engine, one call at a time,
+ *   for every tick typedef in types.hpp and reports ns/op(mean) and
+ *   percentiles:
+ *
+ *       limit_insert_away   : limit 10-30 ticks behind the inside
+ *       limit_insert_inside : limit joining the inside bid
+ *       limit_sweep_N       : aggressive limit through N levels(_hit_chain)
+ *       market_sweep_N      : market order through N levels
+ *       cancel_depth_D      : pull by id D levels behind the inside
+ *                             (_chain::find)
+ *       replace             : replace_with_limit_order
+ *       stop_cascade_K      : one fill setting off K stop-limits in a chain
+ *                             (_look_for_triggered_stops)
+ *       market_depth_8      : market_depth(8)
+ *       total_size          : total_size()
+ *
+ *   The book is in direct mode(see SimpleOrderbook::set_direct_mode) unless
+ *   --threaded is passed, in which case every call includes the round trip
+ *   through the order dispatcher. Setup/cleanup for each sample is untimed.
+ */
+
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <numeric>
+#include <cstring>
+#include <cstdlib>
+
+#include "../simpleorderbook.hpp"
+
+using namespace NativeLayer;
+
+namespace {
+
+const int NLEVELS = 100; /* resting levels each side of the base book */
+const int NPERLEVEL = 4; /* orders per resting level */
+const int SPAN = 1000; /* ticks each side of mid */
+
+int iterations = 10000;
+bool threaded = false;
+const char* filter = nullptr;
+
+
+class Samples{
+    std::vector<long long> _ns;
+public:
+    Samples(int n)
+        {
+            _ns.reserve(n);
+        }
+
+    template<typename F>
+    inline void
+    time(F f)
+    {
+        auto t0 = clock_type::now();
+        f();
+        auto t1 = clock_type::now();
+        _ns.push_back(
+            std::chrono::duration_cast<std::chrono::nanoseconds>(t1 - t0).count()
+        );
+    }
+
+    void
+    report(const char* book, const std::string& op)
+    {
+        if(_ns.empty())
+            return;
+
+        std::sort(_ns.begin(), _ns.end());
+        auto pct = [this](double p){
+            return _ns[std::min(_ns.size() - 1, (size_t)(p * _ns.size()))];
+        };
+        double mean = std::accumulate(_ns.begin(), _ns.end(), 0.0) / _ns.size();
+
+        std::cout<< std::left << std::setw(20) << book
+                 << std::setw(22) << op << std::right
+                 << std::setw(8) << _ns.size()
+                 << std::setw(11) << std::fixed << std::setprecision(0) << mean
+                 << std::setw(10) << pct(.50)
+                 << std::setw(10) << pct(.90)
+                 << std::setw(10) << pct(.99)
+                 << std::setw(12) << _ns.back() << std::endl;
+    }
+};
+
+
+inline bool
+selected(const std::string& op)
+{
+    return !filter || op.find(filter) != std::string::npos;
+}
+
+
+template<typename SobTy>
+class Bench{
+    const char* _name;
+    double _tick;
+    double _mid;
+
+    inline price_type
+    _px(int ticks) const
+    {
+        return (price_type)(_mid + ticks * _tick);
+    }
+
+    SobTy*
+    _new_book(bool populate)
+    {
+        SobTy* sob = new SobTy(_px(0), _px(-SPAN), _px(SPAN), 0); /* no waker */
+        if(!threaded)
+            sob->set_direct_mode(true);
+
+        if(populate){
+            for(int l = 1; l <= NLEVELS; ++l){
+                for(int i = 0; i < NPERLEVEL; ++i){
+                    sob->insert_limit_order(true, _px(-l), 100, nullptr);
+                    sob->insert_limit_order(false, _px(l), 100, nullptr);
+                }
+            }
+        }
+        return sob;
+    }
+
+    void
+    _insert(const char* op, int away)
+    {
+        if(!selected(op))
+            return;
+
+        std::unique_ptr<SobTy> sob(_new_book(true));
+        std::vector<id_type> ids(iterations);
+        Samples s(iterations);
+
+        for(int i = 0; i < iterations; ++i){
+            price_type p = _px(-(1 + (away ? away + i % 20 : 0)));
+            s.time([&]{ ids[i] = sob->insert_limit_order(true, p, 10, nullptr); });
+        }
+        for(id_type id : ids)
+            sob->pull_order(id);
+
+        s.report(_name, op);
+    }
+
+    void
+    _sweep(int nlevels, bool market)
+    {
+        std::string op = cat(market ? "market_sweep_" : "limit_sweep_",
+                             std::to_string(nlevels).c_str());
+        if(!selected(op))
+            return;
+
+        std::unique_ptr<SobTy> sob(_new_book(false));
+        std::vector<id_type> ids;
+        Samples s(iterations);
+
+        for(int i = 0; i < iterations; ++i){
+            ids.clear();
+            for(int l = 1; l <= nlevels; ++l){
+                ids.push_back(sob->insert_limit_order(false, _px(l), 10, nullptr));
+                if(market) /* either side can be hit */
+                    ids.push_back(sob->insert_limit_order(true, _px(-l), 10, nullptr));
+            }
+
+            if(market)
+                s.time([&]{ sob->insert_market_order(true, 10 * nlevels, nullptr); });
+            else
+                s.time([&]{ sob->insert_limit_order(true, _px(nlevels), 10 * nlevels, nullptr); });
+
+            for(id_type id : ids)
+                sob->pull_order(id);
+        }
+
+        s.report(_name, op);
+    }
+
+    void
+    _cancel(int depth)
+    {
+        std::string op = cat("cancel_depth_", std::to_string(depth).c_str());
+        if(!selected(op))
+            return;
+
+        std::unique_ptr<SobTy> sob(_new_book(true));
+        Samples s(iterations);
+
+        for(int i = 0; i < iterations; ++i){
+            id_type id = sob->insert_limit_order(true, _px(-(1 + depth)), 10, nullptr);
+            s.time([&]{ sob->pull_order(id); });
+        }
+
+        s.report(_name, op);
+    }
+
+    void
+    _replace()
+    {
+        if(!selected("replace"))
+            return;
+
+        std::unique_ptr<SobTy> sob(_new_book(true));
+        Samples s(iterations);
+
+        for(int i = 0; i < iterations; ++i){
+            id_type id = sob->insert_limit_order(true, _px(-5), 10, nullptr);
+            s.time([&]{
+                id = sob->replace_with_limit_order(id, true, _px(-6), 10, nullptr);
+            });
+            sob->pull_order(id);
+        }
+
+        s.report(_name, "replace");
+    }
+
+    void
+    _stop_cascade(int nstops)
+    {
+        std::string op = cat("stop_cascade_", std::to_string(nstops).c_str());
+        if(!selected(op))
+            return;
+
+        std::unique_ptr<SobTy> sob(_new_book(false));
+        Samples s(iterations);
+
+        for(int i = 0; i < iterations; ++i){
+            /* fill @ 1 triggers the stop @ 1, its limit fills @ 2, ... */
+            for(int l = 1; l <= nstops + 1; ++l)
+                sob->insert_limit_order(false, _px(l), 10, nullptr);
+            for(int l = 1; l <= nstops; ++l)
+                sob->insert_stop_order(true, _px(l), _px(l + 1), 10, nullptr);
+
+            s.time([&]{ sob->insert_limit_order(true, _px(1), 10, nullptr); });
+        }
+
+        s.report(_name, op);
+    }
+
+    template<typename F>
+    void
+    _query(const char* op, F f)
+    {
+        if(!selected(op))
+            return;
+
+        std::unique_ptr<SobTy> sob(_new_book(true));
+        Samples s(iterations);
+        volatile size_type sink = 0;
+
+        for(int i = 0; i < iterations; ++i)
+            s.time([&]{ sink += f(sob.get()); });
+
+        s.report(_name, op);
+    }
+
+public:
+    Bench(const char* name)
+        :
+            _name(name),
+            _tick(SobTy::tick_size),
+            _mid(std::max(50.0, 1.5 * SPAN * SobTy::tick_size))
+        {
+        }
+
+    void
+    run()
+    {
+        _insert("limit_insert_away", 10);
+        _insert("limit_insert_inside", 0);
+
+        for(int n : {1, 8, 32}){
+            _sweep(n, false);
+            _sweep(n, true);
+        }
+
+        for(int d : {0, 10, 50, 99})
+            _cancel(d);
+
+        _replace();
+        _stop_cascade(8);
+
+        _query("market_depth_8",
+               [](SobTy* sob){ return sob->market_depth(8).size(); });
+        _query("total_size",
+               [](SobTy* sob){ return sob->total_size(); });
+    }
+};
+
+};
+
+
+int
+main(int argc, char* argv[])
+{
+    using namespace SimpleOrderbook;
+
+    for(int i = 1; i < argc; ++i){
+        if(!strcmp(argv[i], "--threaded"))
+            threaded = true;
+        else if(!strcmp(argv[i], "--filter") && i + 1 < argc)
+            filter = argv[++i];
+        else if(atoi(argv[i]) > 0)
+            iterations = atoi(argv[i]);
+        else{
+            std::cerr<< "usage: benchmark [iterations] [--threaded] [--filter <substr>]"
+                     << std::endl;
+            return 1;
+        }
+    }
+
+    std::cout<< std::left << std::setw(20) << "book" << std::setw(22) << "op"
+             << std::right << std::setw(8) << "n" << std::setw(11) << "mean(ns)"
+             << std::setw(10) << "p50" << std::setw(10) << "p90"
+             << std::setw(10) << "p99" << std::setw(12) << "max" << std::endl;
+
+    try{
+        Bench<QuarterTick>("QuarterTick").run();
+        Bench<TenthTick>("TenthTick").run();
+        Bench<ThirtySecondthTick>("ThirtySecondthTick").run();
+        Bench<HundredthTick>("HundredthTick").run();
+        Bench<ThousandthTick>("ThousandthTick").run();
+        Bench<TenThousandthTick>("TenThousandthTick").run();
+    }catch(std::exception& e){
+        std::cerr<< e.what() << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,162 @@
+/*
+Copyright (C) 2015 Jonathon Ogden     < jeog.dev@gmail.com >
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see http://www.gnu.org/licenses.
+*/
+
+/*
+ *   loadgen <tick> <price> <min> <max> [options]
+ *
+ *       tick   : 4 | 10 | 32 | 100 | 1000 | 10000 (1/tick)
+ *       price  : initial price of the book
+ *       min    : min price of the book
+ *       max    : max price of the book
+ *
+ *       --threads N     producer threads (4)
+ *       --rate R        total orders/sec, Poisson (0 = as fast as possible)
+ *       --seconds S     run time (5)
+ *       --orders N      stop after N calls (0 = no limit)
+ *       --alpha A       power-law exponent of order sizes (1.5)
+ *       --max-size N    largest order size (10000)
+ *       --cancel R      pulls per insert (.5)
+ *       --marketable F  fraction of inserts that cross (.1)
+ *       --stops F       fraction of inserts that are stops (.02)
+ *       --depth T       mean ticks behind the last price of passive limits (5)
+ *       --seed N        (0 = from the clock)
+ *       --latency       also report the book's own latency histograms
+ *
+ *   Drives a new book with a LoadGenerator(see loadgenerator.hpp) and
+ *   reports throughput, call latency and the book's engine counters.
+ */
+
+#include <iostream>
+#include <cstring>
+#include <cstdlib>
+
+#include "../simpleorderbook.hpp"
+#include "../loadgenerator.hpp"
+
+using namespace NativeLayer;
+
+namespace {
+
+bool book_latency = false;
+
+
+template<typename SobTy>
+int
+load(price_type price, price_type min, price_type max, loadgen_config cfg)
+{
+    SobTy book(price, min, max, 0); /* no waker */
+
+    cfg.tick = SobTy::tick_size;
+    cfg.min_price = min;
+    cfg.max_price = max;
+
+    if(book_latency)
+        book.enable_latency_stats();
+
+    LoadGenerator lg(book, cfg);
+    loadgen_report lr = lg.run();
+
+    lg.print(std::cout, lr);
+    std::cout<< std::endl << book.counters().sample();
+    if(book_latency)
+        std::cout<< std::endl << *book.latency_stats();
+    return 0;
+}
+
+};
+
+
+int
+main(int argc, char* argv[])
+{
+    loadgen_config cfg;
+    price_type price, min, max;
+
+    if(argc < 5){
+        std::cerr<< "usage: loadgen <tick> <price> <min> <max> [--threads N] "
+                    "[--rate R] [--seconds S] [--orders N] [--alpha A] "
+                    "[--max-size N] [--cancel R] [--marketable F] [--stops F] "
+                    "[--depth T] [--seed N] [--latency]" << std::endl;
+        return 1;
+    }
+
+    price = (price_type)atof(argv[2]);
+    min = (price_type)atof(argv[3]);
+    max = (price_type)atof(argv[4]);
+
+    for(int i = 5; i < argc; ++i){
+        const char* opt = argv[i];
+        if(!strcmp(opt, "--latency")){
+            book_latency = true;
+            continue;
+        }
+        if(i + 1 >= argc){
+            std::cerr<< "missing value for " << opt << std::endl;
+            return 1;
+        }
+        const char* val = argv[++i];
+        if(!strcmp(opt, "--threads"))
+            cfg.nthreads = (unsigned)atoi(val);
+        else if(!strcmp(opt, "--rate"))
+            cfg.rate = atof(val);
+        else if(!strcmp(opt, "--seconds"))
+            cfg.seconds = atof(val);
+        else if(!strcmp(opt, "--orders"))
+            cfg.norders = strtoull(val, nullptr, 10);
+        else if(!strcmp(opt, "--alpha"))
+            cfg.size_alpha = atof(val);
+        else if(!strcmp(opt, "--max-size"))
+            cfg.size_max = (size_type)atol(val);
+        else if(!strcmp(opt, "--cancel"))
+            cfg.cancel_ratio = atof(val);
+        else if(!strcmp(opt, "--marketable"))
+            cfg.marketable = atof(val);
+        else if(!strcmp(opt, "--stops"))
+            cfg.stops = atof(val);
+        else if(!strcmp(opt, "--depth"))
+            cfg.depth_ticks = atof(val);
+        else if(!strcmp(opt, "--seed"))
+            cfg.seed = (unsigned)strtoul(val, nullptr, 10);
+        else{
+            std::cerr<< "unknown option " << opt << std::endl;
+            return 1;
+        }
+    }
+
+    try{
+        switch(atoi(argv[1])){
+        case 4:
+            return load<SimpleOrderbook::QuarterTick>(price, min, max, cfg);
+        case 10:
+            return load<SimpleOrderbook::TenthTick>(price, min, max, cfg);
+        case 32:
+            return load<SimpleOrderbook::ThirtySecondthTick>(price, min, max, cfg);
+        case 100:
+            return load<SimpleOrderbook::HundredthTick>(price, min, max, cfg);
+        case 1000:
+            return load<SimpleOrderbook::ThousandthTick>(price, min, max, cfg);
+        case 10000:
+            return load<SimpleOrderbook::TenThousandthTick>(price, min, max, cfg);
+        default:
+            std::cerr<< "tick must be one of 4, 10, 32, 100, 1000, 10000" << std::endl;
+            return 1;
+        }
+    }catch(std::exception& e){
+        std::cerr<< e.what() << std::endl;
+        return 1;
+    }
+}
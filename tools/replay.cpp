@@ -0,0 +1,115 @@
+/*
+Copyright (C) 2015 Jonathon Ogden     < jeog.dev@gmail.com >
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see http://www.gnu.org/licenses.
+*/
+
+/*
+ *   replay <events> <tick> <price> <min> <max> [out]
+ *
+ *       events : CSV event file or binary OrderJournal(detected by magic)
+ *       tick   : 4 | 10 | 32 | 100 | 1000 | 10000 (1/tick)
+ *       price  : initial price of the book
+ *       min    : min price of the book
+ *       max    : max price of the book
+ *       out    : output file (default: stdout)
+ *
+ *   fills/trades go to 'out', replay_stats to stderr (see replayengine.hpp)
+ */
+
+#include <iostream>
+#include <fstream>
+#include <cstring>
+#include <cstdlib>
+
+#include "../replayengine.hpp"
+
+using namespace NativeLayer;
+
+namespace {
+
+bool
+is_journal(const char* path)
+{
+    char m[4] = {0};
+    std::ifstream in(path, std::ios::binary);
+    in.read(m, sizeof(m));
+    return in && !memcmp(m, OrderJournal::magic, sizeof(m));
+}
+
+template<typename SobTy>
+int
+replay(const char* path, price_type price, price_type min, price_type max,
+       std::ostream& out)
+{
+    SobTy book(price, min, max, 0); /* no waker */
+    ReplayEngine<SobTy> engine(book, out);
+    replay_stats rs = is_journal(path) ? engine.run_journal(path)
+                                       : engine.run_csv(std::string(path));
+    std::cerr<< rs << std::endl;
+    return 0;
+}
+
+};
+
+
+int
+main(int argc, char* argv[])
+{
+    std::ofstream fout;
+    std::ostream* out = &std::cout;
+    price_type price, min, max;
+
+    if(argc < 6){
+        std::cerr<< "usage: replay <events> <tick> <price> <min> <max> [out]"
+                 << std::endl;
+        return 1;
+    }
+
+    price = (price_type)atof(argv[3]);
+    min = (price_type)atof(argv[4]);
+    max = (price_type)atof(argv[5]);
+
+    if(argc > 6){
+        fout.open(argv[6], std::ios::binary | std::ios::trunc);
+        if(!fout){
+            std::cerr<< "could not open " << argv[6] << std::endl;
+            return 1;
+        }
+        out = &fout;
+    }
+
+    try{
+        switch(atoi(argv[2])){
+        case 4:
+            return replay<SimpleOrderbook::QuarterTick>(argv[1], price, min, max, *out);
+        case 10:
+            return replay<SimpleOrderbook::TenthTick>(argv[1], price, min, max, *out);
+        case 32:
+            return replay<SimpleOrderbook::ThirtySecondthTick>(argv[1], price, min, max, *out);
+        case 100:
+            return replay<SimpleOrderbook::HundredthTick>(argv[1], price, min, max, *out);
+        case 1000:
+            return replay<SimpleOrderbook::ThousandthTick>(argv[1], price, min, max, *out);
+        case 10000:
+            return replay<SimpleOrderbook::TenThousandthTick>(argv[1], price, min, max, *out);
+        default:
+            std::cerr<< "tick must be one of 4, 10, 32, 100, 1000, 10000" << std::endl;
+            return 1;
+        }
+    }catch(std::exception& e){
+        std::cerr<< e.what() << std::endl;
+        return 1;
+    }
+}
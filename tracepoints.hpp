@@ -0,0 +1,70 @@
+/*
+Copyright (C) 2015 Jonathon Ogden     < jeog.dev@gmail.com >
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see http://www.gnu.org/licenses.
+*/
+
+#ifndef JO_0815_TRACEPOINTS
+#define JO_0815_TRACEPOINTS
+
+/*
+ *   Static(USDT/SDT) tracepoints, provider 'simpleorderbook'. Build with
+ *   -DSOB_USDT(needs <sys/sdt.h>, e.g. systemtap-sdt-dev) to compile them
+ *   in; each is a single nop until a tracer attaches. Without SOB_USDT they
+ *   compile to nothing.
+ *
+ *   Prices are tick indices(0 = min price, -1 = none); sides are 1 = buy.
+ *
+ *       order__enqueue   (type, buy, size, queue depth)
+ *       route__start     (id, type, buy, size)
+ *       route__end       (id, type, ok)
+ *       fill             (aggressor id, resting id, tick, size)
+ *       level__exhausted (bid side, old inside tick, new inside tick)
+ *       stop__trigger    (id, buy, stop tick, limit tick, size)
+ *       callback__drain  (ncallbacks)
+ *
+ *   e.g.
+ *       bpftrace -e 'usdt:./a.out:simpleorderbook:fill { @[arg2] = sum(arg3); }'
+ *       perf probe -x ./a.out sdt_simpleorderbook:route__start
+ */
+
+#ifdef SOB_USDT
+
+#include <sys/sdt.h>
+
+#define SOB_TRACE1(name,a) \
+    DTRACE_PROBE1(simpleorderbook,name,a)
+#define SOB_TRACE3(name,a,b,c) \
+    DTRACE_PROBE3(simpleorderbook,name,a,b,c)
+#define SOB_TRACE4(name,a,b,c,d) \
+    DTRACE_PROBE4(simpleorderbook,name,a,b,c,d)
+#define SOB_TRACE5(name,a,b,c,d,e) \
+    DTRACE_PROBE5(simpleorderbook,name,a,b,c,d,e)
+
+/* a local only a probe reads(e.g. state from before it changes) */
+#define SOB_TRACE_LOCAL(type,var,init) \
+    type var = init
+
+#else
+
+#define SOB_TRACE1(name,a) do{ }while(0)
+#define SOB_TRACE3(name,a,b,c) do{ }while(0)
+#define SOB_TRACE4(name,a,b,c,d) do{ }while(0)
+#define SOB_TRACE5(name,a,b,c,d,e) do{ }while(0)
+
+#define SOB_TRACE_LOCAL(type,var,init) do{ }while(0)
+
+#endif /* SOB_USDT */
+
+#endif /* JO_0815_TRACEPOINTS */
@@ -39,6 +39,7 @@ typedef double              price_diff_type;
 typedef unsigned long       size_type, id_type;
 typedef long long           size_diff_type;
 typedef unsigned long long  large_size_type;
+typedef unsigned int        owner_type; /* session/owner tag, 0 = none */
 
 typedef std::ratio<1,100>   default_tick;
 
@@ -81,24 +82,180 @@ enum class order_type {
     market,
     limit,
     stop,
-    stop_limit
+    stop_limit,
+    immediate_or_cancel, /* limit; what doesn't fill right away is cancelled */
+    fill_or_kill /* limit; fills completely, right away, or is cancelled */
 };
 
+/* order_type::null ... fill_or_kill (for per-type arrays) */
+const int norder_types = 7;
+
 std::string order_type_str(const order_type& ot);
 
+/* what a pegged limit order follows(see SimpleOrderbook::insert_peg_order) */
+enum class peg_type {
+    primary = 0, /* its own side: best bid for buys, best ask for sells */
+    midpoint /* the midpoint; buys round down, sells up */
+};
+
+/* 
+ * what the book does when an order would trade against a resting order w/ 
+ * the same owner tag(see SimpleOrderbook::set_stp_policy):
+ *
+ *     none          : nothing, they trade
+ *     cancel_newest : cancel what's left of the incoming order
+ *     cancel_oldest : cancel the resting order, keep matching
+ *     cancel_both   : cancel the resting order and what's left of the incoming
+ *     decrement     : take the smaller of the two sizes off both, w/o a fill
+ */
+enum class stp_policy {
+    none = 0,
+    cancel_newest,
+    cancel_oldest,
+    cancel_both,
+    decrement
+};
+
 enum class side_of_market {
     bid = 1,
     ask = -1,
     both = 0
 };
 
+/* 
+ * which resting orders cancel_all(...) removes; every field must match:
+ *
+ *     owner     : orders inserted with this owner tag (0 = any owner)
+ *     side      : bid(buys), ask(sells) or both
+ *     type      : limit(incl. icebergs), stop or stop_limit (null = any)
+ *     min_price : lowest limit(stop price for stops) (0 = no bound)
+ *     max_price : highest limit(stop price for stops) (0 = no bound)
+ */
+struct cancel_filter {
+    owner_type owner;
+    side_of_market side;
+    order_type type;
+    price_type min_price;
+    price_type max_price;
+
+    cancel_filter(owner_type owner = 0,
+                  side_of_market side = side_of_market::both,
+                  order_type type = order_type::null,
+                  price_type min_price = 0,
+                  price_type max_price = 0)
+        :
+            owner(owner),
+            side(side),
+            type(type),
+            min_price(min_price),
+            max_price(max_price)
+        {
+        }
+};
+
 typedef std::function<void(callback_msg,id_type,price_type,size_type)>  order_exec_cb_type;
 typedef std::function<void(id_type)> order_admin_cb_type;
 
 typedef std::tuple<order_type,bool,price_type, price_type,size_type> order_info_type;
 
+/* a level of a mass_quote(...): price, total size to show there */
+typedef std::pair<price_type,size_type> quote_level_type;
+typedef std::vector<quote_level_type> quote_levels_type;
+
+/*
+ * what a mass_quote(...) did and the quote it left; 'orders' are the quote's
+ * orders as (id, buy, price, size), kept/reduced ones w/ their size now and
+ * new ones w/ the size they were inserted with(any fills on insert come as
+ * callbacks after the ack):
+ *
+ *     kept      : orders left as they were(place in line kept)
+ *     reduced   : orders cut down in place(place in line kept)
+ *     cancelled : orders pulled(levels no longer quoted, or extra orders)
+ *     inserted  : new orders(new levels, or size added to the back of one)
+ */
+typedef std::tuple<id_type,bool,price_type,size_type> quote_order_type;
+
+struct quote_ack {
+    std::vector<quote_order_type> orders;
+    size_type kept;
+    size_type reduced;
+    size_type cancelled;
+    size_type inserted;
+
+    quote_ack()
+        :
+            kept(0),
+            reduced(0),
+            cancelled(0),
+            inserted(0)
+        {
+        }
+};
+
+typedef std::function<void(const quote_ack&)> quote_admin_cb_type;
+
+/* an order of a one-cancels-other group(see SimpleOrderbook::insert_oco_order):
+   a limit, stop or stop-limit, its side, its prices(0 if none) and size */
+struct order_leg {
+    order_type type;
+    bool buy;
+    price_type limit;
+    price_type stop;
+    size_type size;
+
+    order_leg(order_type type,
+              bool buy,
+              price_type limit,
+              price_type stop,
+              size_type size)
+        :
+            type(type),
+            buy(buy),
+            limit(limit),
+            stop(stop),
+            size(size)
+        {
+        }
+};
+
+typedef std::vector<order_leg> order_legs_type;
+
+/* the ids of a group's orders, in order, before any of their callbacks */
+typedef std::function<void(const std::vector<id_type>&)> group_admin_cb_type;
+
 std::ostream& operator<<(std::ostream& out, const order_info_type& o);
 
+/* parts of the book's footprint(see QueryInterface::memory_usage) */
+enum class memory_component {
+    limit_chains = 0, /* resting limit orders */
+    stop_chains, /* resting stop orders */
+    ladder, /* a limit and stop chain per tick */
+    order_queue, /* orders waiting to be routed */
+    callback_queue, /* deferred callbacks */
+    time_and_sales
+};
+
+std::string memory_component_str(const memory_component& mc);
+
+struct memory_usage_type {
+    static const int ncomponents = 6;
+
+    size_type bytes[ncomponents];
+    size_type objects[ncomponents];
+    size_type limit; /* 0 = none */
+
+    inline size_type
+    total_bytes() const
+    {
+        size_type n = 0;
+        for(int i = 0; i < ncomponents; ++i)
+            n += bytes[i];
+        return n;
+    }
+};
+
+std::ostream& operator<<(std::ostream& out, const memory_usage_type& mu);
+
 
 class liquidity_exception
     : public std::logic_error{
@@ -188,6 +345,28 @@ public:
 };
 
 
+class journal_error
+    : public std::runtime_error{
+public:
+    journal_error(const char* what)
+        :
+            std::runtime_error(what)
+        {
+        }
+};
+
+
+class snapshot_error
+    : public std::runtime_error{
+public:
+    snapshot_error(const char* what)
+        :
+            std::runtime_error(what)
+        {
+        }
+};
+
+
 class not_implemented
     : public std::logic_error{
 public: